@@ -1,8 +1,41 @@
 #include "sierrachart.h"
 #include <vector>
 #include <algorithm>
+#include "fvg_core.h"
+#include "fvg_index.h"
 SCDLLName("FVG")
 
+const int FVG_NUM_HIGHER_TIMEFRAMES = 3;
+const int FVG_NUM_TIMEFRAMES = 1 + FVG_NUM_HIGHER_TIMEFRAMES; // 0 is the chart's own bars
+
+struct FVGRectangle {
+	int LineNumber;
+	int ToolBeginIndex;
+	float ToolBeginValue;
+	int ToolEndIndex;
+	float ToolEndValue;
+	bool FVGEnded;
+	bool FVGUp; // If not up, then it's down
+	unsigned int AddAsUserDrawnDrawing;
+	int FillIndex; // Bar that filled the gap, valid once FVGEnded
+	int DrawnEndIndex; // EndIndex last submitted with UseTool, -1 = not drawn yet
+	bool DrawnHidden; // HideDrawing last submitted
+};
+
+// Bars and FVG's of one timeframe
+struct FVGTimeframe {
+	s_FVGResampler Resampler; // Builds this timeframe's bars from the chart bars (fvg_core.h)
+	s_FVGDetector Detector; // Its last three closed bars
+	s_FVGOpenGaps OpenGaps; // Its open FVG's by fill price (fvg_index.h)
+	std::vector<FVGRectangle> Rectangles; // Its FVG's, in bar order
+	std::vector<int> Dirty; // FVG's added or filled since the last draw, by bar (ToolEndIndex)
+};
+
+struct FVGState {
+	FVGTimeframe Timeframes[FVG_NUM_TIMEFRAMES];
+	s_FVGRangeIndex RangeIndex; // Chart bar lows/highs, shared by all timeframes
+};
+
 /*==============================================================================
 	This study is for drawing FVG's (Fair Value Gaps)
 ------------------------------------------------------------------------------*/
@@ -38,28 +71,17 @@ SCSFExport scsf_FVG(SCStudyInterfaceRef sc)
 	// General Settings
 	SCInputRef Input_FVGMaxBarLookback = sc.Input[SCInputIndex++];
 
-	const int MIN_START_INDEX = 2; // Need at least 3 bars [0,1,2]
+	// Higher Timeframe Settings: Bar Period, Up Color, Down Color for each
+	const int HTF_INPUT_START = SCInputIndex;
+	const int HTF_INPUTS_PER_TIMEFRAME = 3;
 
-	struct FVGRectangle {
-		int LineNumber;
-		int ToolBeginIndex;
-		float ToolBeginValue;
-		int ToolEndIndex;
-		float ToolEndValue;
-		bool FVGEnded;
-		bool FVGUp; // If not up, then it's down
-		unsigned int AddAsUserDrawnDrawing;
-	};
+	const int MIN_START_INDEX = 2; // Need at least 3 bars [0,1,2]
 
-	struct HLForBarIndex {
-		int Index;
-		float High;
-		float Low;
-	};
+	// FVG's found so far and the bars being built, for every timeframe. Kept between calls, only newly closed bars are scanned
+	FVGState* State = reinterpret_cast<FVGState*>(sc.GetPersistentPointer(0));
 
-	// Structs for FVG's and Bar High/Low/Index Data
-	std::vector<FVGRectangle>* FVGRectangles = reinterpret_cast<std::vector<FVGRectangle>*>(sc.GetPersistentPointer(0));
-	std::vector<HLForBarIndex> HLForBarIndexes;
+	// First closed bar not yet scanned
+	int& NextBarIndex = sc.GetPersistentInt(0);
 
 	// Tool Line Unique Number Start Point
 	int UniqueLineNumber = 8675309; // Jenny Jenny!
@@ -165,6 +187,30 @@ SCSFExport scsf_FVG(SCStudyInterfaceRef sc)
 		Input_FVGMaxBarLookback.SetInt(200);
 		Input_FVGMaxBarLookback.SetIntLimits(0, MAX_STUDY_LENGTH);
 
+		// Higher timeframes
+		const int DefaultPeriods[FVG_NUM_HIGHER_TIMEFRAMES] = { 0, 0, 0 };
+		const COLORREF DefaultUpColors[FVG_NUM_HIGHER_TIMEFRAMES] = { RGB(0, 102, 204), RGB(0, 51, 153), RGB(51, 0, 153) };
+		const COLORREF DefaultDnColors[FVG_NUM_HIGHER_TIMEFRAMES] = { RGB(204, 51, 51), RGB(153, 0, 51), RGB(102, 0, 0) };
+		for (int k = 0; k < FVG_NUM_HIGHER_TIMEFRAMES; k++)
+		{
+			SCInputRef Input_Period = sc.Input[HTF_INPUT_START + k * HTF_INPUTS_PER_TIMEFRAME];
+			SCInputRef Input_UpColor = sc.Input[HTF_INPUT_START + k * HTF_INPUTS_PER_TIMEFRAME + 1];
+			SCInputRef Input_DnColor = sc.Input[HTF_INPUT_START + k * HTF_INPUTS_PER_TIMEFRAME + 2];
+
+			Input_Period.Name.Format("HTF %d: Bar Period in Minutes (0 = Off)", k + 1);
+			Input_Period.SetDescription("Also Draw the FVG's of Bars of this Period, Built from the Chart Bars");
+			Input_Period.SetInt(DefaultPeriods[k]);
+			Input_Period.SetIntLimits(0, 1440);
+
+			Input_UpColor.Name.Format("HTF %d: FVG Up Color", k + 1);
+			Input_UpColor.SetDescription("Border and Fill Color of this Timeframe's FVG Up Rectangles");
+			Input_UpColor.SetColor(DefaultUpColors[k]);
+
+			Input_DnColor.Name.Format("HTF %d: FVG Down Color", k + 1);
+			Input_DnColor.SetDescription("Border and Fill Color of this Timeframe's FVG Down Rectangles");
+			Input_DnColor.SetColor(DefaultDnColors[k]);
+		}
+
 		return;
 	}
 
@@ -177,38 +223,49 @@ SCSFExport scsf_FVG(SCStudyInterfaceRef sc)
 		sc.DataStartIndex = (StartIdx < MIN_START_INDEX) ? MIN_START_INDEX : StartIdx;
 	}
 
-	if (FVGRectangles == NULL) {
-		// Array of FVGRectangle structs
-		FVGRectangles = new std::vector<FVGRectangle>;
-		sc.SetPersistentPointer(0, FVGRectangles);
+	// Bar period of each timeframe in seconds, 0 = the chart bars themselves
+	int PeriodSeconds[FVG_NUM_TIMEFRAMES];
+	PeriodSeconds[0] = 0;
+	for (int k = 1; k < FVG_NUM_TIMEFRAMES; k++)
+		PeriodSeconds[k] = sc.Input[HTF_INPUT_START + (k - 1) * HTF_INPUTS_PER_TIMEFRAME].GetInt() * 60;
+
+	if (State == NULL) {
+		State = new FVGState;
+		State->RangeIndex.Reset(0);
+		sc.SetPersistentPointer(0, State);
 	}
 
+	// Bars removed from the chart (e.g. reloaded with less data) invalidate the stored FVG's
+	bool BarsRemoved = (NextBarIndex > sc.ArraySize - 1);
+
 	// A study will be fully calculated/recalculated when it is added to a chart, any time its Input settings are changed,
 	// another study is added or removed from a chart, when the Study Window is closed with OK or the settings are applied.
 	// Or under other conditions which can cause a full recalculation.
-	if (sc.IsFullRecalculation || sc.LastCallToFunction || sc.HideStudy)
+	if (sc.IsFullRecalculation || sc.LastCallToFunction || sc.HideStudy || BarsRemoved)
 	{
 		// On a full recalculation non-user drawn advanced custom study drawings are automatically deleted
 		// So need to manually remove the User type drawings. Same with hiding study, if user type, need to manually remove them
-		if (FVGRectangles != NULL)
+		for (int k = 0; k < FVG_NUM_TIMEFRAMES; k++)
 		{
-			for (size_t i = 0; i < FVGRectangles->size(); i++)
+			std::vector<FVGRectangle>& Rectangles = State->Timeframes[k].Rectangles;
+			for (size_t i = 0; i < Rectangles.size(); i++)
 			{
-				if (FVGRectangles->at(i).AddAsUserDrawnDrawing)
-					sc.DeleteUserDrawnACSDrawing(sc.ChartNumber, FVGRectangles->at(i).LineNumber);
+				if (Rectangles[i].AddAsUserDrawnDrawing)
+					sc.DeleteUserDrawnACSDrawing(sc.ChartNumber, Rectangles[i].LineNumber);
 			}
 			// Drawings removed, now clear
-			FVGRectangles->clear();
+			Rectangles.clear();
+			State->Timeframes[k].OpenGaps.Clear();
+			State->Timeframes[k].Dirty.clear();
 		}
+		State->RangeIndex.Reset(0);
+		NextBarIndex = 0;
 
 		// Study is being removed - clean up memory
 		if (sc.LastCallToFunction)
 		{
-			if (FVGRectangles != NULL)
-			{
-				delete FVGRectangles;
-				sc.SetPersistentPointer(0, NULL);
-			}
+			delete State;
+			sc.SetPersistentPointer(0, NULL);
 			return;
 		}
 
@@ -216,87 +273,225 @@ SCSFExport scsf_FVG(SCStudyInterfaceRef sc)
 			return;
 	}
 
-	// Clear out structure to avoid continually adding onto it and causing memory/performance issues
-	if (FVGRectangles != NULL)
-		FVGRectangles->clear();
+	// FVG's from bars before the lookback are no longer updated. Their drawings stay as last drawn.
+	for (int k = 0; k < FVG_NUM_TIMEFRAMES; k++)
+	{
+		FVGTimeframe& Timeframe = State->Timeframes[k];
+		size_t NumExpired = 0;
+		while (NumExpired < Timeframe.Rectangles.size() && Timeframe.Rectangles[NumExpired].ToolEndIndex < sc.DataStartIndex)
+		{
+			const FVGRectangle& Expired = Timeframe.Rectangles[NumExpired];
+			if (!Expired.FVGEnded)
+				Timeframe.OpenGaps.Remove(Expired.FVGUp, Expired.ToolBeginValue, Expired.ToolEndIndex);
+			NumExpired++;
+		}
+		if (NumExpired > 0)
+			Timeframe.Rectangles.erase(Timeframe.Rectangles.begin(), Timeframe.Rectangles.begin() + NumExpired);
+	}
 
 	// Min Gap Tick Size
 	float FVGUpMinTickSize = float(Input_FVGUpMinGapSizeInTicks.GetInt()) * sc.TickSize;
 	float FVGDnMinTickSize = float(Input_FVGDnMinGapSizeInTicks.GetInt()) * sc.TickSize;
 
-	// Loop through bars and process FVG's
-	// 1 is the current bar that is closed
-	// 3 is the 3rd bar back from current bar
-	for (int BarIndex = sc.DataStartIndex; BarIndex < sc.ArraySize - 1; BarIndex++)
+	auto GetChartBar = [&](int BarIndex) -> s_FVGBar
 	{
-		// Store HL for each bar index. May need to revisit to see if better way
-		HLForBarIndex TmpHLForBarIndex = {
-			BarIndex,
-			sc.High[BarIndex],
-			sc.Low[BarIndex]
-		};
-		HLForBarIndexes.push_back(TmpHLForBarIndex);
-
-		//
-		// H1, H3, L1, L3 logic borrowed from this indicator
-		// https://www.tradingview.com/script/u8mKo7pb-muh-gap-FAIR-VALUE-GAP-FINDER/
-		float L1 = sc.Low[BarIndex];
-		float H1 = sc.High[BarIndex];
-		float L3 = sc.Low[BarIndex - 2];
-		float H3 = sc.High[BarIndex - 2];
-
-		bool FVGUp = (H3 < L1) && (L1 - H3 >= FVGUpMinTickSize);
-		bool FVGDn = (L3 > H1) && (L3 - H1 >= FVGDnMinTickSize);
-
-		// Store the FVG Up
-		if (FVGUp && Input_FVGUpEnabled.GetYesNo())
+		s_FVGBar Bar = { sc.High[BarIndex], sc.Low[BarIndex], BarIndex, BarIndex };
+		return Bar;
+	};
+
+	// Loop through the closed bars not scanned yet and process FVG's
+	int FirstBarIndex = (NextBarIndex > sc.DataStartIndex) ? NextBarIndex : sc.DataStartIndex;
+
+	// The range index and the bars being built cover consecutive bars; start them over if the lookback skipped ahead
+	if (State->RangeIndex.GetEnd() != FirstBarIndex)
+	{
+		State->RangeIndex.Reset(FirstBarIndex);
+
+		for (int k = 0; k < FVG_NUM_TIMEFRAMES; k++)
 		{
-			FVGRectangle TmpUpRect = {
-				UniqueLineNumber + BarIndex, // Tool.LineNumber
-				BarIndex - 2, // Tool.BeginIndex
-				H3, // Tool.BeginValue
-				BarIndex,// Tool.EndIndex
-				L1, // Tool.EndValue
-				false, // FVGEnded
-				true, // FVGUp
-				Input_FVGUpAllowCopyToOtherCharts.GetYesNo() // AddAsUserDrawnDrawing
-			};
-			FVGRectangles->insert(FVGRectangles->end(), TmpUpRect);
+			FVGTimeframe& Timeframe = State->Timeframes[k];
+			Timeframe.Resampler.Reset(PeriodSeconds[k]);
+			Timeframe.Detector.Reset();
 		}
 
-		// Store the FVG Dn
-		if (FVGDn && Input_FVGDnEnabled.GetYesNo())
+		// Chart bars 3 and 2 of the first bar scanned come from before it
+		s_FVGGap UnusedGap;
+		State->Timeframes[0].Detector.Add(GetChartBar(FirstBarIndex - 2), FVGUpMinTickSize, FVGDnMinTickSize, UnusedGap);
+		State->Timeframes[0].Detector.Add(GetChartBar(FirstBarIndex - 1), FVGUpMinTickSize, FVGDnMinTickSize, UnusedGap);
+
+		// A higher timeframe bar already under way is built from its first chart bar, so it is not cut short
+		for (int k = 1; k < FVG_NUM_TIMEFRAMES; k++)
+		{
+			s_FVGResampler& Resampler = State->Timeframes[k].Resampler;
+			if (PeriodSeconds[k] == 0)
+				continue;
+
+			SCDateTime FirstDateTime = sc.BaseDateTimeIn[FirstBarIndex];
+			long long FirstKey = Resampler.GetKey(FirstDateTime.GetDate(), FirstDateTime.GetTimeInSeconds());
+			int StartIndex = FirstBarIndex;
+			while (StartIndex > 0
+				&& Resampler.GetKey(sc.BaseDateTimeIn[StartIndex - 1].GetDate(), sc.BaseDateTimeIn[StartIndex - 1].GetTimeInSeconds()) == FirstKey)
+				StartIndex--;
+
+			s_FVGBar UnusedBar;
+			for (int BarIndex = StartIndex; BarIndex < FirstBarIndex; BarIndex++)
+			{
+				SCDateTime BarDateTime = sc.BaseDateTimeIn[BarIndex];
+				Resampler.Add(BarIndex, BarDateTime.GetDate(), BarDateTime.GetTimeInSeconds(), sc.High[BarIndex], sc.Low[BarIndex], UnusedBar);
+			}
+		}
+	}
+
+	// Stored FVG's are in bar order, found by their bar (1)
+	auto FindRect = [](std::vector<FVGRectangle>& Rectangles, int BarIndex) -> FVGRectangle&
+	{
+		return *std::lower_bound(Rectangles.begin(), Rectangles.end(), BarIndex,
+			[](const FVGRectangle& Rect, int Index) { return Rect.ToolEndIndex < Index; });
+	};
+
+	// Tool line numbers of each timeframe start at their own block
+	const int TIMEFRAME_LINE_NUMBER_STEP = 100000000;
+
+	size_t FirstNewRect[FVG_NUM_TIMEFRAMES];
+	for (int k = 0; k < FVG_NUM_TIMEFRAMES; k++)
+		FirstNewRect[k] = State->Timeframes[k].Rectangles.size();
+
+	std::vector<int> FilledIDs;
+
+	// One pass over the chart bars feeds every timeframe
+	for (int BarIndex = FirstBarIndex; BarIndex < sc.ArraySize - 1; BarIndex++)
+	{
+		State->RangeIndex.Append(sc.Low[BarIndex], sc.High[BarIndex], sc.DataStartIndex);
+
+		SCDateTime BarDateTime = sc.BaseDateTimeIn[BarIndex];
+		int BarDate = BarDateTime.GetDate();
+		int BarTime = BarDateTime.GetTimeInSeconds();
+
+		for (int k = 0; k < FVG_NUM_TIMEFRAMES; k++)
 		{
-			FVGRectangle TmpDnRect = {
-				UniqueLineNumber + BarIndex, // Tool.LineNumber
-				BarIndex - 2, // Tool.BeginIndex
-				L3, // Tool.BeginValue
-				BarIndex,// Tool.EndIndex
-				H1, // Tool.EndValue
+			if (k > 0 && PeriodSeconds[k] == 0)
+				continue;
+
+			FVGTimeframe& Timeframe = State->Timeframes[k];
+
+			// Close the FVG's left open by earlier calls that this bar fills, in one lookup per side
+			// FVG Up is filled by an equal or lower Low than its bottom, FVG Down by an equal or higher High than its top
+			FilledIDs.clear();
+			Timeframe.OpenGaps.Fill(sc.Low[BarIndex], sc.High[BarIndex], FilledIDs);
+			for (size_t i = 0; i < FilledIDs.size(); i++)
+			{
+				FVGRectangle& Rect = FindRect(Timeframe.Rectangles, FilledIDs[i]);
+				Rect.FVGEnded = true;
+				Rect.FillIndex = BarIndex;
+				Timeframe.Dirty.push_back(Rect.ToolEndIndex);
+			}
+
+			// A chart bar closes a bar of this timeframe (every chart bar closes one of the chart's own), which
+			// is tested for a FVG with the two before it. 1 is the bar that closed, 3 is the 3rd bar back.
+			s_FVGBar ClosedBar;
+			s_FVGGap Gap;
+			if (!Timeframe.Resampler.Add(BarIndex, BarDate, BarTime, sc.High[BarIndex], sc.Low[BarIndex], ClosedBar)
+				|| !Timeframe.Detector.Add(ClosedBar, FVGUpMinTickSize, FVGDnMinTickSize, Gap))
+				continue;
+
+			bool FVGUp = (Gap.Direction == FVG_UP);
+			if (!(FVGUp ? Input_FVGUpEnabled.GetYesNo() : Input_FVGDnEnabled.GetYesNo()))
+				continue;
+
+			// Store the FVG
+			FVGRectangle TmpRect = {
+				UniqueLineNumber + k * TIMEFRAME_LINE_NUMBER_STEP + Gap.EndIndex, // Tool.LineNumber
+				Gap.BeginIndex, // Tool.BeginIndex
+				Gap.BeginValue, // Tool.BeginValue
+				Gap.EndIndex,// Tool.EndIndex
+				Gap.EndValue, // Tool.EndValue
 				false, // FVGEnded
-				false,  // FVGUp
-				Input_FVGDnAllowCopyToOtherCharts.GetYesNo() // AddAsUserDrawnDrawing
+				FVGUp, // FVGUp
+				FVGUp ? Input_FVGUpAllowCopyToOtherCharts.GetYesNo() : Input_FVGDnAllowCopyToOtherCharts.GetYesNo(), // AddAsUserDrawnDrawing
+				-1, // FillIndex
+				-1, // DrawnEndIndex
+				false // DrawnHidden
 			};
-			FVGRectangles->insert(FVGRectangles->end(), TmpDnRect);
+			Timeframe.Rectangles.push_back(TmpRect);
+			Timeframe.Dirty.push_back(TmpRect.ToolEndIndex);
 		}
 	}
 
+	// FVG's found in this call: the first later bar that fills each one is a range index query
+	for (int k = 0; k < FVG_NUM_TIMEFRAMES; k++)
+	{
+		FVGTimeframe& Timeframe = State->Timeframes[k];
+		for (size_t i = FirstNewRect[k]; i < Timeframe.Rectangles.size(); i++)
+		{
+			FVGRectangle& Rect = Timeframe.Rectangles[i];
+			int FillIndex = State->RangeIndex.FindFill(Rect.FVGUp, Rect.ToolEndIndex + 1, Rect.ToolBeginValue);
+
+			if (FillIndex >= 0)
+			{
+				Rect.FVGEnded = true;
+				Rect.FillIndex = FillIndex;
+			}
+			else
+				Timeframe.OpenGaps.Add(Rect.FVGUp, Rect.ToolBeginValue, Rect.ToolEndIndex);
+		}
+	}
+
+	if (sc.ArraySize - 1 > NextBarIndex)
+		NextBarIndex = sc.ArraySize - 1;
+
 	// Draw FVG Rectangles
-	for (size_t i = 0; i < FVGRectangles->size(); i++)
+	// Only FVG's that can have changed since the last draw are visited: the ones added or filled since then, and the
+	// open ones that extend to the last bar. Of those, only the ones whose end or visibility changed are submitted.
+	// Style inputs only change with a full recalculation, which starts the list over.
+	bool UpExtendRight = Input_FVGUpExtendRight.GetYesNo() != 0;
+	bool DnExtendRight = Input_FVGDnExtendRight.GetYesNo() != 0;
+	bool UpHideWhenFilled = Input_FVGUpHideWhenFilled.GetYesNo() != 0;
+	bool DnHideWhenFilled = Input_FVGDnHideWhenFilled.GetYesNo() != 0;
+
+	auto DrawRect = [&](int k, FVGRectangle& Rect)
 	{
+		bool ExtendRight = Rect.FVGUp ? UpExtendRight : DnExtendRight;
+		bool HideWhenFilled = Rect.FVGUp ? UpHideWhenFilled : DnHideWhenFilled;
+
+		int EndIndex = Rect.ToolEndIndex;
+		bool Hidden = false;
+		if (Rect.FVGEnded)
+		{
+			// FVG has ended, so then see if we want to show it or not...
+			Hidden = HideWhenFilled;
+
+			// Extending, so show it up to the bar that filled it
+			if (ExtendRight)
+				EndIndex = Rect.FillIndex;
+		}
+		else
+		{
+			// If here, the FVG has not ended, so set to last bar if extending
+			if (ExtendRight)
+				EndIndex = sc.ArraySize - 1;
+		}
+
+		if (EndIndex == Rect.DrawnEndIndex && Hidden == Rect.DrawnHidden)
+			return;
+
 		s_UseTool Tool;
 		Tool.Clear();
 		Tool.ChartNumber = sc.ChartNumber;
-		Tool.LineNumber = FVGRectangles->at(i).LineNumber;
+		Tool.LineNumber = Rect.LineNumber;
 		Tool.DrawingType = DRAWING_RECTANGLEHIGHLIGHT;
 		Tool.AddMethod = UTAM_ADD_OR_ADJUST;
 
-		Tool.BeginIndex = FVGRectangles->at(i).ToolBeginIndex;
-		Tool.BeginValue = FVGRectangles->at(i).ToolBeginValue;
-		Tool.EndIndex = FVGRectangles->at(i).ToolEndIndex;
-		Tool.EndValue = FVGRectangles->at(i).ToolEndValue;
+		Tool.BeginIndex = Rect.ToolBeginIndex;
+		Tool.BeginValue = Rect.ToolBeginValue;
+		Tool.EndIndex = EndIndex;
+		Tool.EndValue = Rect.ToolEndValue;
+		Tool.HideDrawing = Hidden ? 1 : 0;
 
-		if (FVGRectangles->at(i).FVGUp)
+		// If we want to allow this to show up on other charts, need to set it to user drawing
+		Tool.AddAsUserDrawnDrawing = Rect.AddAsUserDrawnDrawing;
+		Tool.AllowCopyToOtherCharts = Rect.AddAsUserDrawnDrawing;
+
+		if (Rect.FVGUp)
 		{
 			// FVG Up
 			Tool.Color = Input_FVGUpLineColor.GetColor();
@@ -304,43 +499,6 @@ SCSFExport scsf_FVG(SCStudyInterfaceRef sc)
 			Tool.LineWidth = Input_FVGUpLineWidth.GetInt();
 			Tool.TransparencyLevel = Input_FVGUpTransparencyLevel.GetInt();
 			Tool.DrawMidline = Input_FVGUpDrawMidline.GetYesNo();
-
-			// If we want to allow this to show up on other charts, need to set it to user drawing
-			Tool.AddAsUserDrawnDrawing = FVGRectangles->at(i).AddAsUserDrawnDrawing;
-			Tool.AllowCopyToOtherCharts = FVGRectangles->at(i).AddAsUserDrawnDrawing;
-
-			// In our High/Low Bar Index, check if we have an equal or lower Low than the FVG
-			// If True, then this FVG will end at that index if extending Right
-			auto it = find_if(
-				HLForBarIndexes.begin(),
-				HLForBarIndexes.end(),
-				[=](HLForBarIndex& HLIndex)
-				{
-					return HLIndex.Index > FVGRectangles->at(i).ToolEndIndex && HLIndex.Low <= FVGRectangles->at(i).ToolBeginValue;
-				}
-			);
-			// If true, we have an end index for this FVG and it hasn't yet been flagged as ended
-			if (it != HLForBarIndexes.end() && !FVGRectangles->at(i).FVGEnded)
-			{
-				// FVG has ended, so then see if we want to show it or not...
-				if (Input_FVGUpHideWhenFilled.GetYesNo())
-					Tool.HideDrawing = 1;
-				else
-					Tool.HideDrawing = 0;
-
-				// If here, we have an ending FVG that we want to show... Now need to see which EndIndex to use
-				if (Input_FVGUpExtendRight.GetYesNo())
-					Tool.EndIndex = it->Index; // Extending, so show it based on where we found the equal/lower bar low index
-
-				// Flag this as ended now
-				FVGRectangles->at(i).FVGEnded = true;
-			}
-			else
-			{
-				// If here, the FVG has not ended, so set to last closed bar if extending
-				if (Input_FVGUpExtendRight.GetYesNo())
-					Tool.EndIndex = sc.ArraySize - 1;
-			}
 		}
 		else
 		{
@@ -350,44 +508,38 @@ SCSFExport scsf_FVG(SCStudyInterfaceRef sc)
 			Tool.LineWidth = Input_FVGDnLineWidth.GetInt();
 			Tool.TransparencyLevel = Input_FVGDnTransparencyLevel.GetInt();
 			Tool.DrawMidline = Input_FVGDnDrawMidline.GetYesNo();
+		}
 
-			// If we want to allow this to show up on other charts, need to set it to user drawing
-			Tool.AddAsUserDrawnDrawing = FVGRectangles->at(i).AddAsUserDrawnDrawing;
-			Tool.AllowCopyToOtherCharts = FVGRectangles->at(i).AddAsUserDrawnDrawing;
-
-			// In our High/Low Bar Index, check if we have an equal or higher High than the FVG
-			// If True, then this FVG will end at that index if extending Right
-			auto it = find_if(
-				HLForBarIndexes.begin(),
-				HLForBarIndexes.end(),
-				[=](HLForBarIndex& HLIndex)
-				{
-					return HLIndex.Index > FVGRectangles->at(i).ToolEndIndex && HLIndex.High >= FVGRectangles->at(i).ToolBeginValue;
-				}
-			);
-			// If true, we have an end index for this FVG and it hasn't yet been flagged as ended
-			if (it != HLForBarIndexes.end() && !FVGRectangles->at(i).FVGEnded)
-			{
-				// FVG has ended, so then see if we want to show it or not...
-				if (Input_FVGDnHideWhenFilled.GetYesNo())
-					Tool.HideDrawing = 1;
-				else
-					Tool.HideDrawing = 0;
-
-				// If here, we have an ending FVG that we want to show... Now need to see which EndIndex to use
-				if (Input_FVGDnExtendRight.GetYesNo())
-					Tool.EndIndex = it->Index; // Extending, so show it based on where we found the equal/lower bar low index
-
-				// Flag this as ended now
-				FVGRectangles->at(i).FVGEnded = true;
-			}
-			else
-			{
-				// If here, the FVG has not ended, so set to last closed bar if extending
-				if (Input_FVGDnExtendRight.GetYesNo())
-					Tool.EndIndex = sc.ArraySize - 1;
-			}
+		// Higher timeframe FVG's take their timeframe's color for border and fill
+		if (k > 0)
+		{
+			Tool.Color = sc.Input[HTF_INPUT_START + (k - 1) * HTF_INPUTS_PER_TIMEFRAME + (Rect.FVGUp ? 1 : 2)].GetColor();
+			Tool.SecondaryColor = Tool.Color;
 		}
 		sc.UseTool(Tool);
+
+		Rect.DrawnEndIndex = EndIndex;
+		Rect.DrawnHidden = Hidden;
+	};
+
+	for (int k = 0; k < FVG_NUM_TIMEFRAMES; k++)
+	{
+		FVGTimeframe& Timeframe = State->Timeframes[k];
+
+		for (size_t i = 0; i < Timeframe.Dirty.size(); i++)
+			DrawRect(k, FindRect(Timeframe.Rectangles, Timeframe.Dirty[i]));
+		Timeframe.Dirty.clear();
+
+		// Open FVG's move with the last bar only when extending
+		if (UpExtendRight)
+		{
+			for (std::multimap<float, int>::iterator it = Timeframe.OpenGaps.Up.begin(); it != Timeframe.OpenGaps.Up.end(); ++it)
+				DrawRect(k, FindRect(Timeframe.Rectangles, it->second));
+		}
+		if (DnExtendRight)
+		{
+			for (std::multimap<float, int>::iterator it = Timeframe.OpenGaps.Down.begin(); it != Timeframe.OpenGaps.Down.end(); ++it)
+				DrawRect(k, FindRect(Timeframe.Rectangles, it->second));
+		}
 	}
-}
\ No newline at end of file
+}
@@ -1,9 +1,185 @@
 #include "sierrachart.h"
+#include <vector>
+#include <algorithm>
+#include "gdi_resource_cache.h"
 SCDLLName("HighLowCounts")
 
 
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc);
 
+// session times from the inputs, as hours and minutes
+struct s_HighLowTimes
+{
+    int SessionStartHour;
+    int SessionStartMinute;
+    int SessionEndHour;
+    int SessionEndMinute;
+    int NoonIdxHour;
+    int NoonIdxMinute;
+};
+
+// new highs/lows of day counted so far in the current session
+struct s_HighLowCounter
+{
+    float PrevHod;
+    int PrevHodIdx;
+    int NumHighs;
+    float PrevLod;
+    int PrevLodIdx;
+    int NumLows;
+    int NoonIdx;        // -1 = the last visible bar, looked up when drawn
+    int FirstIdx;       // first bar counted in this session, -1 = none yet
+
+    void Reset()
+    {
+        PrevHod = 0;
+        PrevHodIdx = 0;
+        NumHighs = 0;
+        PrevLod = 0;
+        PrevLodIdx = 0;
+        NumLows = 0;
+        NoonIdx = 0;
+        FirstIdx = -1;
+    }
+};
+
+// counts as of a bar that gets the numbers drawn: the session end time bar, or the last bar
+struct s_HighLowLabel
+{
+    int Idx;
+    int Day;
+    s_HighLowCounter Counts;
+};
+
+struct s_HighLowCountsState
+{
+    int NextIdx;                            // first closed bar not counted yet
+    s_HighLowCounter Counter;               // counts after the closed bars
+    std::vector<s_HighLowLabel> Labels;     // labels of closed bars, in bar order
+    bool HasLiveLabel;                      // label of the last bar, redone each call while it forms
+    s_HighLowLabel LiveLabel;
+
+    void Reset()
+    {
+        NextIdx = 0;
+        Counter.Reset();
+        Labels.clear();
+        HasLiveLabel = false;
+    }
+};
+
+static s_HighLowTimes GetHighLowTimes(SCStudyInterfaceRef sc)
+{
+    SCDateTime SessionStart = sc.Input[3].GetDateTime();
+    SCDateTime SessionEnd = sc.Input[4].GetDateTime();
+    SCDateTime NoonIdxDateTime = sc.Input[5].GetDateTime();
+
+    s_HighLowTimes Times;
+    Times.SessionStartHour = SessionStart.GetHour();
+    Times.SessionStartMinute = SessionStart.GetMinute();
+    Times.SessionEndHour = SessionEnd.GetHour();
+    Times.SessionEndMinute = SessionEnd.GetMinute();
+    Times.NoonIdxHour = NoonIdxDateTime.GetHour();
+    Times.NoonIdxMinute = NoonIdxDateTime.GetMinute();
+    return Times;
+}
+
+// adds bar i to the counts. returns false if it is before the session start or the first bar of a day,
+// which resets the counts instead. IsEndBar is set if the bar is at the session end time.
+static bool CountBar(SCStudyInterfaceRef sc, int i, const s_HighLowTimes& Times, s_HighLowCounter& Counter, bool& IsEndBar)
+{
+    // grab the date and time for the bar thats being processed
+    SCDateTime BarDateTime = sc.BaseDateTimeIn[i];
+    int Day = BarDateTime.GetDay();
+    SCDateTime PrevBarDateTime = sc.BaseDateTimeIn[i > 0 ? i - 1 : 0];
+    int PrevBarDay = PrevBarDateTime.GetDay();
+    int Hour = BarDateTime.GetHour();
+    int Minute = BarDateTime.GetMinute();
+
+    IsEndBar = false;
+
+    // if its 930am then reset all our counters
+    if (Hour < Times.SessionStartHour || Day != PrevBarDay || (Hour == Times.SessionStartHour && Minute < Times.SessionStartMinute)) {
+        Counter.Reset();
+        return false;
+    }
+
+    if (Counter.FirstIdx < 0)
+        Counter.FirstIdx = i;
+
+    // check if curr bar's high is > prev hod
+    if (sc.High[i] > Counter.PrevHod) {
+        // set a new hod
+        Counter.PrevHod = sc.High[i];
+        Counter.PrevHodIdx = i;
+        // increment num of highs we've had today
+        Counter.NumHighs++;
+    }
+    // check if curr bar's low is < prev lod
+    if (sc.Low[i] < Counter.PrevLod || Counter.PrevLod == 0) {
+        // set new lod
+        Counter.PrevLod = sc.Low[i];
+        Counter.PrevLodIdx = i;
+        // increment num of low of days we have today
+        Counter.NumLows++;
+    }
+
+    // NoonIdx the bar index of noon, I used this as a way to make the numbers appear in a centered place, consistently
+    if (Hour < Times.NoonIdxHour) {
+        Counter.NoonIdx = -1;
+    }
+    else if (Hour == Times.NoonIdxHour && Times.NoonIdxMinute == 0) {
+        Counter.NoonIdx = i;
+    }
+
+    IsEndBar = (Hour == Times.SessionEndHour && Minute == Times.SessionEndMinute);
+    return true;
+}
+
+static int GetLabelNoonIdx(SCStudyInterfaceRef sc, const s_HighLowLabel& Label)
+{
+    return Label.Counts.NoonIdx < 0 ? sc.IndexOfLastVisibleBar : Label.Counts.NoonIdx;
+}
+
+// dotted lines from the hod/lod bars to the numbers
+static void DrawLabelLines(SCStudyInterfaceRef sc, const s_HighLowLabel& Label)
+{
+    int VerticalOffset = sc.Input[0].GetInt();
+    int NoonIdx = GetLabelNoonIdx(sc, Label);
+
+    s_UseTool Tool;
+
+    Tool.ChartNumber = sc.ChartNumber;
+    Tool.LineNumber = 52320220 + Label.Day;
+    Tool.DrawingType = DRAWING_LINE;
+    Tool.LineStyle = LINESTYLE_DOT;
+    Tool.BeginValue = Label.Counts.PrevHod;
+    Tool.BeginIndex = Label.Counts.PrevHodIdx;
+    Tool.EndValue = Label.Counts.PrevHod + (sc.TickSize * VerticalOffset);
+    Tool.EndIndex = NoonIdx;
+    Tool.AddMethod = UTAM_ADD_OR_ADJUST;
+    Tool.LineWidth = 1;
+    Tool.Region = 0;
+    Tool.Color = sc.Subgraph[0].PrimaryColor;
+    sc.UseTool(Tool);
+
+    Tool.Clear();
+
+    Tool.ChartNumber = sc.ChartNumber;
+    Tool.LineNumber = 5232022 - Label.Day;
+    Tool.DrawingType = DRAWING_LINE;
+    Tool.LineStyle = LINESTYLE_DOT;
+    Tool.BeginValue = Label.Counts.PrevLod;
+    Tool.BeginIndex = Label.Counts.PrevLodIdx;
+    Tool.EndValue = Label.Counts.PrevLod - (sc.TickSize * VerticalOffset);
+    Tool.EndIndex = NoonIdx;
+    Tool.AddMethod = UTAM_ADD_OR_ADJUST;
+    Tool.LineWidth = 1;
+    Tool.Region = 0;
+    Tool.Color = sc.Subgraph[1].PrimaryColor;
+    sc.UseTool(Tool);
+}
+
 SCSFExport scsf_NumHighsLows(SCStudyInterfaceRef sc)
 {
     // logging object
@@ -26,6 +202,7 @@ SCSFExport scsf_NumHighsLows(SCStudyInterfaceRef sc)
     {
         sc.GraphName = "Number of Highs/Lows";
         sc.GraphRegion = 1;
+        sc.AutoLoop = 0;
 
         s_NumHighs.Name = "Number of Highs";
         s_NumHighs.PrimaryColor = COLOR_YELLOW;
@@ -57,52 +234,142 @@ SCSFExport scsf_NumHighsLows(SCStudyInterfaceRef sc)
         return;
     }
 
+    // counts and labels are kept between calls, so each bar is counted once here instead of on every repaint
+    s_HighLowCountsState* State = reinterpret_cast<s_HighLowCountsState*>(sc.GetPersistentPointer(0));
+
+    // fonts for the GDI call, created once instead of on every paint
+    s_GDIResourceCache* GDIResources = reinterpret_cast<s_GDIResourceCache*>(sc.GetPersistentPointer(1));
+
+    // study is being removed - clean up memory
+    if (sc.LastCallToFunction)
+    {
+        if (State != NULL)
+        {
+            delete State;
+            sc.SetPersistentPointer(0, NULL);
+        }
+        if (GDIResources != NULL)
+        {
+            delete GDIResources;
+            sc.SetPersistentPointer(1, NULL);
+        }
+        return;
+    }
+
+    if (State == NULL)
+    {
+        State = new s_HighLowCountsState;
+        State->Reset();
+        sc.SetPersistentPointer(0, State);
+    }
+
+    if (GDIResources == NULL)
+    {
+        GDIResources = new s_GDIResourceCache;
+        sc.SetPersistentPointer(1, GDIResources);
+    }
+
+    // start over on a recalculation, or if bars were removed
+    if (sc.IsFullRecalculation || sc.UpdateStartIndex == 0 || State->NextIdx > sc.ArraySize - 1)
+        State->Reset();
+
+    if (sc.ArraySize == 0)
+        return;
+
+    s_HighLowTimes Times = GetHighLowTimes(sc);
+    bool IsEndBar;
+
+    // closed bars not counted yet
+    for (int i = State->NextIdx; i < sc.ArraySize - 1; i++) {
+        if (!CountBar(sc, i, Times, State->Counter, IsEndBar)) {
+            s_NumHighs[i] = 0;
+            s_NumLows[i] = 0;
+            continue;
+        }
+
+        // plot Num highs onto subgraph
+        s_NumHighs[i] = State->Counter.NumHighs;
+        // plot Num lows onto subgraph
+        s_NumLows[i] = State->Counter.NumLows;
+
+        if (IsEndBar) {
+            s_HighLowLabel Label = { i, sc.BaseDateTimeIn[i].GetDay(), State->Counter };
+            State->Labels.push_back(Label);
+            DrawLabelLines(sc, Label);
+        }
+    }
+    if (sc.ArraySize - 1 > State->NextIdx)
+        State->NextIdx = sc.ArraySize - 1;
+
+    // the last bar is still forming: count it on a copy, it is counted for good once it closes
+    int LastIdx = sc.ArraySize - 1;
+    s_HighLowCounter Live = State->Counter;
+    State->HasLiveLabel = CountBar(sc, LastIdx, Times, Live, IsEndBar);
+    s_NumHighs[LastIdx] = State->HasLiveLabel ? Live.NumHighs : 0;
+    s_NumLows[LastIdx] = State->HasLiveLabel ? Live.NumLows : 0;
+    if (State->HasLiveLabel) {
+        s_HighLowLabel Label = { LastIdx, sc.BaseDateTimeIn[LastIdx].GetDay(), Live };
+        State->LiveLabel = Label;
+        DrawLabelLines(sc, Label);
+    }
+
     // draw
     sc.p_GDIFunction = DrawToChart;
 }
 
 
-void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
+// numbers for one label: highs above the hod, lows below the lod. text outside the chart window is skipped
+static void DrawLabelText(HDC DeviceContext, SCStudyInterfaceRef sc, const s_HighLowLabel& Label, const s_GDIClipArea& ClipArea)
 {
-    // subgraphs
-    SCSubgraphRef s_NumHighs = sc.Subgraph[0];
-    SCSubgraphRef s_NumLows = sc.Subgraph[1];
-
-    // grab inputs
+    SCString msg;
     int VerticalOffset = sc.Input[0].GetInt();
     int HorizontalOffset = sc.Input[1].GetInt();
-    SCDateTime SessionStart = sc.Input[3].GetDateTime();
-    SCDateTime SessionEnd = sc.Input[4].GetDateTime();
-    SCDateTime NoonIdxDateTime = sc.Input[5].GetDateTime();
+    const COLORREF NewHighsColor = sc.Subgraph[0].PrimaryColor;
+    const COLORREF NewLowsColor = sc.Subgraph[1].PrimaryColor;
+
+    int topX = sc.BarIndexToXPixelCoordinate(GetLabelNoonIdx(sc, Label)) + HorizontalOffset;
+    // main chart graph
+    int topY = sc.RegionValueToYPixelCoordinate(Label.Counts.PrevHod, 0);
+    int bottomY = sc.RegionValueToYPixelCoordinate(Label.Counts.PrevLod, 0);
 
-    int SessionStartHour = SessionStart.GetHour();
-    int SessionStartMinute = SessionStart.GetMinute();
-    int SessionEndHour = SessionEnd.GetHour();
-    int SessionEndMinute = SessionEnd.GetMinute();
-    int NoonIdxHour = NoonIdxDateTime.GetHour();
-    int NoonIdxMinute = NoonIdxDateTime.GetMinute();
+    // a count is at most a few digits of font size width
+    int fontSize = sc.Input[2].GetInt();
+    int maxTextWidth = 4 * fontSize;
 
-    int topX;
-    int topY;
-    int bottomX;
-    int bottomY;
-    SCString msg, log;
+    // had to do some fudging of the offsets here to make things look right to human eye
+    if (ClipArea.IsTextVisible(topX, topY - (2*VerticalOffset), maxTextWidth, fontSize)) {
+        msg.Format("%d", Label.Counts.NumHighs);
+        ::SetTextColor(DeviceContext, NewHighsColor);
+        ::TextOut(DeviceContext, topX, topY - (2*VerticalOffset), msg, msg.GetLength());
+    }
+
+    // had to do some fudging of the offsets here to make things look right to human eye
+    if (ClipArea.IsTextVisible(topX, bottomY - (VerticalOffset/2), maxTextWidth, fontSize)) {
+        msg.Format("%d", Label.Counts.NumLows);
+        ::SetTextColor(DeviceContext, NewLowsColor);
+        ::TextOut(DeviceContext, topX, bottomY - (VerticalOffset/2), msg, msg.GetLength());
+    }
+}
+
+
+void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
+{
+    // counts are kept up to date by the study function, this only draws them
+    const s_HighLowCountsState* State = reinterpret_cast<const s_HighLowCountsState*>(sc.GetPersistentPointer(0));
+    s_GDIResourceCache* GDIResources = reinterpret_cast<s_GDIResourceCache*>(sc.GetPersistentPointer(1));
+    if (State == NULL || GDIResources == NULL)
+        return;
 
     // grab the name of the font used in this chartbook
     int fontSize = sc.Input[2].GetInt();
     SCString chartFont = sc.ChartTextFont();
 
-    // Windows GDI font creation
-    // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-createfonta
-    HFONT hFont;
-    hFont = CreateFont(fontSize,0,0,0,FW_NORMAL,FALSE,FALSE,FALSE,DEFAULT_CHARSET,OUT_OUTLINE_PRECIS,
-            CLIP_DEFAULT_PRECIS,CLEARTYPE_QUALITY, DEFAULT_PITCH,TEXT(chartFont));
+    // Windows GDI font, created on the first paint and kept (gdi_resource_cache.h)
+    HFONT hFont = GDIResources->GetFont(chartFont.GetChars(), fontSize, FW_NORMAL);
 
     // https://docs.microsoft.com/en-us/windows/win32/gdi/colorref
     const COLORREF wht = COLOR_WHITE;
     const COLORREF blk = COLOR_BLACK;
-    const COLORREF NewHighsColor = sc.Subgraph[0].PrimaryColor;
-    const COLORREF NewLowsColor = sc.Subgraph[1].PrimaryColor;
     // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-settextcolor
     ::SetTextColor(DeviceContext, wht);
     ::SetBkColor(DeviceContext, blk);
@@ -110,126 +377,24 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     // Windows GDI transparency
     // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-setbkmode
     SetBkMode(DeviceContext, OPAQUE);
-    SelectObject(DeviceContext, hFont);
-
-    // grab the memory address of f0
-    float &PrevHod = sc.GetPersistentFloat(0);
-    int &PrevHodIdx = sc.GetPersistentInt(3);
-    int &NumHighs = sc.GetPersistentInt(0);
-    float &PrevLod = sc.GetPersistentFloat(1);
-    int &PrevLodIdx = sc.GetPersistentInt(4);
-    int &NumLows = sc.GetPersistentInt(1);
-    int &NoonIdx = sc.GetPersistentInt(2);
-
-    for (int i=0; i<sc.ArraySize; i++) {
-        // RESET at new day
-
-        // grab the date and time for the bar thats being processed
-        SCDateTime BarDateTime = sc.BaseDateTimeIn[i];
-        int Day = BarDateTime.GetDay();
-        SCDateTime PrevBarDateTime = sc.BaseDateTimeIn[i-1];
-        int PrevBarDay = PrevBarDateTime.GetDay();
-        int Hour = BarDateTime.GetHour();
-        int Minute = BarDateTime.GetMinute();
-
-        // if its 930am then reset all our counters
-        if (Hour < SessionStartHour || Day != PrevBarDay || (Hour == SessionStartHour && Minute < SessionStartMinute)) {
-            // reset
-            PrevHod = 0;
-            PrevHodIdx = 0;
-            NumHighs = 0;
-            PrevLod = 0;
-            PrevLodIdx = 0;
-            NumLows = 0;
-            NoonIdx = 0;
-            continue;
-        }
+    ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
 
-        // check if curr bar's high is > prev hod
-        if (sc.High[i] > PrevHod) {
-            // set a new hod
-            PrevHod = sc.High[i];
-            PrevHodIdx = i;
-            // increment num of highs we've had today
-            NumHighs++;
-        }
-        // check if curr bar's low is < prev lod
-        if (sc.Low[i] < PrevLod || PrevLod == 0) {
-            // set new lod
-            PrevLod = sc.Low[i];
-            PrevLodIdx = i;
-            // increment num of low of days we have today
-            NumLows++;
-        }
+    // selected until this function returns, then the DC gets its own font back
+    s_GDISelectObject SelectFont(DeviceContext, hFont);
+    s_GDIClipArea ClipArea(WindowHandle);
 
-        // plot Num highs onto subgraph
-        s_NumHighs[i] = NumHighs;
-        // plot Num lows onto subgraph
-        s_NumLows[i] = NumLows;
+    // only the sessions with a bar in view. labels are in bar order, so the first one is a binary search
+    // and the loop stops at the first session starting past the view
+    int FirstVisible = sc.IndexOfFirstVisibleBar;
+    int LastVisible = sc.IndexOfLastVisibleBar;
 
-        // NoonIdx the bar index of noon, I used this as a way to make the numbers appear in a centered place, consistently
-        if (Hour < NoonIdxHour) {
-            NoonIdx = sc.IndexOfLastVisibleBar;
-        }
-        else if (Hour == NoonIdxHour && NoonIdxMinute == 0) {
-            NoonIdx = i;
-        }
-        if ((Hour == SessionEndHour && Minute == SessionEndMinute) || i == sc.ArraySize - 1) {
-            topX = sc.BarIndexToXPixelCoordinate(NoonIdx) + HorizontalOffset;
-            // main chart graph
-            topY = sc.RegionValueToYPixelCoordinate(PrevHod, 0);
-            bottomX = topX;
-            bottomY = sc.RegionValueToYPixelCoordinate(PrevLod, 0);
-
-            msg.Format("%d", NumHighs);
-            ::SetTextColor(DeviceContext, NewHighsColor);
-            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
-            // had to do some fudging of the offsets here to make things look right to human eye
-            ::TextOut(DeviceContext, topX, topY - (2*VerticalOffset), msg, msg.GetLength());
-
-            msg.Format("%d", NumLows);
-            ::SetTextColor(DeviceContext, NewLowsColor);
-            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
-            // had to do some fudging of the offsets here to make things look right to human eye
-            ::TextOut(DeviceContext, topX, bottomY - (VerticalOffset/2), msg, msg.GetLength());
-
-            // draw line
-            s_UseTool Tool;
-
-            Tool.ChartNumber = sc.ChartNumber;
-            Tool.LineNumber = 52320220 + Day;
-            Tool.DrawingType = DRAWING_LINE;
-            Tool.LineStyle = LINESTYLE_DOT;
-            Tool.BeginValue = PrevHod;
-            Tool.BeginIndex = PrevHodIdx;
-            Tool.EndValue = PrevHod + (sc.TickSize * VerticalOffset);
-            Tool.EndIndex = NoonIdx;
-            Tool.AddMethod = UTAM_ADD_OR_ADJUST;
-            Tool.LineWidth = 1;
-            Tool.Region = 0;
-            Tool.Color = sc.Subgraph[0].PrimaryColor;
-            sc.UseTool(Tool);
-
-            Tool.Clear();
-
-            Tool.ChartNumber = sc.ChartNumber;
-            Tool.LineNumber = 5232022 - Day;
-            Tool.DrawingType = DRAWING_LINE;
-            Tool.LineStyle = LINESTYLE_DOT;
-            Tool.BeginValue = PrevLod;
-            Tool.BeginIndex = PrevLodIdx;
-            Tool.EndValue = PrevLod - (sc.TickSize * VerticalOffset);
-            Tool.EndIndex = NoonIdx;
-            Tool.AddMethod = UTAM_ADD_OR_ADJUST;
-            Tool.LineWidth = 1;
-            Tool.Region = 0;
-            Tool.Color = sc.Subgraph[1].PrimaryColor;
-            sc.UseTool(Tool);
-        }
-    }
+    std::vector<s_HighLowLabel>::const_iterator it = std::lower_bound(State->Labels.begin(), State->Labels.end(), FirstVisible,
+        [](const s_HighLowLabel& Label, int Idx) { return Label.Idx < Idx; });
+    for (; it != State->Labels.end() && it->Counts.FirstIdx <= LastVisible; ++it)
+        DrawLabelText(DeviceContext, sc, *it, ClipArea);
 
-    // delete font
-    DeleteObject(hFont);
+    if (State->HasLiveLabel && State->LiveLabel.Idx >= FirstVisible && State->LiveLabel.Counts.FirstIdx <= LastVisible)
+        DrawLabelText(DeviceContext, sc, State->LiveLabel, ClipArea);
 
     return;
-}
\ No newline at end of file
+}
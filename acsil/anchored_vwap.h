@@ -0,0 +1,144 @@
+#ifndef ANCHORED_VWAP_H
+#define ANCHORED_VWAP_H
+
+/*
+    Anchored VWAP engine: running VWAP and standard deviation sums for a
+    fixed set of anchors, all advanced together once per bar.
+
+    The sums are kept as a struct of arrays, one array per quantity, indexed
+    by anchor. Committing a bar and evaluating the bands are straight loops
+    over every anchor slot with no branches (inactive slots are masked), so
+    the compiler vectorizes them across anchors and twenty anchors cost
+    little more than two. The commit loop vectorizes with default compiler
+    settings; the evaluate loop also needs sqrt to be treated as errno-free
+    (GCC/Clang: -fno-math-errno -fno-trapping-math). Where an anchor starts
+    (session, swing, ...) is the caller's business; the engine only
+    restarts the sums it is told to.
+
+    Like s_SessionVWAPAccumulator (session_vwap.h), closed bars are committed
+    exactly once and the forming bar is added on top at read time.
+    Platform independent.
+*/
+
+#include <cmath>
+
+const int MAX_VWAP_ANCHORS = 20;
+
+struct s_AnchoredVWAPEngine
+{
+    // Committed bars [StartIndex, FormingBarIndex) of each anchor, with the
+    // accumulated rounding error: the total is Sum + Compensation
+    double Volume[MAX_VWAP_ANCHORS];
+    double PV[MAX_VWAP_ANCHORS];
+    double P2V[MAX_VWAP_ANCHORS];
+    double VolumeC[MAX_VWAP_ANCHORS];
+    double PVC[MAX_VWAP_ANCHORS];
+    double P2VC[MAX_VWAP_ANCHORS];
+    double Active[MAX_VWAP_ANCHORS];    // 1.0 once the anchor has started, else 0.0
+    int StartIndex[MAX_VWAP_ANCHORS];   // First bar of the current anchor, -1 = not started
+    int FormingBarIndex;                // First bar not yet committed
+
+    void Reset()
+    {
+        for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+            Stop(a);
+        FormingBarIndex = 0;
+    }
+
+    // Sums restart at the forming bar, or at an earlier bar that the caller
+    // then re-commits with CommitOne
+    void Restart(int Anchor, int FirstIndex)
+    {
+        Volume[Anchor] = PV[Anchor] = P2V[Anchor] = 0.0;
+        VolumeC[Anchor] = PVC[Anchor] = P2VC[Anchor] = 0.0;
+        Active[Anchor] = 1.0;
+        StartIndex[Anchor] = FirstIndex;
+    }
+
+    void Stop(int Anchor)
+    {
+        Restart(Anchor, -1);
+        Active[Anchor] = 0.0;
+    }
+
+    // Compensated summation as accurate as s_CompensatedSum's Neumaier sum
+    // for either sign of value; P*V is negative on negative prices (spreads,
+    // some futures) and may then outweigh the running sum. Knuth's TwoSum
+    // gets the exact rounding error of each add with plain arithmetic and no
+    // magnitude compare, which keeps the anchor loops vectorizable.
+    static void AddCompensated(double& Sum, double& Compensation, double Value)
+    {
+        double t = Sum + Value;
+        double ValuePart = t - Sum;
+        Compensation += (Sum - (t - ValuePart)) + (Value - ValuePart);
+        Sum = t;
+    }
+
+    // VWAP and bands from totals; no volume gives 0 for all three
+    static void Bands(double TotalVol, double TotalPV, double TotalP2V, float Multiplier,
+        float& OutVWAP, float& OutTop, float& OutBottom)
+    {
+        bool Valid = TotalVol > 0.0;
+        double Divisor = Valid ? TotalVol : 1.0;
+        double VWAP = TotalPV / Divisor;
+        double Variance = TotalP2V / Divisor - VWAP * VWAP;
+        double Band = Multiplier * sqrt(Variance > 0.0 ? Variance : 0.0);
+
+        OutVWAP = Valid ? (float)VWAP : 0.0f;
+        OutTop = Valid ? (float)(VWAP + Band) : 0.0f;
+        OutBottom = Valid ? (float)(VWAP - Band) : 0.0f;
+    }
+
+    // Commits the forming bar to every started anchor
+    void Commit(float Price, float BarVolume)
+    {
+        double P = Price;
+        double V = BarVolume;
+
+        for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+        {
+            double W = V * Active[a];
+            AddCompensated(Volume[a], VolumeC[a], W);
+            AddCompensated(PV[a], PVC[a], P * W);
+            AddCompensated(P2V[a], P2VC[a], P * P * W);
+        }
+        FormingBarIndex++;
+    }
+
+    // Commits one earlier bar to one anchor, after Restart at a past bar
+    void CommitOne(int Anchor, float Price, float BarVolume)
+    {
+        double P = Price;
+        double V = BarVolume;
+        AddCompensated(Volume[Anchor], VolumeC[Anchor], V);
+        AddCompensated(PV[Anchor], PVC[Anchor], P * V);
+        AddCompensated(P2V[Anchor], P2VC[Anchor], P * P * V);
+    }
+
+    // VWAP and bands of every anchor including the forming bar (pass 0
+    // volume for none). Anchors that have not started, or have no volume
+    // yet, get 0 for all three.
+    void Evaluate(float Price, float BarVolume, float Multiplier,
+        float* OutVWAP, float* OutTop, float* OutBottom) const
+    {
+        double P = Price;
+        double V = BarVolume;
+
+        for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+        {
+            double W = V * Active[a];
+            Bands((Volume[a] + VolumeC[a]) + W, (PV[a] + PVC[a]) + P * W, (P2V[a] + P2VC[a]) + P * P * W,
+                Multiplier, OutVWAP[a], OutTop[a], OutBottom[a]);
+        }
+    }
+
+    // Evaluate for a single anchor, committed bars only, for redrawing one
+    // anchor's history without touching the others
+    void EvaluateOne(int Anchor, float Multiplier, float& OutVWAP, float& OutTop, float& OutBottom) const
+    {
+        Bands(Volume[Anchor] + VolumeC[Anchor], PV[Anchor] + PVC[Anchor], P2V[Anchor] + P2VC[Anchor],
+            Multiplier, OutVWAP, OutTop, OutBottom);
+    }
+};
+
+#endif // ANCHORED_VWAP_H
@@ -0,0 +1,262 @@
+#include "sierrachart.h"
+#include "anchored_vwap.h"
+
+SCDLLName("XYL - Anchored VWAPs")
+
+/*
+    Anchored VWAPs
+
+    Up to 20 VWAPs with standard deviation bands on one chart, each with its
+    own anchor:
+    - Session / Week / Month: restarts on the first bar of each trading day,
+      week (Monday based) or month.
+    - Swing High / Swing Low: restarts at the most recent pivot, a bar whose
+      high (low) is beyond the Swing Strength bars on either side. The pivot
+      is confirmed Swing Strength bars later; the VWAP is then redrawn from
+      the pivot.
+    - Date-Time: starts at the first bar at or after the anchor date-time
+      (news events and the like) and never restarts.
+
+    All anchors advance together in one pass per bar (anchored_vwap.h).
+    Each anchor has three subgraphs: VWAP, top band and bottom band.
+*/
+
+enum AnchorTypeEnum
+{
+    ANCHOR_OFF,
+    ANCHOR_SESSION,
+    ANCHOR_WEEK,
+    ANCHOR_MONTH,
+    ANCHOR_SWING_HIGH,
+    ANCHOR_SWING_LOW,
+    ANCHOR_DATE_TIME
+};
+
+const int NUM_DEFAULT_ANCHORS = 5;  // Session, Week, Month, Swing High, Swing Low
+
+// Calendar keys of a trading day date: a new key starts a new anchor
+static int GetWeekKey(int TradingDate)
+{
+    return (TradingDate - 2) / 7;   // Day 2 (1900-01-01) was a Monday
+}
+
+static int GetMonthKey(int TradingDate)
+{
+    SCDateTime Day;
+    Day.SetDate(TradingDate);
+    return Day.GetYear() * 12 + Day.GetMonth();
+}
+
+// True if bar Pivot is a swing high (Sign = 1) or low (Sign = -1) with
+// Strength bars on each side. The left side must be strictly exceeded, the
+// right side matched or exceeded, so a double top anchors at its first top.
+static bool IsSwingPivot(SCStudyInterfaceRef sc, int Pivot, int Strength, int Sign)
+{
+    if (Pivot - Strength < 0 || Pivot + Strength >= sc.ArraySize)
+        return false;
+
+    float Extreme = (Sign > 0) ? sc.High[Pivot] : -sc.Low[Pivot];
+    for (int k = 1; k <= Strength; k++)
+    {
+        float Left = (Sign > 0) ? sc.High[Pivot - k] : -sc.Low[Pivot - k];
+        float Right = (Sign > 0) ? sc.High[Pivot + k] : -sc.Low[Pivot + k];
+        if (Left >= Extreme || Right > Extreme)
+            return false;
+    }
+    return true;
+}
+
+// Restarts the calendar and date-time anchors that begin on Bar, the new
+// forming bar
+static void StartAnchors(SCStudyInterfaceRef sc, s_AnchoredVWAPEngine& Engine, const int* Types, const SCDateTime* AnchorTimes, int Bar)
+{
+    int Date = sc.GetTradingDayDate(sc.BaseDateTimeIn[Bar]);
+    int PrevDate = (Bar > 0) ? sc.GetTradingDayDate(sc.BaseDateTimeIn[Bar - 1]) : 0;
+
+    for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+    {
+        bool Start = false;
+        switch (Types[a])
+        {
+        case ANCHOR_SESSION:
+            Start = (Bar == 0 || Date != PrevDate);
+            break;
+        case ANCHOR_WEEK:
+            Start = (Bar == 0 || GetWeekKey(Date) != GetWeekKey(PrevDate));
+            break;
+        case ANCHOR_MONTH:
+            Start = (Bar == 0 || GetMonthKey(Date) != GetMonthKey(PrevDate));
+            break;
+        case ANCHOR_DATE_TIME:
+            Start = (AnchorTimes[a] <= sc.BaseDateTimeIn[Bar] && (Bar == 0 || sc.BaseDateTimeIn[Bar - 1] < AnchorTimes[a]));
+            break;
+        }
+
+        if (Start)
+            Engine.Restart(a, Bar);
+    }
+}
+
+SCSFExport scsf_AnchoredVWAPs(SCStudyInterfaceRef sc)
+{
+    // --- INPUTS ---
+    // Input 0 is shared; anchor a uses inputs 1 + 3a (type), 2 + 3a (swing
+    // strength) and 3 + 3a (anchor date-time)
+    SCInputRef Input_BandMultiplier = sc.Input[0];
+
+    // --- SUBGRAPHS ---
+    // Anchor a uses subgraphs 3a (VWAP), 3a + 1 (top band), 3a + 2 (bottom band)
+
+    if (sc.SetDefaults)
+    {
+        // Configuration
+        sc.GraphName = "Anchored VWAPs";
+        sc.StudyDescription = "Session, week, month, swing and date-time anchored VWAPs with SD bands, computed in one pass.";
+        sc.AutoLoop = 1;
+        sc.GraphRegion = 0;
+        sc.FreeDLL = 0;
+
+        Input_BandMultiplier.Name = "Band SD Multiplier";
+        Input_BandMultiplier.SetFloat(1.0f);
+
+        const COLORREF Colors[] = { RGB(255, 0, 255), RGB(0, 128, 255), RGB(255, 165, 0), RGB(255, 50, 50), RGB(0, 200, 0) };
+
+        for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+        {
+            SCInputRef Type = sc.Input[1 + 3 * a];
+            Type.Name.Format("Anchor %d Type", a + 1);
+            Type.SetCustomInputStrings("Off;Session;Week;Month;Swing High;Swing Low;Date-Time");
+            Type.SetCustomInputIndex(a < NUM_DEFAULT_ANCHORS ? a + 1 : ANCHOR_OFF);
+
+            SCInputRef SwingStrength = sc.Input[2 + 3 * a];
+            SwingStrength.Name.Format("Anchor %d Swing Strength (Bars)", a + 1);
+            SwingStrength.SetInt(5);
+            SwingStrength.SetIntLimits(1, 500);
+
+            SCInputRef AnchorDateTime = sc.Input[3 + 3 * a];
+            AnchorDateTime.Name.Format("Anchor %d Date-Time", a + 1);
+            AnchorDateTime.SetDateTime(0);
+
+            COLORREF Color = Colors[a % 5];
+
+            SCSubgraphRef VWAP = sc.Subgraph[3 * a];
+            VWAP.Name.Format("AVWAP %d", a + 1);
+            VWAP.DrawStyle = DRAWSTYLE_LINE;
+            VWAP.PrimaryColor = Color;
+            VWAP.LineWidth = 2;
+
+            SCSubgraphRef Top = sc.Subgraph[3 * a + 1];
+            Top.Name.Format("AVWAP %d Top", a + 1);
+            Top.DrawStyle = DRAWSTYLE_LINE;
+            Top.LineStyle = LINESTYLE_DOT;
+            Top.PrimaryColor = Color;
+
+            SCSubgraphRef Bottom = sc.Subgraph[3 * a + 2];
+            Bottom.Name.Format("AVWAP %d Bottom", a + 1);
+            Bottom.DrawStyle = DRAWSTYLE_LINE;
+            Bottom.LineStyle = LINESTYLE_DOT;
+            Bottom.PrimaryColor = Color;
+        }
+
+        return;
+    }
+
+    s_AnchoredVWAPEngine* Engine = reinterpret_cast<s_AnchoredVWAPEngine*>(sc.GetPersistentPointer(0));
+
+    // Study is being removed - clean up memory
+    if (sc.LastCallToFunction)
+    {
+        if (Engine != NULL)
+        {
+            delete Engine;
+            sc.SetPersistentPointer(0, NULL);
+        }
+        return;
+    }
+
+    if (Engine == NULL)
+    {
+        Engine = new s_AnchoredVWAPEngine;
+        Engine->Reset();
+        sc.SetPersistentPointer(0, Engine);
+    }
+
+    // ---------------------------------------------------------
+    // 1. ANCHOR SETTINGS
+    // ---------------------------------------------------------
+
+    int Types[MAX_VWAP_ANCHORS];
+    int Strengths[MAX_VWAP_ANCHORS];
+    SCDateTime AnchorTimes[MAX_VWAP_ANCHORS];
+    for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+    {
+        Types[a] = sc.Input[1 + 3 * a].GetIndex();
+        Strengths[a] = sc.Input[2 + 3 * a].GetInt();
+        AnchorTimes[a] = sc.Input[3 + 3 * a].GetDateTime();
+    }
+
+    float Multiplier = Input_BandMultiplier.GetFloat();
+
+    float VWAPs[MAX_VWAP_ANCHORS];
+    float Tops[MAX_VWAP_ANCHORS];
+    float Bottoms[MAX_VWAP_ANCHORS];
+
+    // ---------------------------------------------------------
+    // 2. ADVANCE THE ANCHORS
+    // ---------------------------------------------------------
+    // Closed bars are committed once, in order. When a bar closes, swing
+    // pivots it confirms restart the swing anchors; then the calendar and
+    // date-time anchors that begin on the next bar are restarted. A
+    // recalculation that steps back replays from the first bar.
+
+    if (sc.Index == 0 || sc.Index < Engine->FormingBarIndex)
+    {
+        Engine->Reset();
+        StartAnchors(sc, *Engine, Types, AnchorTimes, 0);
+    }
+
+    while (Engine->FormingBarIndex < sc.Index)
+    {
+        int Bar = Engine->FormingBarIndex;
+
+        // Bar has closed
+        Engine->Commit(sc.BaseData[SC_LAST][Bar], sc.BaseData[SC_VOLUME][Bar]);
+
+        for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+        {
+            if (Types[a] != ANCHOR_SWING_HIGH && Types[a] != ANCHOR_SWING_LOW)
+                continue;
+
+            int Pivot = Bar - Strengths[a];
+            if (!IsSwingPivot(sc, Pivot, Strengths[a], Types[a] == ANCHOR_SWING_HIGH ? 1 : -1))
+                continue;
+
+            // Restart at the pivot and redraw this anchor from there
+            Engine->Restart(a, Pivot);
+            for (int k = Pivot; k <= Bar; k++)
+            {
+                Engine->CommitOne(a, sc.BaseData[SC_LAST][k], sc.BaseData[SC_VOLUME][k]);
+                Engine->EvaluateOne(a, Multiplier,
+                    sc.Subgraph[3 * a][k], sc.Subgraph[3 * a + 1][k], sc.Subgraph[3 * a + 2][k]);
+            }
+        }
+
+        StartAnchors(sc, *Engine, Types, AnchorTimes, Bar + 1);
+    }
+
+    // ---------------------------------------------------------
+    // 3. OUTPUT
+    // ---------------------------------------------------------
+
+    Engine->Evaluate(sc.BaseData[SC_LAST][sc.Index], sc.BaseData[SC_VOLUME][sc.Index], Multiplier, VWAPs, Tops, Bottoms);
+
+    for (int a = 0; a < MAX_VWAP_ANCHORS; a++)
+    {
+        if (Types[a] == ANCHOR_OFF)
+            continue;
+
+        sc.Subgraph[3 * a][sc.Index] = VWAPs[a];
+        sc.Subgraph[3 * a + 1][sc.Index] = Tops[a];
+        sc.Subgraph[3 * a + 2][sc.Index] = Bottoms[a];
+    }
+}
@@ -1,30 +1,148 @@
 #include "sierrachart.h"
+#include "relative_volume_baseline.h"
+#include "rvol_baseline_file.h"
 
 SCDLLName("RelativeVolume_TimeBased")
 
-// Helper function to find the index for a given DateTime using Binary Search
-int GetBestMatchIndex(SCStudyInterfaceRef sc, SCDateTime TargetDateTime)
+// State kept between calls
+struct s_RVolState
 {
-    int Left = 0; 
-    int Right = sc.ArraySize - 1;
+    s_RVolSessionDirectory Directory;
+    s_RVolBaseline Baseline;
+    s_RVolBaselineFile BaselineFile;    // Shared with other charts of the symbol
+    bool ShareBaseline;         // Input, for reopening the file at session boundaries
+    int FormingBarIndex;        // First bar not yet added to the baseline
+    double SessionVolume;       // Committed bars of the current session
+};
+
+// Opens the baseline file shared by the charts of this symbol with the same
+// session start and slot length, if sharing is on
+static void OpenBaselineFile(SCStudyInterfaceRef sc, s_RVolState& State, bool Share)
+{
+    if (!Share)
+    {
+        State.BaselineFile.Close();
+        return;
+    }
+
+    const s_RVolBaseline& Baseline = State.Baseline;
+
+    SCString Key;
+    Key.Format("%s_%d_%d", sc.Symbol.GetChars(), State.Directory.StartSeconds, Baseline.SlotSeconds);
 
-    // Standard Binary Search to find insertion point (Lower Bound)
-    while (Left <= Right)
+    // Symbols can contain characters that are not valid in file names
+    std::string FileName = Key.GetChars();
+    for (size_t c = 0; c < FileName.size(); c++)
     {
-        int Mid = Left + (Right - Left) / 2;
-        if (sc.BaseDateTimeIn[Mid] < TargetDateTime)
-            Left = Mid + 1;
-        else if (sc.BaseDateTimeIn[Mid] > TargetDateTime)
-            Right = Mid - 1;
-        else
-            return Mid; // Exact match found
+        char Ch = FileName[c];
+        bool Keep = (Ch >= 'A' && Ch <= 'Z') || (Ch >= 'a' && Ch <= 'z') || (Ch >= '0' && Ch <= '9') || Ch == '_' || Ch == '-';
+        if (!Keep)
+            FileName[c] = '_';
     }
-    
-    // Left is now the index of the first element >= TargetDateTime
-    if (Left >= sc.ArraySize) return sc.ArraySize - 1;
-    if (Left < 0) return 0;
-    
-    return Left; 
+
+    SCString Folder = sc.DataFilesFolder();
+    const char* Separator = (Folder.GetLength() > 0 && Folder.GetChars()[Folder.GetLength() - 1] == '\\') ? "" : "\\";
+
+    SCString Path;
+    Path.Format("%s%sRVolBaseline_%s.bin", Folder.GetChars(), Separator, FileName.c_str());
+    State.BaselineFile.Open(Path.GetChars(), Baseline.SlotSeconds, Baseline.SlotsPerSession, State.Directory.StartSeconds);
+}
+
+// Adds Bar to the directory. A bar that starts a new session completes the
+// previous one.
+static void AddToDirectory(SCStudyInterfaceRef sc, s_RVolState& State, int Bar)
+{
+    SCDateTime BarDateTime = sc.BaseDateTimeIn[Bar];
+    if (!State.Directory.AddBar(Bar, BarDateTime.GetDate(), BarDateTime.GetTimeInSeconds()))
+        return;
+
+    int NumSessions = (int)State.Directory.Sessions.size();
+    State.SessionVolume = 0.0;
+    if (NumSessions < 2)
+        return;
+
+    // The session before Bar is complete. The shared file's copy is used if
+    // it has one; otherwise the row built from the bars is, and it is
+    // appended to the file, unless it is the chart's first session, which
+    // may have started before the chart's first bar.
+    int Date = State.Directory.Sessions[NumSessions - 2].Date;
+    s_RVolBaselineFile& File = State.BaselineFile;
+
+    // A file that could not be opened (no owner had created it yet) is
+    // tried again, and a reader takes over once the owner has closed it
+    if (State.ShareBaseline && (!File.IsOpen() || !File.Owner))
+        OpenBaselineFile(sc, State, true);
+
+    int FileRow = -1;
+    if (File.IsOpen())
+    {
+        File.Refresh();
+        FileRow = File.FindRow(Date);
+    }
+
+    if (FileRow >= 0)
+        State.Baseline.EndSession(File.GetRow(FileRow));
+    else
+    {
+        State.Baseline.EndSession();
+        if (NumSessions > 2)
+            File.Append(Date, &State.Baseline.Rows.back()[0]);
+    }
+}
+
+// Fills the table with the sessions the shared file has from before the
+// chart's first bar, so the lookback is full without loading that history
+static void PreloadBaseline(SCStudyInterfaceRef sc, s_RVolState& State)
+{
+    const s_RVolBaselineFile& File = State.BaselineFile;
+    if (!File.IsOpen())
+        return;
+
+    SCDateTime FirstDateTime = sc.BaseDateTimeIn[0];
+    int FirstSession = State.Directory.GetSessionDate(FirstDateTime.GetDate(), FirstDateTime.GetTimeInSeconds());
+
+    int End = File.GetNumRows();
+    while (End > 0 && File.GetRowDate(End - 1) >= FirstSession)
+        End--;
+
+    int Begin = End - State.Baseline.LookbackSessions;
+    if (Begin < 0)
+        Begin = 0;
+
+    for (int k = Begin; k < End; k++)
+        State.Baseline.AddRow(File.GetRow(k));
+}
+
+// Slot of Bar, which must be in the latest session of the directory
+static int GetBarSlot(SCStudyInterfaceRef sc, const s_RVolState& State, int Bar)
+{
+    SCDateTime BarDateTime = sc.BaseDateTimeIn[Bar];
+    int Seconds = State.Directory.GetSecondsIntoSession(State.Directory.Sessions.back().Date,
+        BarDateTime.GetDate(), BarDateTime.GetTimeInSeconds());
+    return State.Baseline.GetSlot(Seconds);
+}
+
+// Volume of a slot scaled to the length of Bar. A slot is one bar period,
+// except on charts with bars under a minute or without a fixed length
+// (tick, volume and range charts), where it is a minute; a bar without a
+// period is taken to last from its first to its last trade, at least a
+// second.
+static float GetBarShareOfSlot(SCStudyInterfaceRef sc, const s_RVolState& State, int Bar, float SlotVolume)
+{
+    int SlotSeconds = State.Baseline.SlotSeconds;
+    int BarSeconds = sc.SecondsPerBar;
+    if (BarSeconds <= 0)
+    {
+        SCDateTime Begin = sc.BaseDateTimeIn[Bar];
+        SCDateTime End = sc.BaseDataEndDateTime[Bar];
+        BarSeconds = (End.GetDate() - Begin.GetDate()) * 86400 + End.GetTimeInSeconds() - Begin.GetTimeInSeconds() + 1;
+        if (BarSeconds < 1)
+            BarSeconds = 1;
+    }
+
+    if (BarSeconds == SlotSeconds)
+        return SlotVolume;
+    return SlotVolume * BarSeconds / SlotSeconds;
 }
 
 SCSFExport scsf_RelativeVolume_TimeBased(SCStudyInterfaceRef sc)
@@ -32,6 +150,8 @@ SCSFExport scsf_RelativeVolume_TimeBased(SCStudyInterfaceRef sc)
     // Inputs
     SCInputRef Input_StartTime = sc.Input[0];
     SCInputRef Input_LookbackDays = sc.Input[1];
+    SCInputRef Input_ShareBaseline = sc.Input[2];
+    SCInputRef Input_CompareSessionsAgo = sc.Input[3];
     
     // Subgraphs
     // 1. Cumulative RVol (Original)
@@ -53,6 +173,14 @@ SCSFExport scsf_RelativeVolume_TimeBased(SCStudyInterfaceRef sc)
     SCSubgraphRef Subgraph_FullSessionRatio = sc.Subgraph[7];
     SCSubgraphRef Subgraph_AvgFullSessionVol = sc.Subgraph[8];
 
+    // 5. Median Based RVol (robust to FOMC / rollover days)
+    SCSubgraphRef Subgraph_MedianCumRVol = sc.Subgraph[9];
+    SCSubgraphRef Subgraph_MedianBarRVol = sc.Subgraph[10];
+    SCSubgraphRef Subgraph_CumVolPercentRank = sc.Subgraph[11];
+
+    // 6. Against one earlier session at the same time of day
+    SCSubgraphRef Subgraph_SessionsAgoCumRVol = sc.Subgraph[12];
+
     if (sc.SetDefaults)
     {
         sc.GraphName = "Relative Volume (Time Based & Full Session)";
@@ -69,6 +197,15 @@ SCSFExport scsf_RelativeVolume_TimeBased(SCStudyInterfaceRef sc)
         Input_LookbackDays.Name = "Lookback Days";
         Input_LookbackDays.SetInt(20);
 
+        Input_ShareBaseline.Name = "Share Baseline Across Charts";
+        Input_ShareBaseline.SetYesNo(1);
+        Input_ShareBaseline.SetDescription("Keep completed sessions in a file per symbol and session start, so charts of the same symbol share them and need not load the lookback history.");
+
+        Input_CompareSessionsAgo.Name = "Compare With Session N Ago";
+        Input_CompareSessionsAgo.SetInt(1);
+        Input_CompareSessionsAgo.SetIntLimits(1, 1000);
+        Input_CompareSessionsAgo.SetDescription("Session whose cumulative volume at the same time of day the N Sessions Ago ratio uses. 1 is the last completed session. Sessions beyond the lookback give 0.");
+
         // -- Subgraph Config --
         
         // 1. Cumulative RVol
@@ -118,193 +255,120 @@ SCSFExport scsf_RelativeVolume_TimeBased(SCStudyInterfaceRef sc)
         Subgraph_AvgFullSessionVol.DrawStyle = DRAWSTYLE_IGNORE;
         Subgraph_AvgFullSessionVol.PrimaryColor = RGB(200, 200, 200);
 
+        // 7. Median Based Subgraphs
+        Subgraph_MedianCumRVol.Name = "Median Cumulative RVol Ratio";
+        Subgraph_MedianCumRVol.DrawStyle = DRAWSTYLE_LINE;
+        Subgraph_MedianCumRVol.LineStyle = LINESTYLE_DASH;
+        Subgraph_MedianCumRVol.PrimaryColor = RGB(0, 160, 0);
+        Subgraph_MedianCumRVol.LineWidth = 2;
+
+        Subgraph_MedianBarRVol.Name = "Median Bar RVol Ratio";
+        Subgraph_MedianBarRVol.DrawStyle = DRAWSTYLE_IGNORE;
+        Subgraph_MedianBarRVol.PrimaryColor = RGB(200, 120, 0);
+
+        // 0-100, so not drawn on the ratio scale by default
+        Subgraph_CumVolPercentRank.Name = "Cumulative Vol Percentile Rank";
+        Subgraph_CumVolPercentRank.DrawStyle = DRAWSTYLE_IGNORE;
+        Subgraph_CumVolPercentRank.PrimaryColor = RGB(0, 200, 200);
+
+        // 8. Same Time N Sessions Ago
+        Subgraph_SessionsAgoCumRVol.Name = "Cumulative RVol vs N Sessions Ago";
+        Subgraph_SessionsAgoCumRVol.DrawStyle = DRAWSTYLE_IGNORE;
+        Subgraph_SessionsAgoCumRVol.PrimaryColor = RGB(160, 255, 160);
+
         return;
     }
 
     // -- PROCESSING --
 
-    // Persistent Variables for Caching Full Session Average
-    // Index 0: Last Calculated Session Date (int YYYYMMDD)
-    // Index 1: Cached Average Full Session Volume (float)
-    int& LastCalcSessionDate = sc.GetPersistentInt(0);
-    float& CachedAvgFullVol = sc.GetPersistentFloat(1);
+    s_RVolState* State = reinterpret_cast<s_RVolState*>(sc.GetPersistentPointer(0));
 
-    // Reset cache on full recalc
-    if (sc.Index == 0)
+    // Study is being removed - clean up memory
+    if (sc.LastCallToFunction)
     {
-        LastCalcSessionDate = 0;
-        CachedAvgFullVol = 0;
+        if (State != NULL)
+        {
+            delete State;
+            sc.SetPersistentPointer(0, NULL);
+        }
+        return;
     }
 
-    // 1. Get Current Time and Start Time
-    SCDateTime CurrentDateTime = sc.BaseDateTimeIn[sc.Index];
-    double StartTimeAsDouble = Input_StartTime.GetTime();
-
-    // 2. ROBUST DATE DETERMINATION
-    SCDateTime SessionStartDateTime;
-    SessionStartDateTime.SetDate(CurrentDateTime.GetDate());
-    SessionStartDateTime.SetTime(StartTimeAsDouble);
-
-    // If "Today's Start Time" is in the FUTURE relative to the current bar,
-    // then the session must have actually started Yesterday.
-    if (SessionStartDateTime > CurrentDateTime)
+    if (State == NULL)
     {
-        SessionStartDateTime.SetDate(CurrentDateTime.GetDate() - 1);
-        SessionStartDateTime.SetTime(StartTimeAsDouble);
+        State = new s_RVolState;
+        State->FormingBarIndex = -1;
+        State->ShareBaseline = false;
+        sc.SetPersistentPointer(0, State);
     }
 
-    int CurrentSessionDateInt = SessionStartDateTime.GetDate();
-
     // ---------------------------------------------------------
-    // 3. CACHE LOGIC: Calculate AVG FULL SESSION VOLUME (Expensive)
-    // Only run this if we have moved to a new session day
+    // 1. BUILD THE BASELINE TABLE
+    // Closed bars are added once, in order. The session directory
+    // splits them into sessions; each completed session becomes a row of
+    // the table (relative_volume_baseline.h). Sessions from before the
+    // chart's first bar come from the shared file (rvol_baseline_file.h).
+    // A recalculation that steps back replays from the first bar.
     // ---------------------------------------------------------
-    if (CurrentSessionDateInt != LastCalcSessionDate)
+    if (sc.Index == 0 || sc.Index < State->FormingBarIndex || State->FormingBarIndex < 0)
     {
-        double TotalFullSessionVol = 0;
-        int ValidFullDaysCount = 0;
-        int DaysToLookBack = Input_LookbackDays.GetInt();
+        State->Directory.Reset(Input_StartTime.GetTime());
+        State->Baseline.Reset(sc.SecondsPerBar, Input_LookbackDays.GetInt());
+        State->FormingBarIndex = 0;
+        State->SessionVolume = 0.0;
+        State->ShareBaseline = Input_ShareBaseline.GetYesNo() != 0;
+
+        OpenBaselineFile(sc, *State, State->ShareBaseline);
+        PreloadBaseline(sc, *State);
+    }
 
-        for (int day = 1; day <= DaysToLookBack + 10; day++) 
-        {
-            if (ValidFullDaysCount >= DaysToLookBack) break;
-
-            // Hist Start: 18:00 on Day - X
-            SCDateTime HistStartDateTime = SessionStartDateTime;
-            HistStartDateTime.SetDate(SessionStartDateTime.GetDate() - day);
-            
-            // Hist End: 18:00 on Day - X + 1 Day (Full 24h cycle)
-            SCDateTime HistEndDateTime = HistStartDateTime;
-            HistEndDateTime.SetDate(HistStartDateTime.GetDate() + 1);
-
-            // Find Indices
-            int HistStartIndex = GetBestMatchIndex(sc, HistStartDateTime);
-            int HistEndIndex = GetBestMatchIndex(sc, HistEndDateTime);
-
-            // Validate
-            if (HistStartIndex != -1 && HistEndIndex != -1 && HistEndIndex > HistStartIndex)
-            {
-                // Strict check: Start date must match exactly
-                if (sc.BaseDateTimeIn[HistStartIndex].GetDate() == HistStartDateTime.GetDate())
-                {
-                    float DailyVol = 0;
-                    for (int k = HistStartIndex; k < HistEndIndex; k++) // < to avoid double counting the closing bar if it overlaps
-                    {
-                        DailyVol += sc.Volume[k];
-                    }
-
-                    if (DailyVol > 0)
-                    {
-                        TotalFullSessionVol += DailyVol;
-                        ValidFullDaysCount++;
-                    }
-                }
-            }
-        }
+    while (State->FormingBarIndex < sc.Index)
+    {
+        int Bar = State->FormingBarIndex;
+        AddToDirectory(sc, *State, Bar);
 
-        if (ValidFullDaysCount > 0)
-            CachedAvgFullVol = (float)(TotalFullSessionVol / ValidFullDaysCount);
-        else
-            CachedAvgFullVol = 0;
+        State->Baseline.AddBar(GetBarSlot(sc, *State, Bar), sc.Volume[Bar]);
+        State->SessionVolume += sc.Volume[Bar];
 
-        // Update Cache Key
-        LastCalcSessionDate = CurrentSessionDateInt;
+        State->FormingBarIndex++;
     }
 
+    // The forming bar may start a session, completing the previous one.
+    // It is added again, as a closed bar, once the next bar starts.
+    AddToDirectory(sc, *State, sc.Index);
+
     // ---------------------------------------------------------
-    // 4. Calculate CURRENT Volume (Cumulative & Single Bar)
+    // 2. CURRENT VOLUME (Cumulative & Single Bar)
+    // The forming bar is added on top of the committed session volume
     // ---------------------------------------------------------
-    int CurrentStartIndex = GetBestMatchIndex(sc, SessionStartDateTime);
-    
-    float CurrentCumVolume = 0;
     float CurrentBarVolume = sc.Volume[sc.Index];
-    
-    if (CurrentStartIndex != -1 && CurrentStartIndex <= sc.Index)
-    {
-        for (int i = CurrentStartIndex; i <= sc.Index; i++)
-        {
-            CurrentCumVolume += sc.Volume[i];
-        }
-    }
+    float CurrentCumVolume = (float)(State->SessionVolume + CurrentBarVolume);
 
     // ---------------------------------------------------------
-    // 5. Calculate HISTORICAL Average Volume (Partial / Cumulative)
-    // This still needs to run every bar because the "End Time" changes
+    // 3. HISTORICAL AVERAGES: lookups at the bar's slot
     // ---------------------------------------------------------
-    double TotalHistoricalCumVol = 0;
-    double TotalHistoricalBarVol = 0;
-    
-    int ValidCumDaysCount = 0;
-    int ValidBarDaysCount = 0;
-    int DaysToLookBack = Input_LookbackDays.GetInt();
-    
-    for (int day = 1; day <= DaysToLookBack + 10; day++) 
-    {
-        if (ValidCumDaysCount >= DaysToLookBack) break;
+    int Slot = GetBarSlot(sc, *State, sc.Index);
 
-        SCDateTime HistStartDateTime = SessionStartDateTime;
-        HistStartDateTime.SetDate(SessionStartDateTime.GetDate() - day);
-        
-        // End time moves with current time
-        SCDateTime HistEndDateTime = HistStartDateTime;
-        HistEndDateTime += (CurrentDateTime - SessionStartDateTime);
+    float AvgCumVolume = State->Baseline.GetAvgCumVolume(Slot);
+    float AvgBarVolume = GetBarShareOfSlot(sc, *State, sc.Index, State->Baseline.GetAvgSlotVolume(Slot));
+    float CachedAvgFullVol = State->Baseline.GetAvgFullSessionVolume();
 
-        int HistStartIndex = GetBestMatchIndex(sc, HistStartDateTime);
-        int HistEndIndex = GetBestMatchIndex(sc, HistEndDateTime);
-
-        if (HistStartIndex != -1 && HistEndIndex != -1 && HistEndIndex >= HistStartIndex)
-        {
-            if (sc.BaseDateTimeIn[HistStartIndex].GetDate() == HistStartDateTime.GetDate())
-            {
-                // Cumulative Partial
-                float DailyCumVol = 0;
-                // Sanity check for length. 
-                // Replaced SCDateTime::fromMinutes(60) with standard double math (1.0/24.0 = 1 hour)
-                if (sc.BaseDateTimeIn[HistEndIndex] <= HistEndDateTime + (1.0 / 24.0)) 
-                {
-                    for (int k = HistStartIndex; k <= HistEndIndex; k++)
-                    {
-                        DailyCumVol += sc.Volume[k];
-                    }
-                }
-
-                if (DailyCumVol > 0)
-                {
-                    TotalHistoricalCumVol += DailyCumVol;
-                    ValidCumDaysCount++;
-                }
-                
-                // Single Bar
-                if (sc.BaseDateTimeIn[HistEndIndex].GetDate() == HistEndDateTime.GetDate())
-                {
-                    float DailyBarVol = sc.Volume[HistEndIndex];
-                    if (DailyBarVol > 0)
-                    {
-                        TotalHistoricalBarVol += DailyBarVol;
-                        ValidBarDaysCount++;
-                    }
-                }
-            }
-        }
-    }
+    float MedianCumVolume = State->Baseline.GetMedianCumVolume(Slot);
+    float MedianBarVolume = GetBarShareOfSlot(sc, *State, sc.Index, State->Baseline.GetMedianSlotVolume(Slot));
+    float CumVolPercentRank = State->Baseline.GetCumVolumePercentRank(Slot, CurrentCumVolume);
 
-    float AvgCumVolume = 0;
-    if (ValidCumDaysCount > 0)
-        AvgCumVolume = (float)(TotalHistoricalCumVol / ValidCumDaysCount);
-        
-    float AvgBarVolume = 0;
-    if (ValidBarDaysCount > 0)
-        AvgBarVolume = (float)(TotalHistoricalBarVol / ValidBarDaysCount);
+    // Row of the table, -1 once the session has left the lookback
+    double SessionsAgoCumVolume = State->Baseline.GetCumVolume(Input_CompareSessionsAgo.GetInt(), Slot);
 
     // ---------------------------------------------------------
-    // 6. Set Subgraph Values
+    // 4. Set Subgraph Values
     // ---------------------------------------------------------
     
     Subgraph_CurrentCumVol[sc.Index] = CurrentCumVolume;
     Subgraph_AvgHistCumVol[sc.Index] = AvgCumVolume;
     Subgraph_CurrentBarVol[sc.Index] = CurrentBarVolume;
     Subgraph_AvgHistBarVol[sc.Index] = AvgBarVolume;
-    Subgraph_AvgFullSessionVol[sc.Index] = CachedAvgFullVol; // From Cache
+    Subgraph_AvgFullSessionVol[sc.Index] = CachedAvgFullVol;
     Subgraph_ZeroLine[sc.Index] = 1.0f;
 
     // A. Cumulative Ratio
@@ -324,4 +388,23 @@ SCSFExport scsf_RelativeVolume_TimeBased(SCStudyInterfaceRef sc)
         Subgraph_FullSessionRatio[sc.Index] = CurrentCumVolume / CachedAvgFullVol;
     else
         Subgraph_FullSessionRatio[sc.Index] = 0;
+
+    // D. Median Ratios and Percentile Rank
+    if (MedianCumVolume > 0)
+        Subgraph_MedianCumRVol[sc.Index] = CurrentCumVolume / MedianCumVolume;
+    else
+        Subgraph_MedianCumRVol[sc.Index] = 0;
+
+    if (MedianBarVolume > 0)
+        Subgraph_MedianBarRVol[sc.Index] = CurrentBarVolume / MedianBarVolume;
+    else
+        Subgraph_MedianBarRVol[sc.Index] = 0;
+
+    Subgraph_CumVolPercentRank[sc.Index] = CumVolPercentRank;
+
+    // E. Same Time N Sessions Ago
+    if (SessionsAgoCumVolume > 0)
+        Subgraph_SessionsAgoCumRVol[sc.Index] = (float)(CurrentCumVolume / SessionsAgoCumVolume);
+    else
+        Subgraph_SessionsAgoCumRVol[sc.Index] = 0;
 }
\ No newline at end of file
@@ -0,0 +1,601 @@
+/*
+    FVG fill statistics - offline analyzer
+
+    Finds Fair Value Gaps in Sierra Chart bar data with fvg_core.h and
+    fills them with fvg_index.h, the same detection and fill code the FVG
+    study runs, and reports how often and how fast they fill. Not a study:
+    build it as a normal command line program.
+
+        g++ -O2 -std=c++17 -pthread -o fvg_analyzer fvg_analyzer.cpp
+
+    Input is a bar file exported with Edit >> Export Bar Data to Text File:
+
+        Date, Time, Open, High, Low, Last, ...
+
+    Usage:
+
+        fvg_analyzer [options] bars.txt
+
+        --tick-size X           Tick size of the symbol. Default 0.25.
+        --min-gap-up N          Like the study's "FVG Up: Minimum Gap Size in
+        --min-gap-down N        Ticks" inputs. Default 1.
+        --timeframe M           Find the gaps of M minute bars built from the
+                                file's bars, like the study's "HTF" inputs.
+                                Default 0 = the file's bars.
+        --session-start HH:MM   Trading day start. Bars at or after this time
+                                belong to the next trading day (evening
+                                sessions). Default 00:00.
+        --session Name=HH:MM-HH:MM
+                                Group gaps by the time of the last bar of bar
+                                1. Repeat for more sessions; the first match
+                                wins and the rest go to "Other". A session
+                                may wrap midnight. Default: one group, "All".
+        --size-buckets N,N,...  Gap size groups, lower bounds in ticks.
+                                Default 1,2,4,8,16.
+        --horizon-days N        A gap counts as filled only if it fills by
+                                the end of the Nth trading day, counting the
+                                day it formed as 1. Gaps whose horizon runs
+                                past the end of the file are left out of the
+                                fill rate (Censored). Default 0 = any time
+                                before the end of the file.
+        --threads N             Worker threads. Default: all cores.
+
+    Trading days are processed in parallel. Each day starts its own
+    resampler and detector a few bars before the day, so it finds exactly
+    the gaps one pass over the whole file would. Fills are searched in one
+    range index over every bar, shared read-only.
+
+    Output is one CSV row per direction, session and size group, plus an
+    "All" row per direction:
+    - FillPct: gaps filled (within the horizon) per gap.
+    - Minutes and Bars: time from the last bar of bar 1 to the bar that
+      filled it, percentiles over the filled gaps.
+    - DepthPct: for the gaps that did not fill, how far into the gap price
+      got (0 = never touched it, 100 = filled), average, and the share that
+      got past the midpoint.
+*/
+
+#include "fvg_core.h"
+#include "fvg_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct s_FVGBars
+{
+    std::vector<int> TradingDate;
+    std::vector<int> Date;          // Days since 1970-01-01
+    std::vector<int> TimeInSeconds;
+    std::vector<float> High;
+    std::vector<float> Low;
+
+    int Size() const { return (int)High.size(); }
+
+    double GetMinutes(int Index) const
+    {
+        return Date[Index] * 1440.0 + TimeInSeconds[Index] / 60.0;
+    }
+};
+
+struct s_FVGSession
+{
+    std::string Name;
+    int StartMinute;
+    int EndMinute;                  // Exclusive; before StartMinute if it wraps midnight
+
+    bool Contains(int Minute) const
+    {
+        if (StartMinute <= EndMinute)
+            return Minute >= StartMinute && Minute < EndMinute;
+        return Minute >= StartMinute || Minute < EndMinute;
+    }
+};
+
+struct s_FVGAnalyzerOptions
+{
+    float TickSize;
+    int MinGapUpTicks;
+    int MinGapDownTicks;
+    int PeriodSeconds;
+    int SessionStartMinute;
+    std::vector<s_FVGSession> Sessions;
+    std::vector<int> SizeBuckets;   // Ascending lower bounds in ticks
+    int HorizonDays;
+    int NumThreads;
+};
+
+// A gap and how it filled
+struct s_FVGGapRecord
+{
+    s_FVGGap Gap;
+    int Session;                    // Index in Sessions, Sessions.size() = Other
+    int SizeBucket;                 // Index in SizeBuckets, -1 = below the first
+    int FillIndex;                  // -1 = not filled within the horizon
+    float DepthPct;                 // Deepest move into the gap, 100 once filled
+    bool Censored;                  // Horizon runs past the end of the file, not filled
+};
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int DaysFromCivil(int Year, int Month, int Day)
+{
+    Year -= Month <= 2;
+    int Era = (Year >= 0 ? Year : Year - 399) / 400;
+    int YearOfEra = Year - Era * 400;
+    int DayOfYear = (153 * (Month + (Month > 2 ? -3 : 9)) + 2) / 5 + Day - 1;
+    int DayOfEra = YearOfEra * 365 + YearOfEra / 4 - YearOfEra / 100 + DayOfYear;
+    return Era * 146097 + DayOfEra - 719468;
+}
+
+static bool ParseHHMM(const char* Text, int& Minutes)
+{
+    int Hour = 0, Minute = 0;
+    if (sscanf(Text, "%d:%d", &Hour, &Minute) != 2 || Hour < 0 || Hour > 23 || Minute < 0 || Minute > 59)
+        return false;
+
+    Minutes = Hour * 60 + Minute;
+    return true;
+}
+
+// Name=HH:MM-HH:MM
+static bool ParseSession(const char* Text, s_FVGSession& Session)
+{
+    std::string Spec = Text;
+    size_t Equals = Spec.find('=');
+    size_t Dash = Spec.find('-', Equals == std::string::npos ? 0 : Equals);
+    if (Equals == std::string::npos || Equals == 0 || Dash == std::string::npos)
+        return false;
+
+    Session.Name = Spec.substr(0, Equals);
+    return ParseHHMM(Spec.substr(Equals + 1, Dash - Equals - 1).c_str(), Session.StartMinute)
+        && ParseHHMM(Spec.substr(Dash + 1).c_str(), Session.EndMinute)
+        && Session.StartMinute != Session.EndMinute;
+}
+
+// N,N,... ascending
+static bool ParseSizeBuckets(const char* Text, std::vector<int>& Buckets)
+{
+    Buckets.clear();
+    const char* p = Text;
+    while (*p != '\0')
+    {
+        char* End;
+        long Value = strtol(p, &End, 10);
+        if (End == p || Value < 1 || (!Buckets.empty() && Value <= Buckets.back()))
+            return false;
+
+        Buckets.push_back((int)Value);
+        p = (*End == ',') ? End + 1 : End;
+        if (*End != ',' && *End != '\0')
+            return false;
+    }
+    return !Buckets.empty();
+}
+
+// Reads a Sierra Chart bar export. Returns false if the file can't be opened.
+static bool LoadBars(const char* Path, int SessionStartMinute, s_FVGBars& Bars)
+{
+    FILE* File = fopen(Path, "r");
+    if (File == NULL)
+        return false;
+
+    char Line[512];
+    while (fgets(Line, sizeof(Line), File) != NULL)
+    {
+        int Year, Month, Day, Hour, Minute;
+        double Second;
+        float Open, High, Low, Last;
+
+        // The header line and anything malformed fail to parse and are skipped
+        int Fields = sscanf(Line, "%d/%d/%d , %d:%d:%lf , %f , %f , %f , %f",
+            &Year, &Month, &Day, &Hour, &Minute, &Second, &Open, &High, &Low, &Last);
+        if (Fields != 10)
+            continue;
+
+        int DayNumber = DaysFromCivil(Year, Month, Day);
+        int MinuteOfDay = Hour * 60 + Minute;
+
+        int TradingDate = DayNumber;
+        if (SessionStartMinute > 0 && MinuteOfDay >= SessionStartMinute)
+            TradingDate++;
+
+        Bars.TradingDate.push_back(TradingDate);
+        Bars.Date.push_back(DayNumber);
+        Bars.TimeInSeconds.push_back(MinuteOfDay * 60 + (int)Second);
+        Bars.High.push_back(High);
+        Bars.Low.push_back(Low);
+    }
+
+    fclose(File);
+    return true;
+}
+
+// Runs Body(Task) for Task in [0, NumTasks) on NumThreads workers, each
+// taking the next task as it finishes one
+static void ParallelFor(int NumTasks, int NumThreads, const std::function<void(int)>& Body)
+{
+    if (NumThreads > NumTasks)
+        NumThreads = NumTasks;
+    if (NumThreads <= 1)
+    {
+        for (int t = 0; t < NumTasks; t++)
+            Body(t);
+        return;
+    }
+
+    std::atomic<int> Next(0);
+    std::vector<std::thread> Workers;
+    for (int w = 0; w < NumThreads; w++)
+    {
+        Workers.push_back(std::thread([&Next, &Body, NumTasks]()
+        {
+            for (int Task = Next++; Task < NumTasks; Task = Next++)
+                Body(Task);
+        }));
+    }
+    for (size_t w = 0; w < Workers.size(); w++)
+        Workers[w].join();
+}
+
+// First bar to feed for a day so that the three bars closing at or after
+// DayBegin are complete: the bars of the three buckets (bars of the
+// timeframe) ending before it
+static int GetFeedStart(const s_FVGBars& Bars, const s_FVGResampler& Resampler, int DayBegin)
+{
+    int Start = DayBegin;
+    int NumKeys = 0;
+    long long Key = 0;
+    while (Start > 0)
+    {
+        long long PreviousKey = Resampler.PeriodSeconds > 0
+            ? Resampler.GetKey(Bars.Date[Start - 1], Bars.TimeInSeconds[Start - 1])
+            : Start - 1;
+
+        if (NumKeys == 0 || PreviousKey != Key)
+        {
+            if (NumKeys == 3)
+                break;
+            NumKeys++;
+            Key = PreviousKey;
+        }
+        Start--;
+    }
+    return Start;
+}
+
+// Gaps whose bar 1 closes on trading day Day, and their fills
+static void AnalyzeDay(const s_FVGBars& Bars, const s_FVGRangeIndex& Index, const std::vector<int>& DayStarts,
+    int Day, const s_FVGAnalyzerOptions& Options, std::vector<s_FVGGapRecord>& Records)
+{
+    int NumDays = (int)DayStarts.size() - 1;
+    int DayBegin = DayStarts[Day];
+    int DayEnd = DayStarts[Day + 1];
+
+    // Same minimum sizes as the study: ticks times the tick size, in float
+    float UpMinGap = float(Options.MinGapUpTicks) * Options.TickSize;
+    float DnMinGap = float(Options.MinGapDownTicks) * Options.TickSize;
+
+    // Last bar a fill may come on
+    int LastFillBar = Bars.Size() - 1;
+    bool HorizonPastEnd = false;
+    if (Options.HorizonDays > 0)
+    {
+        int HorizonDay = Day + Options.HorizonDays;
+        HorizonPastEnd = HorizonDay > NumDays;
+        LastFillBar = DayStarts[HorizonPastEnd ? NumDays : HorizonDay] - 1;
+    }
+
+    s_FVGResampler Resampler;
+    Resampler.Reset(Options.PeriodSeconds);
+    s_FVGDetector Detector;
+    Detector.Reset();
+
+    for (int BarIndex = GetFeedStart(Bars, Resampler, DayBegin); BarIndex < DayEnd; BarIndex++)
+    {
+        s_FVGBar ClosedBar;
+        s_FVGGap Gap;
+        if (!Resampler.Add(BarIndex, Bars.Date[BarIndex], Bars.TimeInSeconds[BarIndex], Bars.High[BarIndex], Bars.Low[BarIndex], ClosedBar)
+            || !Detector.Add(ClosedBar, UpMinGap, DnMinGap, Gap))
+            continue;
+
+        // Closed on an earlier day: that day's gap
+        if (BarIndex < DayBegin)
+            continue;
+
+        s_FVGGapRecord Record;
+        Record.Gap = Gap;
+
+        int Minute = Bars.TimeInSeconds[Gap.EndIndex] / 60;
+        Record.Session = (int)Options.Sessions.size();
+        for (size_t s = 0; s < Options.Sessions.size(); s++)
+        {
+            if (Options.Sessions[s].Contains(Minute))
+            {
+                Record.Session = (int)s;
+                break;
+            }
+        }
+
+        bool FVGUp = (Gap.Direction == FVG_UP);
+        float Size = FVGUp ? Gap.EndValue - Gap.BeginValue : Gap.BeginValue - Gap.EndValue;
+        int SizeTicks = (int)floor(Size / Options.TickSize + 0.5f);
+        Record.SizeBucket = -1;
+        for (size_t b = 0; b < Options.SizeBuckets.size() && SizeTicks >= Options.SizeBuckets[b]; b++)
+            Record.SizeBucket = (int)b;
+
+        // Filled by the first later bar reaching the far edge (bar 3's), as in the study
+        int From = Gap.EndIndex + 1;
+        int FillIndex = (From <= LastFillBar) ? Index.FindFill(FVGUp, From, Gap.BeginValue) : -1;
+        Record.FillIndex = (FillIndex >= 0 && FillIndex <= LastFillBar) ? FillIndex : -1;
+        Record.Censored = (Record.FillIndex < 0 && HorizonPastEnd);
+
+        Record.DepthPct = 100.0f;
+        if (Record.FillIndex < 0)
+        {
+            Record.DepthPct = 0.0f;
+            if (From <= LastFillBar && Size > 0.0f)
+            {
+                float Reached = FVGUp ? Gap.EndValue - Index.GetMinLow(From, LastFillBar) : Index.GetMaxHigh(From, LastFillBar) - Gap.EndValue;
+                Record.DepthPct = std::max(0.0f, std::min(100.0f, 100.0f * Reached / Size));
+            }
+        }
+
+        Records.push_back(Record);
+    }
+}
+
+struct s_FVGGroupStats
+{
+    int Gaps;
+    int Filled;
+    int Censored;
+    std::vector<double> FillMinutes;
+    std::vector<int> FillBars;
+    double UnfilledDepthSum;
+    int UnfilledPastMidpoint;
+
+    s_FVGGroupStats() : Gaps(0), Filled(0), Censored(0), UnfilledDepthSum(0.0), UnfilledPastMidpoint(0) {}
+
+    void Add(const s_FVGBars& Bars, const s_FVGGapRecord& Record)
+    {
+        if (Record.Censored)
+        {
+            Censored++;
+            return;
+        }
+
+        Gaps++;
+        if (Record.FillIndex >= 0)
+        {
+            Filled++;
+            FillMinutes.push_back(Bars.GetMinutes(Record.FillIndex) - Bars.GetMinutes(Record.Gap.EndIndex));
+            FillBars.push_back(Record.FillIndex - Record.Gap.EndIndex);
+        }
+        else
+        {
+            UnfilledDepthSum += Record.DepthPct;
+            if (Record.DepthPct >= 50.0f)
+                UnfilledPastMidpoint++;
+        }
+    }
+};
+
+// Value at quantile q of Values, sorting them; 0 if empty
+template <typename T>
+static double GetQuantile(std::vector<T>& Values, double q)
+{
+    if (Values.empty())
+        return 0.0;
+
+    std::sort(Values.begin(), Values.end());
+    return (double)Values[(size_t)(q * (Values.size() - 1) + 0.5)];
+}
+
+static void PrintGroup(const char* Direction, const std::string& Session, const std::string& Size, s_FVGGroupStats& Stats)
+{
+    int Unfilled = Stats.Gaps - Stats.Filled;
+    printf("%s,%s,%s,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.0f,%.1f,%.1f,%d\n", Direction, Session.c_str(), Size.c_str(),
+        Stats.Gaps, Stats.Filled, Stats.Gaps > 0 ? Stats.Filled * 100.0 / Stats.Gaps : 0.0,
+        GetQuantile(Stats.FillMinutes, 0.25), GetQuantile(Stats.FillMinutes, 0.5), GetQuantile(Stats.FillMinutes, 0.75),
+        GetQuantile(Stats.FillMinutes, 0.9), GetQuantile(Stats.FillBars, 0.5),
+        Unfilled > 0 ? Stats.UnfilledDepthSum / Unfilled : 0.0, Unfilled > 0 ? Stats.UnfilledPastMidpoint * 100.0 / Unfilled : 0.0,
+        Stats.Censored);
+}
+
+static void PrintReport(const s_FVGBars& Bars, const s_FVGAnalyzerOptions& Options, const std::vector<s_FVGGapRecord>& Records)
+{
+    std::vector<std::string> SessionNames;
+    for (size_t s = 0; s < Options.Sessions.size(); s++)
+        SessionNames.push_back(Options.Sessions[s].Name);
+    SessionNames.push_back(Options.Sessions.empty() ? "All" : "Other");
+
+    // Size group -1 (below the first bound) is kept in slot 0
+    std::vector<std::string> SizeNames;
+    SizeNames.push_back("<" + std::to_string(Options.SizeBuckets[0]));
+    for (size_t b = 0; b < Options.SizeBuckets.size(); b++)
+    {
+        if (b + 1 < Options.SizeBuckets.size())
+            SizeNames.push_back(std::to_string(Options.SizeBuckets[b]) + "-" + std::to_string(Options.SizeBuckets[b + 1] - 1));
+        else
+            SizeNames.push_back(std::to_string(Options.SizeBuckets[b]) + "+");
+    }
+
+    int NumSessions = (int)SessionNames.size();
+    int NumSizes = (int)SizeNames.size();
+
+    // [Direction][Session][Size], and [Direction] over all
+    std::vector<s_FVGGroupStats> Groups(2 * NumSessions * NumSizes);
+    s_FVGGroupStats Totals[2];
+    for (size_t r = 0; r < Records.size(); r++)
+    {
+        const s_FVGGapRecord& Record = Records[r];
+        int d = (Record.Gap.Direction == FVG_UP) ? 0 : 1;
+        Groups[(d * NumSessions + Record.Session) * NumSizes + Record.SizeBucket + 1].Add(Bars, Record);
+        Totals[d].Add(Bars, Record);
+    }
+
+    printf("Direction,Session,SizeTicks,Gaps,Filled,FillPct,MinutesP25,MinutesP50,MinutesP75,MinutesP90,BarsP50,UnfilledDepthPct,UnfilledPastMidPct,Censored\n");
+    const char* Directions[2] = { "Up", "Down" };
+    for (int d = 0; d < 2; d++)
+    {
+        for (int s = 0; s < NumSessions; s++)
+        {
+            for (int b = 0; b < NumSizes; b++)
+            {
+                s_FVGGroupStats& Stats = Groups[(d * NumSessions + s) * NumSizes + b];
+                if (Stats.Gaps + Stats.Censored > 0)
+                    PrintGroup(Directions[d], SessionNames[s], SizeNames[b], Stats);
+            }
+        }
+        PrintGroup(Directions[d], "All", "All", Totals[d]);
+    }
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "usage: fvg_analyzer [--tick-size X] [--min-gap-up N] [--min-gap-down N] [--timeframe M]\n");
+    fprintf(stderr, "           [--session-start HH:MM] [--session Name=HH:MM-HH:MM]... [--size-buckets N,N,...]\n");
+    fprintf(stderr, "           [--horizon-days N] [--threads N] bars.txt\n");
+}
+
+int main(int argc, char** argv)
+{
+    s_FVGAnalyzerOptions Options;
+    Options.TickSize = 0.25f;
+    Options.MinGapUpTicks = 1;
+    Options.MinGapDownTicks = 1;
+    Options.PeriodSeconds = 0;
+    Options.SessionStartMinute = 0;
+    Options.HorizonDays = 0;
+    Options.NumThreads = (int)std::thread::hardware_concurrency();
+    ParseSizeBuckets("1,2,4,8,16", Options.SizeBuckets);
+
+    const char* Path = NULL;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string Arg = argv[a];
+
+        if (Arg == "--tick-size" && a + 1 < argc)
+            Options.TickSize = (float)atof(argv[++a]);
+        else if (Arg == "--min-gap-up" && a + 1 < argc)
+            Options.MinGapUpTicks = atoi(argv[++a]);
+        else if (Arg == "--min-gap-down" && a + 1 < argc)
+            Options.MinGapDownTicks = atoi(argv[++a]);
+        else if (Arg == "--timeframe" && a + 1 < argc)
+            Options.PeriodSeconds = atoi(argv[++a]) * 60;
+        else if (Arg == "--session-start" && a + 1 < argc)
+        {
+            if (!ParseHHMM(argv[++a], Options.SessionStartMinute))
+            {
+                fprintf(stderr, "bad session start time: %s\n", argv[a]);
+                return 1;
+            }
+        }
+        else if (Arg == "--session" && a + 1 < argc)
+        {
+            s_FVGSession Session;
+            if (!ParseSession(argv[++a], Session))
+            {
+                fprintf(stderr, "bad session: %s\n", argv[a]);
+                return 1;
+            }
+            Options.Sessions.push_back(Session);
+        }
+        else if (Arg == "--size-buckets" && a + 1 < argc)
+        {
+            if (!ParseSizeBuckets(argv[++a], Options.SizeBuckets))
+            {
+                fprintf(stderr, "bad size buckets: %s\n", argv[a]);
+                return 1;
+            }
+        }
+        else if (Arg == "--horizon-days" && a + 1 < argc)
+            Options.HorizonDays = atoi(argv[++a]);
+        else if (Arg == "--threads" && a + 1 < argc)
+            Options.NumThreads = atoi(argv[++a]);
+        else if (Arg[0] != '-' && Path == NULL)
+            Path = argv[a];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (Path == NULL)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (Options.TickSize <= 0.0f || Options.MinGapUpTicks < 1 || Options.MinGapDownTicks < 1
+        || Options.PeriodSeconds < 0 || Options.PeriodSeconds > 86400 || Options.HorizonDays < 0)
+    {
+        fprintf(stderr, "tick size, minimum gaps, timeframe and horizon must be positive\n");
+        return 1;
+    }
+
+    if (Options.NumThreads < 1)
+        Options.NumThreads = 1;
+
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    std::chrono::steady_clock::time_point LoadStart = std::chrono::steady_clock::now();
+
+    s_FVGBars Bars;
+    if (!LoadBars(Path, Options.SessionStartMinute, Bars))
+    {
+        fprintf(stderr, "can't open %s\n", Path);
+        return 1;
+    }
+    if (Bars.Size() == 0)
+    {
+        fprintf(stderr, "no bars in %s\n", Path);
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point AnalyzeStart = std::chrono::steady_clock::now();
+
+    // One range index over every bar, read by all the days
+    s_FVGRangeIndex Index;
+    Index.Reset(0);
+    for (int b = 0; b < Bars.Size(); b++)
+        Index.Append(Bars.Low[b], Bars.High[b], 0);
+
+    // First bar of each trading day, and the end
+    std::vector<int> DayStarts;
+    for (int b = 0; b < Bars.Size(); b++)
+    {
+        if (b == 0 || Bars.TradingDate[b] != Bars.TradingDate[b - 1])
+            DayStarts.push_back(b);
+    }
+    int NumDays = (int)DayStarts.size();
+    DayStarts.push_back(Bars.Size());
+
+    std::vector<std::vector<s_FVGGapRecord> > DayRecords(NumDays);
+    ParallelFor(NumDays, Options.NumThreads, [&](int Day)
+    {
+        AnalyzeDay(Bars, Index, DayStarts, Day, Options, DayRecords[Day]);
+    });
+
+    // Merged in day order, so the report does not depend on the threads
+    std::vector<s_FVGGapRecord> Records;
+    for (int Day = 0; Day < NumDays; Day++)
+        Records.insert(Records.end(), DayRecords[Day].begin(), DayRecords[Day].end());
+
+    std::chrono::steady_clock::time_point AnalyzeEnd = std::chrono::steady_clock::now();
+
+    PrintReport(Bars, Options, Records);
+
+    fprintf(stderr, "Bars=%d Days=%d Gaps=%d Threads=%d\n", Bars.Size(), NumDays, (int)Records.size(), Options.NumThreads);
+    fprintf(stderr, "Timing: load %.1f ms, analyze %.1f ms\n",
+        Milliseconds(AnalyzeStart - LoadStart).count(), Milliseconds(AnalyzeEnd - AnalyzeStart).count());
+    return 0;
+}
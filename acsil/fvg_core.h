@@ -0,0 +1,172 @@
+#ifndef FVG_CORE_H
+#define FVG_CORE_H
+
+/*
+    FVG (Fair Value Gap) detection shared by the FVG study and anything
+    else that must find exactly the same gaps. Platform independent.
+
+    A gap is found on three consecutive closed bars, 3 (oldest) to 1:
+    - FVG Up:   H3 < L1, at least the minimum gap size. It spans H3 to L1
+      and is filled by a later low at or below H3.
+    - FVG Down: L3 > H1, at least the minimum gap size. It spans L3 to H1
+      and is filled by a later high at or above L3.
+
+    Bars may be the chart's own bars or higher timeframe bars built from
+    them by s_FVGResampler; either way they carry the range of chart bars
+    they cover, so gaps are always placed and filled in chart bar indexes.
+*/
+
+enum FVGDirectionEnum
+{
+    FVG_NONE = 0,
+    FVG_UP = 1,
+    FVG_DOWN = -1
+};
+
+struct s_FVGBar
+{
+    float High;
+    float Low;
+    int FirstIndex;     // Chart bars covered
+    int LastIndex;
+};
+
+struct s_FVGGap
+{
+    int Direction;      // FVG_UP or FVG_DOWN
+    int BeginIndex;     // First chart bar of bar 3
+    float BeginValue;   // H3 (Up) or L3 (Down): the edge that fills the gap
+    int EndIndex;       // Last chart bar of bar 1
+    float EndValue;     // L1 (Up) or H1 (Down)
+};
+
+// Gap formed by Bar3, Bar2 and Bar1 (Bar2 does not take part in the test).
+// Returns false if there is none.
+inline bool DetectFVG(const s_FVGBar& Bar3, const s_FVGBar& Bar1, float UpMinGap, float DnMinGap, s_FVGGap& Gap)
+{
+    float L1 = Bar1.Low;
+    float H1 = Bar1.High;
+    float L3 = Bar3.Low;
+    float H3 = Bar3.High;
+
+    if ((H3 < L1) && (L1 - H3 >= UpMinGap))
+    {
+        Gap.Direction = FVG_UP;
+        Gap.BeginValue = H3;
+        Gap.EndValue = L1;
+    }
+    else if ((L3 > H1) && (L3 - H1 >= DnMinGap))
+    {
+        Gap.Direction = FVG_DOWN;
+        Gap.BeginValue = L3;
+        Gap.EndValue = H1;
+    }
+    else
+        return false;
+
+    Gap.BeginIndex = Bar3.FirstIndex;
+    Gap.EndIndex = Bar1.LastIndex;
+    return true;
+}
+
+// Builds bars of PeriodSeconds (aligned to the clock, restarting each date)
+// from closed chart bars fed in order. PeriodSeconds 0 passes every chart
+// bar through as it is. A higher timeframe bar closes when the first chart
+// bar of the next one arrives.
+struct s_FVGResampler
+{
+    int PeriodSeconds;
+    long long FormingKey;
+    bool HasForming;
+    s_FVGBar Forming;
+
+    void Reset(int Seconds)
+    {
+        PeriodSeconds = Seconds;
+        FormingKey = 0;
+        HasForming = false;
+        Forming.High = Forming.Low = 0.0f;
+        Forming.FirstIndex = Forming.LastIndex = -1;
+    }
+
+    long long GetKey(int Date, int TimeInSeconds) const
+    {
+        return (long long)Date * 86400 + (TimeInSeconds / PeriodSeconds) * PeriodSeconds;
+    }
+
+    // True if a chart bar starting at Date and TimeInSeconds would belong to
+    // the bar being built
+    bool IsInForming(int Date, int TimeInSeconds) const
+    {
+        return HasForming && PeriodSeconds > 0 && GetKey(Date, TimeInSeconds) == FormingKey;
+    }
+
+    // Adds a closed chart bar. Returns true, with the bar in Closed, when a
+    // bar of this timeframe closes.
+    bool Add(int Index, int Date, int TimeInSeconds, float High, float Low, s_FVGBar& Closed)
+    {
+        if (PeriodSeconds <= 0)
+        {
+            Closed.High = High;
+            Closed.Low = Low;
+            Closed.FirstIndex = Index;
+            Closed.LastIndex = Index;
+            return true;
+        }
+
+        long long Key = GetKey(Date, TimeInSeconds);
+        if (HasForming && Key == FormingKey)
+        {
+            if (High > Forming.High)
+                Forming.High = High;
+            if (Low < Forming.Low)
+                Forming.Low = Low;
+            Forming.LastIndex = Index;
+            return false;
+        }
+
+        bool ClosedOne = HasForming;
+        if (ClosedOne)
+            Closed = Forming;
+
+        FormingKey = Key;
+        HasForming = true;
+        Forming.High = High;
+        Forming.Low = Low;
+        Forming.FirstIndex = Index;
+        Forming.LastIndex = Index;
+        return ClosedOne;
+    }
+};
+
+// The last three closed bars of a timeframe, to test for a gap as each one
+// closes
+struct s_FVGDetector
+{
+    s_FVGBar Bars[3];
+    int NumBars;
+
+    void Reset()
+    {
+        for (int b = 0; b < 3; b++)
+        {
+            Bars[b].High = Bars[b].Low = 0.0f;
+            Bars[b].FirstIndex = Bars[b].LastIndex = -1;
+        }
+        NumBars = 0;
+    }
+
+    // Adds a closed bar. Returns true, with the gap in Gap, if it completes one.
+    bool Add(const s_FVGBar& Bar, float UpMinGap, float DnMinGap, s_FVGGap& Gap)
+    {
+        Bars[0] = Bars[1];
+        Bars[1] = Bars[2];
+        Bars[2] = Bar;
+        if (NumBars < 3)
+            NumBars++;
+
+        return NumBars == 3 && DetectFVG(Bars[0], Bars[2], UpMinGap, DnMinGap, Gap);
+    }
+};
+
+#endif // FVG_CORE_H
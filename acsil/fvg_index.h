@@ -0,0 +1,224 @@
+#ifndef FVG_INDEX_H
+#define FVG_INDEX_H
+
+/*
+    Search structures for FVG fill tests. Platform independent.
+
+    s_FVGRangeIndex is a segment tree of bar lows (minimum) and highs
+    (maximum) that grows as bars are appended. "First bar from i on whose
+    low is at or below x" is a descent of the tree, O(log n), instead of a
+    scan of every bar after i.
+
+    s_FVGOpenGaps keeps the gaps that are still open ordered by the price
+    that fills them, so one bar closes all the gaps it reaches with one
+    lookup plus one step per closed gap.
+*/
+
+#include <cfloat>
+#include <map>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// Range min/max index
+// -----------------------------------------------------------------------------
+
+struct s_FVGRangeIndex
+{
+    int Base;                   // Bar of leaf 0
+    int Count;                  // Bars appended: [Base, Base + Count)
+    int Capacity;               // Leaves, a power of two
+    std::vector<float> MinLow;  // Node k has children 2k and 2k + 1; leaves at Capacity + i
+    std::vector<float> MaxHigh;
+
+    void Reset(int FirstBar)
+    {
+        Base = FirstBar;
+        Count = 0;
+        Capacity = 0;
+        MinLow.clear();
+        MaxHigh.clear();
+    }
+
+    int GetEnd() const { return Base + Count; }
+
+    // Appends the next bar, GetEnd(). When the tree is full it is rebuilt,
+    // and bars before KeepFrom are dropped then.
+    void Append(float Low, float High, int KeepFrom)
+    {
+        if (Count == Capacity)
+            Rebuild(KeepFrom);
+
+        int Node = Capacity + Count;
+        MinLow[Node] = Low;
+        MaxHigh[Node] = High;
+        Count++;
+
+        for (Node /= 2; Node >= 1; Node /= 2)
+        {
+            MinLow[Node] = MinLow[2 * Node] < MinLow[2 * Node + 1] ? MinLow[2 * Node] : MinLow[2 * Node + 1];
+            MaxHigh[Node] = MaxHigh[2 * Node] > MaxHigh[2 * Node + 1] ? MaxHigh[2 * Node] : MaxHigh[2 * Node + 1];
+        }
+    }
+
+    // First bar >= From whose low is <= Value, -1 if none
+    int FindFirstLowAtOrBelow(int From, float Value) const
+    {
+        return Find(1, 0, Capacity - 1, From - Base, Value, true);
+    }
+
+    // First bar >= From whose high is >= Value, -1 if none
+    int FindFirstHighAtOrAbove(int From, float Value) const
+    {
+        return Find(1, 0, Capacity - 1, From - Base, Value, false);
+    }
+
+    // First bar >= From that fills a gap whose fill price is Value, -1 if
+    // none: a low at or below it for FVG Up, a high at or above it for FVG
+    // Down
+    int FindFill(bool FVGUp, int From, float Value) const
+    {
+        return FVGUp ? FindFirstLowAtOrBelow(From, Value) : FindFirstHighAtOrAbove(From, Value);
+    }
+
+    // Lowest low and highest high of bars [From, To], both appended: the
+    // nodes covering the range, found from its two ends up
+    float GetMinLow(int From, int To) const
+    {
+        float Min = FLT_MAX;
+        for (int l = Capacity + From - Base, r = Capacity + To - Base + 1; l < r; l /= 2, r /= 2)
+        {
+            if (l & 1)
+            {
+                Min = MinLow[l] < Min ? MinLow[l] : Min;
+                l++;
+            }
+            if (r & 1)
+            {
+                r--;
+                Min = MinLow[r] < Min ? MinLow[r] : Min;
+            }
+        }
+        return Min;
+    }
+
+    float GetMaxHigh(int From, int To) const
+    {
+        float Max = -FLT_MAX;
+        for (int l = Capacity + From - Base, r = Capacity + To - Base + 1; l < r; l /= 2, r /= 2)
+        {
+            if (l & 1)
+            {
+                Max = MaxHigh[l] > Max ? MaxHigh[l] : Max;
+                l++;
+            }
+            if (r & 1)
+            {
+                r--;
+                Max = MaxHigh[r] > Max ? MaxHigh[r] : Max;
+            }
+        }
+        return Max;
+    }
+
+    int Find(int Node, int NodeFirst, int NodeLast, int From, float Value, bool Low) const
+    {
+        if (Capacity == 0 || NodeLast < From || NodeFirst >= Count)
+            return -1;
+        if (Low ? (MinLow[Node] > Value) : (MaxHigh[Node] < Value))
+            return -1;
+        if (NodeFirst == NodeLast)
+            return Base + NodeFirst;
+
+        int Mid = (NodeFirst + NodeLast) / 2;
+        int Found = Find(2 * Node, NodeFirst, Mid, From, Value, Low);
+        if (Found >= 0)
+            return Found;
+        return Find(2 * Node + 1, Mid + 1, NodeLast, From, Value, Low);
+    }
+
+    // Keeps bars [KeepFrom, GetEnd()) in a tree with room for as many again
+    void Rebuild(int KeepFrom)
+    {
+        if (KeepFrom < Base)
+            KeepFrom = Base;
+        if (KeepFrom > GetEnd())
+            KeepFrom = GetEnd();
+
+        int Keep = GetEnd() - KeepFrom;
+        int NewCapacity = 16;
+        while (NewCapacity < 2 * Keep)
+            NewCapacity *= 2;
+
+        std::vector<float> NewMin(2 * NewCapacity, FLT_MAX);
+        std::vector<float> NewMax(2 * NewCapacity, -FLT_MAX);
+        for (int i = 0; i < Keep; i++)
+        {
+            NewMin[NewCapacity + i] = MinLow[Capacity + KeepFrom - Base + i];
+            NewMax[NewCapacity + i] = MaxHigh[Capacity + KeepFrom - Base + i];
+        }
+        for (int Node = NewCapacity - 1; Node >= 1; Node--)
+        {
+            NewMin[Node] = NewMin[2 * Node] < NewMin[2 * Node + 1] ? NewMin[2 * Node] : NewMin[2 * Node + 1];
+            NewMax[Node] = NewMax[2 * Node] > NewMax[2 * Node + 1] ? NewMax[2 * Node] : NewMax[2 * Node + 1];
+        }
+
+        MinLow.swap(NewMin);
+        MaxHigh.swap(NewMax);
+        Base = KeepFrom;
+        Count = Keep;
+        Capacity = NewCapacity;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Open gaps by fill price
+// -----------------------------------------------------------------------------
+
+// Gaps are identified by an int (the study uses the gap's bar index)
+struct s_FVGOpenGaps
+{
+    std::multimap<float, int> Up;       // Bottom of each open FVG Up: filled by a low at or below it
+    std::multimap<float, int> Down;     // Top of each open FVG Down: filled by a high at or above it
+
+    void Clear()
+    {
+        Up.clear();
+        Down.clear();
+    }
+
+    void Add(bool FVGUp, float FillPrice, int ID)
+    {
+        (FVGUp ? Up : Down).insert(std::make_pair(FillPrice, ID));
+    }
+
+    void Remove(bool FVGUp, float FillPrice, int ID)
+    {
+        std::multimap<float, int>& Book = FVGUp ? Up : Down;
+        std::pair<std::multimap<float, int>::iterator, std::multimap<float, int>::iterator> Range = Book.equal_range(FillPrice);
+        for (std::multimap<float, int>::iterator it = Range.first; it != Range.second; ++it)
+        {
+            if (it->second == ID)
+            {
+                Book.erase(it);
+                return;
+            }
+        }
+    }
+
+    // Removes the gaps a bar with this low and high fills, adding their IDs
+    // to Filled
+    void Fill(float Low, float High, std::vector<int>& Filled)
+    {
+        std::multimap<float, int>::iterator UpFirst = Up.lower_bound(Low);
+        for (std::multimap<float, int>::iterator it = UpFirst; it != Up.end(); ++it)
+            Filled.push_back(it->second);
+        Up.erase(UpFirst, Up.end());
+
+        std::multimap<float, int>::iterator DownLast = Down.upper_bound(High);
+        for (std::multimap<float, int>::iterator it = Down.begin(); it != DownLast; ++it)
+            Filled.push_back(it->second);
+        Down.erase(Down.begin(), DownLast);
+    }
+};
+
+#endif // FVG_INDEX_H
@@ -0,0 +1,138 @@
+#ifndef GDI_RESOURCE_CACHE_H
+#define GDI_RESOURCE_CACHE_H
+
+/*
+    GDI objects for studies that draw with sc.p_GDIFunction. Include after
+    sierrachart.h (Windows).
+
+    The drawing function runs on every chart paint, so creating a font there
+    and deleting it afterwards costs a GDI allocation per paint per study.
+    s_GDIResourceCache creates fonts (by face, height and weight), brushes
+    and pens the first time a paint asks for them and keeps them until
+    Release(). The study keeps the cache behind a persistent pointer and
+    deletes it on sc.LastCallToFunction.
+
+    s_GDISelectObject selects an object into the device context for a scope
+    and puts the previous one back when it ends. The DC is handed back as it
+    came, and a cached object is never left selected.
+
+    s_GDIClipArea culls text that would land outside the chart window before
+    anything is formatted or sent to GDI.
+*/
+
+#include <climits>
+#include <map>
+#include <string>
+#include <tuple>
+
+struct s_GDIResourceCache
+{
+    std::map<std::tuple<std::string, int, int>, HFONT> Fonts;   // Face, height, weight
+    std::map<COLORREF, HBRUSH> Brushes;
+    std::map<std::tuple<int, int, COLORREF>, HPEN> Pens;        // Style, width, color
+
+    ~s_GDIResourceCache() { Release(); }
+
+    HFONT GetFont(const char* Face, int Height, int Weight)
+    {
+        std::tuple<std::string, int, int> Key(Face, Height, Weight);
+        std::map<std::tuple<std::string, int, int>, HFONT>::iterator it = Fonts.find(Key);
+        if (it != Fonts.end())
+            return it->second;
+
+        // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-createfonta
+        HFONT Font = CreateFontA(Height, 0, 0, 0, Weight, FALSE, FALSE, FALSE, DEFAULT_CHARSET, OUT_OUTLINE_PRECIS,
+            CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, DEFAULT_PITCH, Face);
+        Fonts[Key] = Font;
+        return Font;
+    }
+
+    HBRUSH GetBrush(COLORREF Color)
+    {
+        std::map<COLORREF, HBRUSH>::iterator it = Brushes.find(Color);
+        if (it != Brushes.end())
+            return it->second;
+
+        HBRUSH Brush = CreateSolidBrush(Color);
+        Brushes[Color] = Brush;
+        return Brush;
+    }
+
+    HPEN GetPen(int Style, int Width, COLORREF Color)
+    {
+        std::tuple<int, int, COLORREF> Key(Style, Width, Color);
+        std::map<std::tuple<int, int, COLORREF>, HPEN>::iterator it = Pens.find(Key);
+        if (it != Pens.end())
+            return it->second;
+
+        HPEN Pen = CreatePen(Style, Width, Color);
+        Pens[Key] = Pen;
+        return Pen;
+    }
+
+    // Deletes every object. None may be selected into a DC at this point.
+    void Release()
+    {
+        for (std::map<std::tuple<std::string, int, int>, HFONT>::iterator it = Fonts.begin(); it != Fonts.end(); ++it)
+        {
+            if (it->second != NULL)
+                DeleteObject(it->second);
+        }
+        for (std::map<COLORREF, HBRUSH>::iterator it = Brushes.begin(); it != Brushes.end(); ++it)
+        {
+            if (it->second != NULL)
+                DeleteObject(it->second);
+        }
+        for (std::map<std::tuple<int, int, COLORREF>, HPEN>::iterator it = Pens.begin(); it != Pens.end(); ++it)
+        {
+            if (it->second != NULL)
+                DeleteObject(it->second);
+        }
+        Fonts.clear();
+        Brushes.clear();
+        Pens.clear();
+    }
+};
+
+struct s_GDISelectObject
+{
+    HDC DeviceContext;
+    HGDIOBJ Previous;
+
+    s_GDISelectObject(HDC DC, HGDIOBJ Object) : DeviceContext(DC), Previous(NULL)
+    {
+        if (Object != NULL)
+            Previous = SelectObject(DeviceContext, Object);
+    }
+
+    ~s_GDISelectObject()
+    {
+        if (Previous != NULL)
+            SelectObject(DeviceContext, Previous);
+    }
+};
+
+// Client area of the chart window, in the pixel coordinates the drawing
+// function uses
+struct s_GDIClipArea
+{
+    RECT Area;
+
+    explicit s_GDIClipArea(HWND WindowHandle)
+    {
+        if (!GetClientRect(WindowHandle, &Area))
+        {
+            Area.left = Area.top = LONG_MIN / 2;
+            Area.right = Area.bottom = LONG_MAX / 2;
+        }
+    }
+
+    // True if text drawn at X, Y (top left) and at most Width by Height
+    // pixels can show in the area
+    bool IsTextVisible(int X, int Y, int Width, int Height) const
+    {
+        return X + Width >= Area.left && X <= Area.right && Y + Height >= Area.top && Y <= Area.bottom;
+    }
+};
+
+#endif // GDI_RESOURCE_CACHE_H
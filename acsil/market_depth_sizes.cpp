@@ -1,4 +1,5 @@
 #include "sierrachart.h"
+#include "gdi_resource_cache.h"
 
 SCDLLName("Market Depth Sizes")
 
@@ -43,6 +44,26 @@ SCSFExport scsf_MarketDepthSizes(SCStudyInterfaceRef sc)
         return;
     }
 
+    // fonts for the GDI call, created once instead of on every paint
+    s_GDIResourceCache* GDIResources = reinterpret_cast<s_GDIResourceCache*>(sc.GetPersistentPointer(0));
+
+    // study is being removed - release the fonts
+    if (sc.LastCallToFunction)
+    {
+        if (GDIResources != NULL)
+        {
+            delete GDIResources;
+            sc.SetPersistentPointer(0, NULL);
+        }
+        return;
+    }
+
+    if (GDIResources == NULL)
+    {
+        GDIResources = new s_GDIResourceCache;
+        sc.SetPersistentPointer(0, GDIResources);
+    }
+
     // we need these data to persist to our windows GDI call
     int num_levels = NumberOfLevels.GetInt();
     sc.SetPersistentInt(0, num_levels);
@@ -54,6 +75,10 @@ SCSFExport scsf_MarketDepthSizes(SCStudyInterfaceRef sc)
 
 void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
 {
+    s_GDIResourceCache* GDIResources = reinterpret_cast<s_GDIResourceCache*>(sc.GetPersistentPointer(0));
+    if (GDIResources == NULL)
+        return;
+
     int MinimumSize = sc.Input[1].GetInt();
     int VerticalOffset = sc.Input[3].GetInt();
     int HorizontalOffset = sc.Input[4].GetInt();
@@ -72,11 +97,8 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     int fontSize = sc.Input[2].GetInt();
     SCString chartFont = sc.ChartTextFont();
 
-    // Windows GDI font creation
-    // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-createfonta
-    HFONT hFont;
-    hFont = CreateFont(fontSize,0,0,0,FW_BOLD,FALSE,FALSE,FALSE,DEFAULT_CHARSET,OUT_OUTLINE_PRECIS,
-            CLIP_DEFAULT_PRECIS,CLEARTYPE_QUALITY, DEFAULT_PITCH,TEXT(chartFont));
+    // Windows GDI font, created on the first paint and kept (gdi_resource_cache.h)
+    HFONT hFont = GDIResources->GetFont(chartFont.GetChars(), fontSize, FW_BOLD);
 
     // https://docs.microsoft.com/en-us/windows/win32/gdi/colorref
     const COLORREF wht = 0x00FFFFFF;
@@ -89,7 +111,14 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
     // https://docs.microsoft.com/en-us/windows/win32/api/wingdi/nf-wingdi-setbkmode
     SetBkMode(DeviceContext, OPAQUE);
 
-    SelectObject(DeviceContext, hFont);
+    // selected until this function returns, then the DC gets its own font back
+    s_GDISelectObject SelectFont(DeviceContext, hFont);
+    ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
+
+    // only text that lands in the chart window is drawn. a number is at most a few digits of fontSize width
+    s_GDIClipArea ClipArea(WindowHandle);
+    const int maxTextWidth = 8 * fontSize;
+
     s_MarketDepthEntry bid_mde;
     s_MarketDepthEntry ask_mde;        // used for calculating avg lot sizes
     for (int i=0; i<num_levels; i++) {
@@ -106,21 +135,16 @@ void DrawToChart(HWND WindowHandle, HDC DeviceContext, SCStudyInterfaceRef sc)
         askY = sc.RegionValueToYPixelCoordinate(ask_mde.Price, sc.GraphRegion);
 
         // print bid side text on DOM
-        msg.Format("%.0f", bid_mde.Quantity/1000);
-        if (bid_mde.Quantity >= MinimumSize) {
-            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
+        if (bid_mde.Quantity >= MinimumSize && ClipArea.IsTextVisible(bidX, bidY - VerticalOffset, maxTextWidth, fontSize)) {
+            msg.Format("%.0f", bid_mde.Quantity/1000);
             ::TextOut(DeviceContext, bidX, bidY - VerticalOffset, msg, msg.GetLength());
         }
 
         // print ask side text to DOM
-        msg.Format("%.0f", ask_mde.Quantity/1000);
-        if (ask_mde.Quantity >= MinimumSize) {
-            ::SetTextAlign(DeviceContext, TA_NOUPDATECP);
+        if (ask_mde.Quantity >= MinimumSize && ClipArea.IsTextVisible(askX, askY - VerticalOffset, maxTextWidth, fontSize)) {
+            msg.Format("%.0f", ask_mde.Quantity/1000);
             ::TextOut(DeviceContext, askX, askY - VerticalOffset, msg, msg.GetLength());
         }
-
-        // delete font
-        DeleteObject(hFont);
     }
 
     return;
@@ -1,4 +1,6 @@
 #include "sierrachart.h"
+#include "momentum_bot_core.h"
+#include "momentum_bot_stats.h"
 
 SCDLLName("XYL - Momentum Bot")
 
@@ -22,6 +24,447 @@ SCDLLName("XYL - Momentum Bot")
     - Trade Direction: Tracks active trades to prevent clustering
 */
 
+struct s_MomentumIndicatorKernel
+{
+    s_MomentumKernelState Committed;
+    int SweptThroughIndex;      // Last bar computed by the full recalculation sweep
+};
+
+// Signal labels are kept as data and drawn through a fixed pool of text
+// drawings. Only signals in or near the visible bars get a drawing, so the
+// number of drawings Sierra paints does not grow with the loaded history.
+const int LABEL_POOL_SIZE = 64;
+const int LABEL_LINE_NUMBER_BASE = 100000;
+
+// Before the pool, each signal had its own drawing: bar index + 100000 for
+// a long, + 200000 for a short
+const int OLD_LONG_LABEL_LINE_NUMBER_BASE = 100000;
+const int OLD_SHORT_LABEL_LINE_NUMBER_BASE = 200000;
+
+struct s_MomentumSignalLabel
+{
+    int Index;                  // Bar of the signal, at most one per bar
+    int Direction;
+    int Setup;
+    float Price;
+};
+
+struct s_MomentumLabelPool
+{
+    std::vector<s_MomentumSignalLabel> Signals;     // Ascending bar index
+    int SlotBarIndex[LABEL_POOL_SIZE];              // Signal bar shown by each slot, -1 = free
+    bool SlotVisible[LABEL_POOL_SIZE];
+    int DrawnFirstBar;          // Bar range and signal count of the last refresh
+    int DrawnLastBar;
+    int DrawnCount;
+    bool OldLabelsDeleted;      // Drawings of the old per-signal scheme removed
+
+    void Reset()
+    {
+        Signals.clear();
+        for (int s = 0; s < LABEL_POOL_SIZE; s++)
+        {
+            SlotBarIndex[s] = -1;
+            SlotVisible[s] = false;
+        }
+        DrawnFirstBar = DrawnLastBar = DrawnCount = -1;
+    }
+
+    // Bars can be calculated again after a signal was recorded, so a new
+    // signal replaces any recorded at or after its bar
+    void Add(const s_MomentumSignalLabel& Label)
+    {
+        while (!Signals.empty() && Signals.back().Index >= Label.Index)
+            Signals.pop_back();
+        Signals.push_back(Label);
+
+        for (int s = 0; s < LABEL_POOL_SIZE; s++)
+        {
+            if (SlotBarIndex[s] >= Label.Index)
+                SlotBarIndex[s] = -1;
+        }
+        DrawnCount = -1;
+    }
+};
+
+// Deletes the pool's drawings, and once per pool the drawings the old
+// per-signal scheme may have left on any bar. Only line numbers this study
+// uses are touched, so other studies' drawings stay.
+static void DeleteSignalLabelDrawings(SCStudyInterfaceRef sc, s_MomentumLabelPool& Pool)
+{
+    for (int s = 0; s < LABEL_POOL_SIZE; s++)
+        sc.DeleteACSChartDrawing(sc.ChartNumber, TOOL_DELETE_CHARTDRAWING, LABEL_LINE_NUMBER_BASE + s);
+
+    if (Pool.OldLabelsDeleted)
+        return;
+    for (int i = 0; i < sc.ArraySize; i++)
+    {
+        sc.DeleteACSChartDrawing(sc.ChartNumber, TOOL_DELETE_CHARTDRAWING, OLD_LONG_LABEL_LINE_NUMBER_BASE + i);
+        sc.DeleteACSChartDrawing(sc.ChartNumber, TOOL_DELETE_CHARTDRAWING, OLD_SHORT_LABEL_LINE_NUMBER_BASE + i);
+    }
+    Pool.OldLabelsDeleted = true;
+}
+
+// Points the pool at the signals around the visible bars (the most recent
+// LABEL_POOL_SIZE if there are more) and hides the slots left over. Slots
+// already showing a wanted signal are left alone.
+static void RefreshSignalLabels(SCStudyInterfaceRef sc, s_MomentumLabelPool& Pool)
+{
+    int Margin = (sc.IndexOfLastVisibleBar - sc.IndexOfFirstVisibleBar) / 4 + 1;
+    int FirstBar = sc.IndexOfFirstVisibleBar - Margin;
+    int LastBar = sc.IndexOfLastVisibleBar + Margin;
+
+    if (FirstBar == Pool.DrawnFirstBar && LastBar == Pool.DrawnLastBar && (int)Pool.Signals.size() == Pool.DrawnCount)
+        return;
+    Pool.DrawnFirstBar = FirstBar;
+    Pool.DrawnLastBar = LastBar;
+    Pool.DrawnCount = (int)Pool.Signals.size();
+
+    // Wanted signals are Signals[Begin, End)
+    int Begin = 0, End = (int)Pool.Signals.size();
+    {
+        int Lo = 0, Hi = End;
+        while (Lo < Hi)
+        {
+            int Mid = (Lo + Hi) / 2;
+            if (Pool.Signals[Mid].Index < FirstBar) Lo = Mid + 1; else Hi = Mid;
+        }
+        Begin = Lo;
+
+        Hi = End;
+        while (Lo < Hi)
+        {
+            int Mid = (Lo + Hi) / 2;
+            if (Pool.Signals[Mid].Index <= LastBar) Lo = Mid + 1; else Hi = Mid;
+        }
+        End = Lo;
+    }
+    if (End - Begin > LABEL_POOL_SIZE)
+        Begin = End - LABEL_POOL_SIZE;
+
+    int FirstWanted = (Begin < End) ? Pool.Signals[Begin].Index : 0;
+    int LastWanted = (Begin < End) ? Pool.Signals[End - 1].Index : -1;
+
+    // Keep the slots that already show a wanted signal, free the rest
+    bool Shown[LABEL_POOL_SIZE] = {};
+    for (int s = 0; s < LABEL_POOL_SIZE; s++)
+    {
+        int Bar = Pool.SlotBarIndex[s];
+        if (Bar < FirstWanted || Bar > LastWanted)
+        {
+            Pool.SlotBarIndex[s] = -1;
+            continue;
+        }
+
+        // Signals are one per bar, so the bar identifies the signal
+        int Lo = Begin, Hi = End;
+        while (Lo < Hi)
+        {
+            int Mid = (Lo + Hi) / 2;
+            if (Pool.Signals[Mid].Index < Bar) Lo = Mid + 1; else Hi = Mid;
+        }
+        if (Lo < End && Pool.Signals[Lo].Index == Bar)
+            Shown[Lo - Begin] = true;
+        else
+            Pool.SlotBarIndex[s] = -1;
+    }
+
+    s_UseTool Tool;
+    int Slot = 0;
+    for (int n = Begin; n < End; n++)
+    {
+        if (Shown[n - Begin])
+            continue;
+
+        while (Pool.SlotBarIndex[Slot] != -1)
+            Slot++;
+
+        const s_MomentumSignalLabel& Label = Pool.Signals[n];
+        bool IsLong = (Label.Direction == 1);
+
+        Tool.Clear();
+        Tool.ChartNumber = sc.ChartNumber;
+        Tool.DrawingType = DRAWING_TEXT;
+        Tool.LineNumber = LABEL_LINE_NUMBER_BASE + Slot;
+        Tool.BeginDateTime = sc.BaseDateTimeIn[Label.Index];
+        Tool.BeginValue = Label.Price;
+        Tool.Text = MOMENTUM_SETUP_LABELS[Label.Setup];
+        Tool.Color = IsLong ? RGB(0, 200, 0) : RGB(255, 50, 50);
+        Tool.FontBold = true;
+        Tool.FontSize = 12;
+        Tool.TextAlignment = DT_CENTER | DT_VCENTER;
+        Tool.HideDrawing = 0;
+        Tool.AddMethod = UTAM_ADD_OR_ADJUST;
+        sc.UseTool(Tool);
+
+        Pool.SlotBarIndex[Slot] = Label.Index;
+        Pool.SlotVisible[Slot] = true;
+    }
+
+    for (int s = 0; s < LABEL_POOL_SIZE; s++)
+    {
+        if (Pool.SlotBarIndex[s] != -1 || !Pool.SlotVisible[s])
+            continue;
+
+        Tool.Clear();
+        Tool.ChartNumber = sc.ChartNumber;
+        Tool.DrawingType = DRAWING_TEXT;
+        Tool.LineNumber = LABEL_LINE_NUMBER_BASE + s;
+        Tool.HideDrawing = 1;
+        Tool.AddMethod = UTAM_ADD_OR_ADJUST;
+        sc.UseTool(Tool);
+
+        Pool.SlotVisible[s] = false;
+    }
+}
+
+// Subgraphs saved in the state checkpoint tail: everything the study reads
+// back from earlier bars, plus the visible lines so they join up on resume
+const int CHECKPOINT_SUBGRAPHS[] = { 0, 2, 3, 4, 5, 12, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 28, 29, 30 };
+const int NUM_CHECKPOINT_SUBGRAPHS = sizeof(CHECKPOINT_SUBGRAPHS) / sizeof(CHECKPOINT_SUBGRAPHS[0]);
+
+// Sidecar files in the Data Files folder, one per symbol and bar period
+static SCString GetCheckpointKey(SCStudyInterfaceRef sc)
+{
+    n_ACSIL::s_BarPeriod BarPeriod;
+    sc.GetBarPeriodParameters(BarPeriod);
+
+    SCString Key;
+    Key.Format("%s_%d_%d_%d", sc.Symbol.GetChars(), BarPeriod.ChartDataType,
+        BarPeriod.IntradayChartBarPeriodType, BarPeriod.IntradayChartBarPeriodParameter1);
+    return Key;
+}
+
+static SCString GetStudyFilePath(SCStudyInterfaceRef sc, const SCString& Key, const char* Suffix)
+{
+    // Symbols can contain characters that are not valid in file names
+    std::string FileName = Key.GetChars();
+    for (size_t c = 0; c < FileName.size(); c++)
+    {
+        char Ch = FileName[c];
+        bool Keep = (Ch >= 'A' && Ch <= 'Z') || (Ch >= 'a' && Ch <= 'z') || (Ch >= '0' && Ch <= '9') || Ch == '_' || Ch == '-';
+        if (!Keep)
+            FileName[c] = '_';
+    }
+
+    SCString Folder = sc.DataFilesFolder();
+    const char* Separator = (Folder.GetLength() > 0 && Folder.GetChars()[Folder.GetLength() - 1] == '\\') ? "" : "\\";
+
+    SCString Path;
+    Path.Format("%s%sMomentumBot_%s%s", Folder.GetChars(), Separator, FileName.c_str(), Suffix);
+    return Path;
+}
+
+// Trading day of the checkpoint bar (the last committed bar), 0 if there is
+// none yet. Saved as the study's day: the forming bar may already be in the
+// next day, and a resume must see that day start again.
+static int GetCheckpointDayDate(SCStudyInterfaceRef sc, const s_MomentumIndicatorKernel& Kernel)
+{
+    int LastBar = Kernel.Committed.NextIndex - 1;
+    if (LastBar < 0 || LastBar >= sc.ArraySize)
+        return 0;
+    return sc.GetTradingDayDate(sc.BaseDateTimeIn[LastBar]);
+}
+
+// Saves the state after the last committed bar. Called when the study is
+// removed or the chartbook closes, and in real time when a trading day starts.
+static void SaveCheckpoint(SCStudyInterfaceRef sc, const s_MomentumParams& Params, const s_MomentumIndicatorKernel& Kernel,
+    const s_SessionVWAPAccumulator& SessionVWAP,
+    const s_MomentumRollingState& Rolling, const s_MomentumTrade& Trade, const s_MomentumDayStats& Day,
+    const s_MomentumLabelPool& Labels, const int* StudyInts, int NumStudyInts)
+{
+    int LastBar = Kernel.Committed.NextIndex - 1;
+    if (LastBar < 0 || LastBar >= sc.ArraySize || SessionVWAP.FormingBarIndex != LastBar + 1)
+        return;
+
+    SCString Key = GetCheckpointKey(sc);
+
+    s_MomentumCheckpoint Checkpoint;
+    Checkpoint.Key             = Key.GetChars();
+    Checkpoint.LastBarDateTime = sc.BaseDateTimeIn[LastBar].GetAsDouble();
+    Checkpoint.LastBarIndex    = LastBar;
+    Checkpoint.Params          = Params;
+    Checkpoint.Kernel          = Kernel.Committed;
+    Checkpoint.SessionVWAP     = SessionVWAP;
+    Checkpoint.Rolling         = Rolling;
+    Checkpoint.Trade           = Trade;
+    Checkpoint.StudyInts.assign(StudyInts, StudyInts + NumStudyInts);
+
+    int First = (LastBar - MOMENTUM_CHECKPOINT_TAIL + 1 > 0) ? LastBar - MOMENTUM_CHECKPOINT_TAIL + 1 : 0;
+    for (int i = First; i <= LastBar; i++)
+        Checkpoint.CloseTail.push_back(sc.Close[i]);
+
+    Checkpoint.SeriesTail.resize(NUM_CHECKPOINT_SUBGRAPHS);
+    for (int n = 0; n < NUM_CHECKPOINT_SUBGRAPHS; n++)
+    {
+        for (int i = First; i <= LastBar; i++)
+            Checkpoint.SeriesTail[n].push_back(sc.Subgraph[CHECKPOINT_SUBGRAPHS[n]][i]);
+    }
+
+    // The day's stats so far and the signals up to the checkpoint bar
+    std::vector<s_MomentumSignalLabel> Signals;
+    for (size_t n = 0; n < Labels.Signals.size() && Labels.Signals[n].Index <= LastBar; n++)
+        Signals.push_back(Labels.Signals[n]);
+
+    s_MomentumByteWriter StudyData(Checkpoint.StudyData);
+    StudyData.Put(Day);
+    StudyData.PutVector(Signals);
+
+    std::vector<char> Data;
+    Checkpoint.Serialize(Data);
+
+    // Length prefix, so a shorter file written over a longer one still reads back correctly
+    uint32_t Length = (uint32_t)Data.size();
+
+    int FileHandle = 0;
+    if (!sc.OpenFile(GetStudyFilePath(sc, Key, ".state"), n_ACSIL::FILE_MODE_CREATE_AND_OPEN_FOR_READ_WRITE, FileHandle))
+        return;
+
+    unsigned int BytesWritten = 0;
+    sc.WriteFile(FileHandle, reinterpret_cast<const char*>(&Length), sizeof(Length), &BytesWritten);
+    sc.WriteFile(FileHandle, &Data[0], (int)Data.size(), &BytesWritten);
+    sc.CloseFile(FileHandle);
+}
+
+// Bars before the checkpoint tail are not recalculated on a resume. The
+// drawn series are filled in for them in one pass each: the kernel outputs
+// (SMA 100, ATR, RSI, ...) and the session VWAP bands. The signal arrows of
+// every restored signal are set from the ATR. Score, chop, delta and the
+// trade lines stay empty before the tail.
+static void FillResumedHistory(SCStudyInterfaceRef sc, const s_MomentumSeries& Series, int ATRLength, int TailStart,
+    const s_MomentumLabelPool& Labels)
+{
+    s_MomentumKernelState Scratch;
+    KernelSweep(Scratch, Series, TailStart, ATRLength);
+
+    s_SessionVWAPAccumulator Session;
+    Session.Reset(0, 0);
+    for (int i = 0; i < TailStart; i++)
+    {
+        int Date = sc.GetTradingDayDate(sc.BaseDateTimeIn[i]);
+        if (i == 0 || Date != Session.SessionDate)
+            Session.Reset(Date, i);
+
+        double VWAPValue = sc.Close[i];
+        double StdDev = 0.0;
+        Session.GetVWAP(sc.BaseData[SC_LAST][i], sc.BaseData[SC_VOLUME][i], VWAPValue, StdDev);
+        Session.Commit(sc.BaseData[SC_LAST][i], sc.BaseData[SC_VOLUME][i]);
+
+        sc.Subgraph[16][i] = (float)VWAPValue;
+        sc.Subgraph[12][i] = (float)VWAPValue + (2.0f * (float)StdDev);
+        sc.Subgraph[15][i] = (float)VWAPValue - (2.0f * (float)StdDev);
+    }
+
+    for (size_t n = 0; n < Labels.Signals.size(); n++)
+    {
+        int i = Labels.Signals[n].Index;
+        if (Labels.Signals[n].Direction == 1)
+            sc.Subgraph[6][i] = sc.Low[i] - (sc.Subgraph[3][i] * 0.5f);
+        else
+            sc.Subgraph[7][i] = sc.High[i] + (sc.Subgraph[3][i] * 0.5f);
+    }
+}
+
+// Restores the state saved by SaveCheckpoint if it matches this chart and its
+// inputs. Day must hold the current histogram edges; the saved day replaces
+// it. Returns the checkpoint bar's index (bars up to it need no
+// recalculation) or -1 if there is no usable checkpoint.
+static int LoadCheckpoint(SCStudyInterfaceRef sc, const s_MomentumParams& Params, const s_MomentumSeries& Series,
+    s_MomentumIndicatorKernel& Kernel,
+    s_SessionVWAPAccumulator& SessionVWAP, s_MomentumRollingState& Rolling, s_MomentumTrade& Trade, s_MomentumDayStats& Day,
+    s_MomentumLabelPool& Labels, int* StudyInts, int NumStudyInts)
+{
+    SCString Key = GetCheckpointKey(sc);
+
+    int FileHandle = 0;
+    if (!sc.OpenFile(GetStudyFilePath(sc, Key, ".state"), n_ACSIL::FILE_MODE_OPEN_EXISTING_FOR_SEQUENTIAL_READING, FileHandle))
+        return -1;
+
+    uint32_t Length = 0;
+    unsigned int BytesRead = 0;
+    std::vector<char> Data;
+    sc.ReadFile(FileHandle, reinterpret_cast<char*>(&Length), sizeof(Length), &BytesRead);
+    if (BytesRead == sizeof(Length) && Length > 0 && Length < 64 * 1024 * 1024)
+    {
+        Data.resize(Length);
+        sc.ReadFile(FileHandle, &Data[0], (int)Length, &BytesRead);
+        if (BytesRead != Length)
+            Data.clear();
+    }
+    sc.CloseFile(FileHandle);
+
+    s_MomentumCheckpoint Checkpoint;
+    if (Data.empty() || !Checkpoint.Deserialize(&Data[0], Data.size()))
+        return -1;
+
+    // Same chart and the same inputs: any of them changes the signals, the
+    // virtual trade or the indicators the state was built from
+    if (Checkpoint.Key != Key.GetChars() || !MomentumSameParams(Checkpoint.Params, Params)
+        || (int)Checkpoint.StudyInts.size() != NumStudyInts
+        || (int)Checkpoint.SeriesTail.size() != NUM_CHECKPOINT_SUBGRAPHS)
+        return -1;
+
+    // The checkpoint bar must still be loaded, with enough history before it
+    // for the kernel's windows, and at least one bar after it
+    int NewIndex = sc.GetExactMatchForSCDateTime(sc.ChartNumber, SCDateTime(Checkpoint.LastBarDateTime));
+    int Lookback = MomentumKernelLookback(Params.ATRLength);
+    int TailCount = (int)Checkpoint.CloseTail.size();
+    if (NewIndex < 0 || NewIndex >= sc.ArraySize - 1 || NewIndex < Lookback || Checkpoint.LastBarIndex < Lookback
+        || NewIndex + 1 < TailCount)
+        return -1;
+
+    // and hold the same data
+    int First = NewIndex - TailCount + 1;
+    for (int t = 0; t < TailCount; t++)
+    {
+        if (sc.Close[First + t] != Checkpoint.CloseTail[t])
+            return -1;
+    }
+
+    // The day's stats must be over the histogram edges in use now
+    s_MomentumDayStats SavedDay;
+    std::vector<s_MomentumSignalLabel> Signals;
+    s_MomentumByteReader StudyData(Checkpoint.StudyData.empty() ? NULL : &Checkpoint.StudyData[0], Checkpoint.StudyData.size());
+    StudyData.Get(SavedDay);
+    StudyData.GetVector(Signals, 16 * 1024 * 1024);
+    if (!StudyData.Ok || StudyData.Position != Checkpoint.StudyData.size() || SavedDay.Slope.NumEdges != Day.Slope.NumEdges
+        || memcmp(SavedDay.Slope.Edges, Day.Slope.Edges, sizeof(float) * Day.Slope.NumEdges) != 0)
+        return -1;
+
+    int Delta = NewIndex - Checkpoint.LastBarIndex;
+    Checkpoint.ShiftIndexes(Delta);
+
+    Day = SavedDay;
+    if (Day.LastBarIndex >= 0)
+        Day.LastBarIndex += Delta;
+
+    // Signals on bars no longer loaded are dropped
+    Labels.Reset();
+    for (size_t n = 0; n < Signals.size(); n++)
+    {
+        Signals[n].Index += Delta;
+        if (Signals[n].Index >= 0)
+            Labels.Signals.push_back(Signals[n]);
+    }
+
+    Kernel.Committed = Checkpoint.Kernel;
+    Kernel.SweptThroughIndex = NewIndex;
+    SessionVWAP = Checkpoint.SessionVWAP;
+    Rolling = Checkpoint.Rolling;
+    Trade = Checkpoint.Trade;
+    for (int n = 0; n < NumStudyInts; n++)
+        StudyInts[n] = Checkpoint.StudyInts[n];
+
+    for (int n = 0; n < NUM_CHECKPOINT_SUBGRAPHS; n++)
+    {
+        for (int t = 0; t < TailCount; t++)
+            sc.Subgraph[CHECKPOINT_SUBGRAPHS[n]][First + t] = Checkpoint.SeriesTail[n][t];
+    }
+
+    FillResumedHistory(sc, Series, Params.ATRLength, First, Labels);
+
+    return NewIndex;
+}
 
 SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
 {
@@ -70,39 +513,7 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
     int& LastDayDate            = sc.GetPersistentInt(0);
     int& DailyCount             = sc.GetPersistentInt(4);
     int& LastTradeIndex         = sc.GetPersistentInt(5);
-
-    // Trade Position Tracking (For Visual Backtesting)
-    int& TradeDirection         = sc.GetPersistentInt(6); // 0=Flat, 1=Long, -1=Short
-    double& EntryPrice          = sc.GetPersistentDouble(7);
-    double& StopPrice           = sc.GetPersistentDouble(8);
-    double& TargetPrice         = sc.GetPersistentDouble(9);
-    int& LastExitIndex          = sc.GetPersistentInt(10); // Cooldown after exit
-    int& LastSignalIndex        = sc.GetPersistentInt(11); // Track last signal bar
-
-    // Slope Tracking (for debugging)
-    double& MinSlopeSession     = sc.GetPersistentDouble(13);
-    double& MaxSlopeSession     = sc.GetPersistentDouble(14);
-    int& TotalBarCount          = sc.GetPersistentInt(15);
-    int& SlopeNegCount          = sc.GetPersistentInt(16);  // < 0
-    int& SlopeNeg05Count        = sc.GetPersistentInt(17);  // < -0.05%
-    int& SlopeNeg08Count        = sc.GetPersistentInt(18);  // < -0.08%
-    int& SlopePosCount          = sc.GetPersistentInt(19);  // > 0
-    int& SlopePos05Count        = sc.GetPersistentInt(20);  // > 0.05%
-    int& SlopePos08Count        = sc.GetPersistentInt(21);  // > 0.08%
-    int& SlopeNeg05to0Count     = sc.GetPersistentInt(22);  // -0.05% to 0
-    int& Slope0toPos05Count     = sc.GetPersistentInt(23);  // 0 to 0.05%
-
-    // Setup Tracking (for debugging)
-    int& SetupA_LongCount       = sc.GetPersistentInt(24);
-    int& SetupA_ShortCount      = sc.GetPersistentInt(25);
-    int& SetupB_LongCount       = sc.GetPersistentInt(26);
-    int& SetupB_ShortCount      = sc.GetPersistentInt(27);
-    int& SetupC_LongCount       = sc.GetPersistentInt(28);
-    int& SetupC_ShortCount      = sc.GetPersistentInt(29);
-    int& SetupD_LongCount       = sc.GetPersistentInt(30);
-    int& SetupD_ShortCount      = sc.GetPersistentInt(31);
-    int& SetupE_LongCount       = sc.GetPersistentInt(32);
-    int& SetupE_ShortCount      = sc.GetPersistentInt(33);
+    int& ResumeAfterIndex       = sc.GetPersistentInt(34); // Bars up to here were restored from the checkpoint
 
     // =========================================================================
     // 3. INPUTS
@@ -125,8 +536,11 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
     SCInputRef ChopFlatBarPct      = sc.Input[14];
     SCInputRef MinBarsBetweenTrades= sc.Input[15];
     SCInputRef SlopeDirThreshold   = sc.Input[16];  // Slope direction filter %
-    SCInputRef EnableSlopeLog      = sc.Input[17];  // Enable slope stats logging
-    SCInputRef EnableSetupLog      = sc.Input[18];  // Enable setup count logging
+    // Inputs 17 and 18 were the slope stats and setup count log switches.
+    // They are left unnamed, so they are not shown, and are not reused.
+    SCInputRef UseStateCheckpoint  = sc.Input[19];  // Save state on close, resume from it on reload
+    SCInputRef WriteStatsFile      = sc.Input[20];  // Daily slope histogram and setup counts to CSV
+    SCInputRef SlopeHistogramEdges = sc.Input[21];  // Bucket edges for the slope histogram
 
     // =========================================================================
     // 4. CONFIGURATION (SetDefaults)
@@ -163,6 +577,7 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
 
         ATRLength.Name = "ATR Length";
         ATRLength.SetInt(14);
+        ATRLength.SetIntLimits(1, MAX_STUDY_LENGTH);
 
         TradeRTHOnly.Name = "Trade RTH Only";
         TradeRTHOnly.SetYesNo(false);
@@ -181,6 +596,7 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
 
         ChopLookback.Name = "Chop Detection Lookback";
         ChopLookback.SetInt(20);
+        ChopLookback.SetIntLimits(1, 5000);
 
         ChopFlatBarPct.Name = "Chop: Min Flat Bars (%)";
         ChopFlatBarPct.SetInt(70);  // Choppy if 70% of bars have slope < 0.05%
@@ -191,11 +607,17 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
         SlopeDirThreshold.Name = "Slope Direction Block (%)";
         SlopeDirThreshold.SetInt(50);  // Block longs if 50%+ bars have negative slope
 
-        EnableSlopeLog.Name = "Enable Slope Stats Log";
-        EnableSlopeLog.SetYesNo(false);  // Disabled by default
+        UseStateCheckpoint.Name = "Resume From State Checkpoint";
+        UseStateCheckpoint.SetYesNo(false);
+        UseStateCheckpoint.SetDescription("Saves the indicator, virtual trade and stats state to the Data Files folder when the chart closes and, in real time, when a trading day starts. On reload, bars up to the saved bar are not recalculated; the indicator lines, VWAP bands and signals are filled in for them.");
+
+        WriteStatsFile.Name = "Write Stats File";
+        WriteStatsFile.SetYesNo(false);  // Disabled by default
+        WriteStatsFile.SetDescription("Writes one row per trading day (slope histogram, signals per setup) to MomentumBot_<symbol>_<period>_Stats.csv in the Data Files folder. A day's row is written when the day ends; the current day's row, marked incomplete, when the study is removed or the chart closes.");
 
-        EnableSetupLog.Name = "Enable Setup Count Log";
-        EnableSetupLog.SetYesNo(false);  // Disabled by default
+        SlopeHistogramEdges.Name = "Slope Histogram Edges (%)";
+        SlopeHistogramEdges.SetString(MOMENTUM_STATS_DEFAULT_EDGES);
+        SlopeHistogramEdges.SetDescription("Comma separated, ascending. Invalid lists fall back to the default.");
 
         // --- Visuals ---
         Band_Top_20.Name = "T2 std";
@@ -270,267 +692,302 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
         return;
     }
 
-    sc.SendOrdersToTradeService = SendOrdersToService.GetYesNo();
+    s_SessionVWAPAccumulator* SessionVWAP = reinterpret_cast<s_SessionVWAPAccumulator*>(sc.GetPersistentPointer(0));
+    s_MomentumRollingState* Rolling = reinterpret_cast<s_MomentumRollingState*>(sc.GetPersistentPointer(1));
+    s_MomentumIndicatorKernel* Kernel = reinterpret_cast<s_MomentumIndicatorKernel*>(sc.GetPersistentPointer(2));
+    s_MomentumTrade* Trade = reinterpret_cast<s_MomentumTrade*>(sc.GetPersistentPointer(3)); // Virtual trade (For Visual Backtesting)
+    s_MomentumStatsSink* Stats = reinterpret_cast<s_MomentumStatsSink*>(sc.GetPersistentPointer(4));
+    s_MomentumLabelPool* Labels = reinterpret_cast<s_MomentumLabelPool*>(sc.GetPersistentPointer(5));
+
+    s_MomentumParams Params;
+    Params.HardStopPercent      = HardStopPercent.GetFloat();
+    Params.TargetATRMult        = TargetATRMult.GetFloat();
+    Params.ExtTargetATRMult     = ExtTargetATRMult.GetFloat();
+    Params.TrailTriggerATR      = TrailTriggerATR.GetFloat();
+    Params.TrailDistATR         = TrailDistATR.GetFloat();
+    Params.ATRLength            = ATRLength.GetInt();
+    Params.TradeRTHOnly         = TradeRTHOnly.GetYesNo();
+    Params.MinSlopeThreshold    = MinSlopeThreshold.GetFloat();
+    Params.ExtremeSlopeBlock    = ExtremeSlopeBlock.GetFloat();
+    Params.SetupBSlopeGate      = SetupBSlopeGate.GetFloat();
+    Params.ChopLookback         = ChopLookback.GetInt();
+    Params.ChopFlatBarPct       = ChopFlatBarPct.GetInt();
+    Params.MinBarsBetweenTrades = MinBarsBetweenTrades.GetInt();
+    Params.SlopeDirThreshold    = SlopeDirThreshold.GetInt();
+
+    // Study is being removed - save the checkpoint, clean up memory
+    if (sc.LastCallToFunction)
+    {
+        if (UseStateCheckpoint.GetYesNo() && SessionVWAP != NULL && Rolling != NULL && Kernel != NULL && Trade != NULL
+            && Stats != NULL && Labels != NULL)
+        {
+            int StudyInts[] = { GetCheckpointDayDate(sc, *Kernel), DailyCount, LastTradeIndex };
+            SaveCheckpoint(sc, Params, *Kernel, *SessionVWAP, *Rolling, *Trade, Stats->Day, *Labels, StudyInts, 3);
+        }
 
-    // =========================================================================
-    // 5. DATA & VWAP CALCULATION
-    // =========================================================================
+        if (SessionVWAP != NULL)
+        {
+            delete SessionVWAP;
+            sc.SetPersistentPointer(0, NULL);
+        }
+        if (Rolling != NULL)
+        {
+            delete Rolling;
+            sc.SetPersistentPointer(1, NULL);
+        }
+        if (Kernel != NULL)
+        {
+            delete Kernel;
+            sc.SetPersistentPointer(2, NULL);
+        }
+        if (Trade != NULL)
+        {
+            delete Trade;
+            sc.SetPersistentPointer(3, NULL);
+        }
+        if (Stats != NULL)
+        {
+            // The day in progress, then the queued rows are written out
+            // and the writer thread ends
+            s_MomentumStatsRow StatsRow;
+            Stats->Day.GetRow(StatsRow, false);
+            if (StatsRow.Slope.Total > 0)
+                Stats->Writer.Push(StatsRow);
+
+            delete Stats;
+            sc.SetPersistentPointer(4, NULL);
+        }
+        if (Labels != NULL)
+        {
+            delete Labels;
+            sc.SetPersistentPointer(5, NULL);
+        }
+        return;
+    }
 
-    if (sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.Index]) != LastDayDate)
+    if (SessionVWAP == NULL)
     {
-        LastDayDate         = sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.Index]);
-        DailyCount          = 0;
-        CumDelta[sc.Index]  = 0;
-        TradeDirection      = 0; // Reset Trade Position
+        SessionVWAP = new s_SessionVWAPAccumulator;
+        SessionVWAP->Reset(0, -1);
+        sc.SetPersistentPointer(0, SessionVWAP);
     }
 
-    // Reset slope and setup tracking only on full recalculation (start of chart load)
-    if (sc.Index == 0)
+    if (Rolling == NULL)
     {
-        MinSlopeSession = 999.0;
-        MaxSlopeSession = -999.0;
-        TotalBarCount = 0;
-        SlopeNegCount = 0;
-        SlopeNeg05Count = 0;
-        SlopeNeg08Count = 0;
-        SlopePosCount = 0;
-        SlopePos05Count = 0;
-        SlopePos08Count = 0;
-        SlopeNeg05to0Count = 0;
-        Slope0toPos05Count = 0;
-
-        // Reset setup counters
-        SetupA_LongCount = 0;
-        SetupA_ShortCount = 0;
-        SetupB_LongCount = 0;
-        SetupB_ShortCount = 0;
-        SetupC_LongCount = 0;
-        SetupC_ShortCount = 0;
-        SetupD_LongCount = 0;
-        SetupD_ShortCount = 0;
-        SetupE_LongCount = 0;
-        SetupE_ShortCount = 0;
+        Rolling = new s_MomentumRollingState;
+        Rolling->Reset(ChopLookback.GetInt());
+        sc.SetPersistentPointer(1, Rolling);
     }
-    else
+
+    if (Kernel == NULL)
     {
-        CumDelta[sc.Index] = CumDelta[sc.Index - 1] + (sc.AskVolume[sc.Index] - sc.BidVolume[sc.Index]);
+        Kernel = new s_MomentumIndicatorKernel;
+        Kernel->Committed.Reset();
+        Kernel->SweptThroughIndex = -1;
+        sc.SetPersistentPointer(2, Kernel);
     }
 
-    // --- Find Day Start Bar Index ---
-    int DayStartBarIndex = sc.Index;
-    int CurrentDate = sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.Index]);
-
-    if (DayStartBarIndex > 0)
+    if (Trade == NULL)
     {
-        while (DayStartBarIndex > 0)
-        {
-            int PrevBarDate = sc.GetTradingDayDate(sc.BaseDateTimeIn[DayStartBarIndex - 1]);
-            if (PrevBarDate != CurrentDate) break;
-            DayStartBarIndex--;
-        }
+        Trade = new s_MomentumTrade;
+        Trade->Reset();
+        sc.SetPersistentPointer(3, Trade);
     }
 
-    // --- VWAP Calculation using Sierra Chart built-in (faster internal loop) ---
-    int BarsInDay = sc.Index - DayStartBarIndex + 1;
-    sc.VolumeWeightedMovingAverage(sc.BaseData[SC_LAST], sc.BaseData[SC_VOLUME], VWAP, sc.Index, BarsInDay);
-
-    float VWAPValue = VWAP[sc.Index];
-
-    // --- StdDev Calculation (Iterative for accuracy) ---
-    double TotalVol = 0.0;
-    double TotalP2V = 0.0;
-
-    // Loop from start of day to current bar to calculate sums
-    // This avoids double-counting issues on the last bar during real-time updates
-    for (int i = DayStartBarIndex; i <= sc.Index; i++)
+    if (Stats == NULL)
     {
-        float P = sc.BaseData[SC_LAST][i];
-        float V = sc.BaseData[SC_VOLUME][i];
-        TotalVol += V;
-        TotalP2V += (double)P * P * V;
+        Stats = new s_MomentumStatsSink;
+        Stats->Day.Reset(SlopeHistogramEdges.GetString());
+        sc.SetPersistentPointer(4, Stats);
     }
 
-    float StdDev = 0.0f;
-    if (TotalVol > 0)
+    if (Labels == NULL)
     {
-        double MeanOfSquares = TotalP2V / TotalVol;
-        double Variance = MeanOfSquares - ((double)VWAPValue * VWAPValue);
-        if (Variance < 0) Variance = 0;
-        StdDev = (float)sqrt(Variance);
+        Labels = new s_MomentumLabelPool;
+        Labels->Reset();
+        Labels->OldLabelsDeleted = false;
+        sc.SetPersistentPointer(5, Labels);
     }
 
-    // Bands
-    Band_Top_20[sc.Index] = VWAP[sc.Index] + (2.0f * StdDev);
-    Band_Bot_20[sc.Index] = VWAP[sc.Index] - (2.0f * StdDev);
+    // Full recalculation: start the rolling windows, the virtual trade and
+    // the signal labels over
+    if (sc.Index == 0)
+    {
+        Trade->Reset();
+        DeleteSignalLabelDrawings(sc, *Labels);
+        Labels->Reset();
+        Rolling->Reset(ChopLookback.GetInt());
+    }
 
-    // Internal 1.0 SD (for trend continuation)
-    float Band_Top_10 = VWAP[sc.Index] + (1.0f * StdDev);
-    float Band_Bot_10 = VWAP[sc.Index] - (1.0f * StdDev);
+    sc.SendOrdersToTradeService = SendOrdersToService.GetYesNo();
 
-    // Internal 0.5 SD
-    float Band_Top_05 = VWAP[sc.Index] + (0.5f * StdDev);
-    float Band_Bot_05 = VWAP[sc.Index] - (0.5f * StdDev);
+    // Kernel inputs and outputs (section 6), straight on the bar data and subgraph arrays
+    s_MomentumSeries Series;
+    Series.High    = &sc.High[0];
+    Series.Low     = &sc.Low[0];
+    Series.Close   = &sc.Close[0];
+    Series.Volume  = &sc.Volume[0];
+    Series.SMA100  = &SMA100[0];
+    Series.EMA1000 = &EMA1000[0];
+    Series.EMA50   = &EMA50[0];
+    Series.ATR     = &ATR[0];
+    Series.ATR20   = &ATR20[0];
+    Series.RSI     = &RSI[0];
+    Series.CCISMA  = &CCITempSMA[0];
+    Series.CCI     = &CCI[0];
+    Series.ADX     = &ADX[0];
+    Series.MFI     = &MFI[0];
+    Series.StochK  = &StochK[0];
+
+    // Already part of the restored checkpoint
+    if (sc.Index > 0 && sc.Index <= ResumeAfterIndex)
+        return;
 
     // =========================================================================
-    // 6. TREND & CHOP DETECTION
+    // 5. DATA & VWAP CALCULATION
     // =========================================================================
 
-    sc.SimpleMovAvg(sc.Close, SMA100, sc.Index, 100);
-    sc.ExponentialMovAvg(sc.Close, EMA1000, sc.Index, 1000);
-    sc.ExponentialMovAvg(sc.Close, EMA50, sc.Index, 50);
+    bool DayStarted = false;
+    if (sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.Index]) != LastDayDate)
+    {
+        LastDayDate         = sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.Index]);
+        DailyCount          = 0;
+        CumDelta[sc.Index]  = 0;
+        Trade->Direction    = 0; // Reset Trade Position
+        DayStarted          = true;
+    }
 
-    // 1. Slope (percentage of price movement for cross-instrument compatibility)
-    float CurrentSlope = 0.0f;
-    if (sc.Index >= 5 && sc.Close[sc.Index] > 0 && sc.Close[sc.Index - 5] > 0)
+    if (sc.Index > 0)
     {
-        float PriceNow = sc.Close[sc.Index];
-        float PricePrev = sc.Close[sc.Index - 5];
-        float AbsoluteSlope = PriceNow - PricePrev;
-        CurrentSlope = (AbsoluteSlope / PriceNow) * 100.0f;
+        CumDelta[sc.Index] = CumDelta[sc.Index - 1] + (sc.AskVolume[sc.Index] - sc.BidVolume[sc.Index]);
     }
-    PriceSlope[sc.Index] = CurrentSlope;
 
-    // Track min/max slope for session (every bar)
-    if (CurrentSlope < MinSlopeSession) MinSlopeSession = CurrentSlope;
-    if (CurrentSlope > MaxSlopeSession) MaxSlopeSession = CurrentSlope;
-
-    // Count slope distribution
-    TotalBarCount++;
-    if (CurrentSlope < 0) SlopeNegCount++;
-    if (CurrentSlope < -0.05f) SlopeNeg05Count++;
-    if (CurrentSlope < -0.08f) SlopeNeg08Count++;
-    if (CurrentSlope > 0) SlopePosCount++;
-    if (CurrentSlope > 0.05f) SlopePos05Count++;
-    if (CurrentSlope > 0.08f) SlopePos08Count++;
-    if (CurrentSlope >= -0.05f && CurrentSlope < 0) SlopeNeg05to0Count++;
-    if (CurrentSlope > 0 && CurrentSlope <= 0.05f) Slope0toPos05Count++;
-
-    // Log slope stats on bar close or on full recalculation (if enabled)
-    if (EnableSlopeLog.GetYesNo())
-    {
-        bool IsLastBar = (sc.Index == sc.ArraySize - 1);
-        bool BarClosed = (sc.GetBarHasClosedStatus() == BHCS_BAR_HAS_CLOSED);
-        bool IsFullRecalc = sc.IsFullRecalculation;
-
-        if (IsLastBar && (BarClosed || IsFullRecalc))
+    // --- State Checkpoint ---
+    // On a full recalculation, restore the saved state and skip every bar up
+    // to the checkpoint bar. Calculation resumes with the bar after it.
+    if (sc.Index == 0)
+    {
+        ResumeAfterIndex = -1;
+
+        // Stats restart with the chart, or carry on with the checkpoint's day
+        Stats->Day.Reset(SlopeHistogramEdges.GetString());
+
+        if (sc.IsFullRecalculation && UseStateCheckpoint.GetYesNo())
         {
-            float Total = (float)TotalBarCount;
-            SCString LogMsg;
-            LogMsg.Format("Slope: Min=%.3f%% Max=%.3f%% | Bars=%d | <-0.08: %d(%.1f%%) <-0.05: %d(%.1f%%) [-0.05,0): %d(%.1f%%) | (0,0.05]: %d(%.1f%%) >0.05: %d(%.1f%%) >0.08: %d(%.1f%%)",
-                MinSlopeSession, MaxSlopeSession, TotalBarCount,
-                SlopeNeg08Count, (SlopeNeg08Count / Total) * 100.0f,
-                SlopeNeg05Count, (SlopeNeg05Count / Total) * 100.0f,
-                SlopeNeg05to0Count, (SlopeNeg05to0Count / Total) * 100.0f,
-                Slope0toPos05Count, (Slope0toPos05Count / Total) * 100.0f,
-                SlopePos05Count, (SlopePos05Count / Total) * 100.0f,
-                SlopePos08Count, (SlopePos08Count / Total) * 100.0f);
-            sc.AddMessageToLog(LogMsg, 1);  // 1 = red color
+            int StudyInts[3];
+            ResumeAfterIndex = LoadCheckpoint(sc, Params, Series, *Kernel, *SessionVWAP, *Rolling, *Trade, Stats->Day, *Labels, StudyInts, 3);
+            if (ResumeAfterIndex >= 0)
+            {
+                LastDayDate = StudyInts[0];
+                DailyCount = StudyInts[1];
+                LastTradeIndex = StudyInts[2];
+            }
         }
-    }
 
-    // 2. Trend States
-    float TrendThresh = MinSlopeThreshold.GetFloat();
-    bool StrongUp     = (CurrentSlope > TrendThresh);
-    bool StrongDown   = (CurrentSlope < -TrendThresh);
+        // After a resume the rows of the days before the checkpoint's day
+        // are already in the file, so it is appended to from that day on
+        Stats->Writer.Stop();
+        if (WriteStatsFile.GetYesNo())
+            Stats->Writer.Start(GetStudyFilePath(sc, GetCheckpointKey(sc), "_Stats.csv").GetChars(), ResumeAfterIndex >= 0,
+                Stats->Day.TradingDate);
 
-    // 3. Extreme States
-    float KillThresh  = ExtremeSlopeBlock.GetFloat();
-    bool IsExtremeUp  = (CurrentSlope > KillThresh);
-    bool IsExtremeDown= (CurrentSlope < -KillThresh);
+        if (ResumeAfterIndex >= 0)
+            return;
+    }
 
-    // 4. Chop Detection + Slope Direction (shared lookback)
-    int SmallSlopeCount = 0;
-    int NegSlopeCount = 0;
-    int PosSlopeCount = 0;
-    int Lookback = ChopLookback.GetInt();
-    float ChopSlopeThreshold = 0.05f;  // 0.05% threshold for "no real movement"
-    int BarsChecked = 0;
+    // --- Session VWAP Accumulator ---
+    // New trading day, or a recalculation stepped back behind the committed bars:
+    // restart the sums at the session's first bar. Normally the first bar of the
+    // day is the current bar, so the walk back stops immediately.
+    int CurrentDate = sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.Index]);
 
-    for (int i = 0; i < Lookback; i++)
+    if (CurrentDate != SessionVWAP->SessionDate || sc.Index < SessionVWAP->FormingBarIndex)
     {
-        int idx = sc.Index - i;
-        if (idx < 0)
-            break;
-
-        BarsChecked++;
-        float slope = PriceSlope[idx];
-        float AbsSlope = (slope > 0) ? slope : -slope;
+        int DayStartBarIndex = sc.Index;
+        while (DayStartBarIndex > 0 && sc.GetTradingDayDate(sc.BaseDateTimeIn[DayStartBarIndex - 1]) == CurrentDate)
+            DayStartBarIndex--;
 
-        if (AbsSlope < ChopSlopeThreshold)
-        {
-            SmallSlopeCount++;
-        }
+        SessionVWAP->Reset(CurrentDate, DayStartBarIndex);
+    }
 
-        // Count slope direction
-        if (slope < 0) NegSlopeCount++;
-        if (slope > 0) PosSlopeCount++;
+    // Commit bars that have closed since the last call (usually just the previous bar)
+    while (SessionVWAP->FormingBarIndex < sc.Index)
+    {
+        int i = SessionVWAP->FormingBarIndex;
+        SessionVWAP->Commit(sc.BaseData[SC_LAST][i], sc.BaseData[SC_VOLUME][i]);
     }
 
-    // Choppy if X% of bars have tiny slope changes
-    float ChopPercent = (BarsChecked > 0) ? (SmallSlopeCount * 100.0f / BarsChecked) : 0.0f;
-    bool IsChoppy = (ChopPercent >= (float)ChopFlatBarPct.GetInt());
-    ChopState[sc.Index] = IsChoppy ? 1.0f : 0.0f;  // 1.0 = True (Choppy), 0.0 = False
+    // --- VWAP & StdDev (constant work per bar) ---
+    // The close until the session has volume
+    double VWAPValue = sc.Close[sc.Index];
+    double SessionStdDev = 0.0;
+    SessionVWAP->GetVWAP(sc.BaseData[SC_LAST][sc.Index], sc.BaseData[SC_VOLUME][sc.Index], VWAPValue, SessionStdDev);
+    float StdDev = (float)SessionStdDev;
+    VWAP[sc.Index] = (float)VWAPValue;
 
-    // Slope Direction Filter: X%+ negative = no longs, X%+ positive = no shorts
-    float NegSlopePct = (BarsChecked > 0) ? (NegSlopeCount * 100.0f / BarsChecked) : 0.0f;
-    float PosSlopePct = (BarsChecked > 0) ? (PosSlopeCount * 100.0f / BarsChecked) : 0.0f;
-    float DirThreshold = (float)SlopeDirThreshold.GetInt();
-    bool MajorityNegative = (NegSlopePct >= DirThreshold);
-    bool MajorityPositive = (PosSlopePct >= DirThreshold);
+    // Bands
+    Band_Top_20[sc.Index] = VWAP[sc.Index] + (2.0f * StdDev);
+    Band_Bot_20[sc.Index] = VWAP[sc.Index] - (2.0f * StdDev);
+    // Internal 1.0 SD and 0.5 SD bands are derived in MomentumBuildContext
 
     // =========================================================================
-    // 7. INDICATORS & SCORING
+    // 6. TREND & CHOP DETECTION
     // =========================================================================
 
-    sc.ATR(sc.BaseData, ATR, sc.Index, ATRLength.GetInt(), MOVAVGTYPE_SIMPLE);
-    sc.RSI(sc.Close, RSI, sc.Index, MOVAVGTYPE_SIMPLE, 14);
-    sc.CCI(sc.Close, CCITempSMA, CCI, sc.Index, 14, 0.015f, MOVAVGTYPE_SIMPLE);
-    sc.ADX(sc.BaseData, ADX, sc.Index, 14, 14);
-    sc.SimpleMovAvg(ATR, ATR20, sc.Index, 20);
-
-    // MFI
-    double posFlow = 0.0;
-    double negFlow = 0.0;
-    for (int i = 0; i < 14; i++)
+    // Indicators for sections 6 and 7 come from the fused kernel. A full
+    // recalculation computes every bar in one sweep on the first call; the
+    // remaining historical calls of that recalculation reuse the results.
+    // Real-time updates and new bars go through the same kernel one bar at a time.
+    if (sc.Index == 0 && sc.IsFullRecalculation)
     {
-        int idx = sc.Index - i;
-        if (idx < 1) continue;
-
-        float tpNow  = (sc.High[idx] + sc.Low[idx] + sc.Close[idx]) / 3.0f;
-        float tpPrev = (sc.High[idx-1] + sc.Low[idx-1] + sc.Close[idx-1]) / 3.0f;
+        KernelSweep(Kernel->Committed, Series, sc.ArraySize, Params.ATRLength);
+        Kernel->SweptThroughIndex = sc.ArraySize - 1;
+    }
+    else if (!sc.IsFullRecalculation || sc.Index >= Kernel->SweptThroughIndex)
+    {
+        KernelUpdate(Kernel->Committed, Series, sc.Index, Params.ATRLength);
+        Kernel->SweptThroughIndex = sc.Index;
+    }
 
-        if (tpNow > tpPrev)
-            posFlow += (tpNow * sc.Volume[idx]);
-        else if (tpNow < tpPrev)
-            negFlow += (tpNow * sc.Volume[idx]);
+    // In real time the checkpoint is also saved when a trading day starts,
+    // so a chart that is not closed cleanly resumes at most a day back. The
+    // kernel, VWAP, chop windows, trade and stats are all through the
+    // previous bar at this point, and the day saved is that bar's, so a
+    // resume starts this day again (cumulative delta, daily count, trade).
+    if (DayStarted && UseStateCheckpoint.GetYesNo() && !sc.IsFullRecalculation)
+    {
+        int StudyInts[] = { GetCheckpointDayDate(sc, *Kernel), DailyCount, LastTradeIndex };
+        SaveCheckpoint(sc, Params, *Kernel, *SessionVWAP, *Rolling, *Trade, Stats->Day, *Labels, StudyInts, 3);
     }
-    MFI[sc.Index] = (posFlow + negFlow > 0) ? 100.0f - (100.0f / (1.0f + (float)(posFlow / negFlow))) : 50.0f;
 
-    // Stoch
-    float HH = sc.GetHighest(sc.High, 14);
-    float LL = sc.GetLowest(sc.Low, 14);
-    StochK[sc.Index] = (HH - LL != 0) ? 100.0f * (sc.Close[sc.Index] - LL) / (HH - LL) : 0.0f;
+    // 1. Slope (percentage of price movement for cross-instrument compatibility)
+    float CurrentSlope = MomentumSlope(Series.Close, sc.Index);
+    PriceSlope[sc.Index] = CurrentSlope;
 
-    // Scoring
-    float cC = sc.Close[sc.Index];
-    bool pHigh = (cC > SMA100[sc.Index] && cC > EMA1000[sc.Index] && cC > VWAP[sc.Index]);
-    bool pLow  = (cC < SMA100[sc.Index] && cC < EMA1000[sc.Index] && cC < VWAP[sc.Index]);
+    // 2. Chop Detection + Slope Direction (shared lookback)
+    // Rolling counts over the last ChopLookback bars of PriceSlope. If the
+    // window cannot move by one bar (a recalculation stepped back), refill it.
+    if (Rolling->SmallSlope.Count > 0 && sc.Index != Rolling->SmallSlope.LastBarIndex
+        && sc.Index != Rolling->SmallSlope.LastBarIndex + 1)
+    {
+        int Lookback = Params.ChopLookback;
+        Rolling->Reset(Lookback);
 
-    int sPrice = pHigh ? 50 : (pLow ? 0 : 25);
-    int sRSI   = RSI[sc.Index] > 70 ? 25 : (RSI[sc.Index] < 30 ? 0 : 15);
+        int FirstIndex = (sc.Index - Lookback + 1 > 0) ? sc.Index - Lookback + 1 : 0;
+        for (int i = FirstIndex; i < sc.Index; i++)
+            PushSlope(*Rolling, i, PriceSlope[i]);
+    }
+    PushSlope(*Rolling, sc.Index, CurrentSlope);
 
-    float vP   = VWAP[sc.Index - 20];
-    float vm   = (vP > 0) ? ((VWAP[sc.Index] - vP) / vP) * 100.0f : 0.0f;
-    int sVW    = vm > 1 ? 25 : (vm < -1 ? 0 : 15);
+    s_MomentumChop Chop = MomentumChopState(*Rolling, Params);
+    ChopState[sc.Index] = Chop.IsChoppy ? 1.0f : 0.0f;  // 1.0 = True (Choppy), 0.0 = False
 
-    int sADX   = ADX[sc.Index] > 40 ? 20 : (ADX[sc.Index] > 25 ? 10 : 0);
-    int sStoch = StochK[sc.Index] > 80 ? 20 : (StochK[sc.Index] < 20 ? 0 : 12);
-    int sCCI   = CCI[sc.Index] > 100 ? 20 : (CCI[sc.Index] < -100 ? 0 : 12);
-    int sMFI   = MFI[sc.Index] > 80 ? 15 : (MFI[sc.Index] < 20 ? 0 : 10);
-    int sVol   = (ATR[sc.Index] > ATR20[sc.Index] * 1.5) ? 10 : 5;
-    int sDel   = (CumDelta[sc.Index] > CumDelta[sc.Index - 1]) ? 15 : 0;
+    // =========================================================================
+    // 7. INDICATORS & SCORING
+    // =========================================================================
 
-    int totalScore = sPrice + sRSI + sVW + sADX + sStoch + sCCI + sMFI + sVol + sDel;
+    bool DeltaRising = (CumDelta[sc.Index] > CumDelta[sc.Index - 1]);
+    int totalScore = MomentumScore(Series, &VWAP[0], sc.Index, DeltaRising);
     Score[sc.Index] = (float)totalScore;
 
     // =========================================================================
@@ -538,57 +995,13 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
     // =========================================================================
 
     // A. Check Virtual Exits
-    if (TradeDirection != 0)
+    if (Trade->Direction != 0)
     {
-        VisTarget[sc.Index] = (float)TargetPrice;
-        VisStop[sc.Index]   = (float)StopPrice;
-
-        bool Exit = false;
-
-        if (TradeDirection == 1) // Long
-        {
-            if (sc.Low[sc.Index] <= StopPrice)
-            {
-                Exit = true;
-            }
-            else if (sc.High[sc.Index] >= TargetPrice)
-            {
-                Exit = true;
-            }
-
-            // Trailing Stop
-            if (!Exit && (sc.Close[sc.Index] - EntryPrice) > (TrailTriggerATR.GetFloat() * ATR[sc.Index]))
-            {
-                float NewStop = sc.Close[sc.Index] - (TrailDistATR.GetFloat() * ATR[sc.Index]);
-                if (NewStop > StopPrice)
-                    StopPrice = NewStop;
-            }
-        }
-        else if (TradeDirection == -1) // Short
-        {
-            if (sc.High[sc.Index] >= StopPrice)
-            {
-                Exit = true;
-            }
-            else if (sc.Low[sc.Index] <= TargetPrice)
-            {
-                Exit = true;
-            }
-
-            // Trailing Stop
-            if (!Exit && (EntryPrice - sc.Close[sc.Index]) > (TrailTriggerATR.GetFloat() * ATR[sc.Index]))
-            {
-                float NewStop = sc.Close[sc.Index] + (TrailDistATR.GetFloat() * ATR[sc.Index]);
-                if (NewStop < StopPrice)
-                    StopPrice = NewStop;
-            }
-        }
+        VisTarget[sc.Index] = (float)Trade->TargetPrice;
+        VisStop[sc.Index]   = (float)Trade->StopPrice;
 
-        if (Exit)
-        {
-            TradeDirection = 0; // Trade Closed
-            LastExitIndex = sc.Index; // Mark exit bar for cooldown
-        }
+        double ExitPrice;
+        MomentumCheckExit(*Trade, Params, sc.High[sc.Index], sc.Low[sc.Index], sc.Close[sc.Index], ATR[sc.Index], sc.Index, ExitPrice);
     }
 
     // B. Sync with Real Trading (If Active)
@@ -597,26 +1010,17 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
 
     if (PosData.PositionQuantity != 0)
     {
-        TradeDirection = (PosData.PositionQuantity > 0) ? 1 : -1;
+        Trade->Direction = (PosData.PositionQuantity > 0) ? 1 : -1;
     }
 
     // =========================================================================
     // 9. LOGIC & SIGNALS
     // =========================================================================
 
-    // Log setup counts BEFORE early return (so it shows on weekends/non-closed bars)
-    bool IsLastBar = (sc.Index == sc.ArraySize - 1);
-    if (IsLastBar && EnableSetupLog.GetYesNo())
-    {
-        int TotalLong = SetupA_LongCount + SetupB_LongCount + SetupC_LongCount + SetupD_LongCount + SetupE_LongCount;
-        int TotalShort = SetupA_ShortCount + SetupB_ShortCount + SetupC_ShortCount + SetupD_ShortCount + SetupE_ShortCount;
-
-        SCString LogMsg;
-        LogMsg.Format("Setup Counts | Long: A=%d B=%d C=%d D=%d E=%d (Total=%d) | Short: A=%d B=%d C=%d D=%d E=%d (Total=%d)",
-            SetupA_LongCount, SetupB_LongCount, SetupC_LongCount, SetupD_LongCount, SetupE_LongCount, TotalLong,
-            SetupA_ShortCount, SetupB_ShortCount, SetupC_ShortCount, SetupD_ShortCount, SetupE_ShortCount, TotalShort);
-        sc.AddMessageToLog(LogMsg, 1);
-    }
+    // Labels follow the visible range. UpdateAlways brings the study back
+    // after scrolling, so the last bar is a once-per-update hook.
+    if (sc.Index == sc.ArraySize - 1)
+        RefreshSignalLabels(sc, *Labels);
 
     if (sc.GetBarHasClosedStatus() != BHCS_BAR_HAS_CLOSED) return;
 
@@ -626,253 +1030,90 @@ SCSFExport scsf_MomentumReversal(SCStudyInterfaceRef sc)
     bool SkipTradeBlock = sc.IsFullRecalculation && IsHistoricalBar;
 
     // *** BLOCKER: No signals if trade is active (skip during recalc of history) ***
-    if (!SkipTradeBlock && TradeDirection != 0) return;
+    bool Blocked = (!SkipTradeBlock && Trade->Direction != 0);
 
     // *** MINIMUM SPACING: Always enforce - prevents consecutive signals ***
-    if ((sc.Index - LastSignalIndex) < MinBarsBetweenTrades.GetInt()) return;
-
-    bool InRTH = true;
-    if (TradeRTHOnly.GetYesNo())
-    {
-        SCDateTime bt = sc.BaseDateTimeIn[sc.Index];
-        int m = bt.GetHour() * 60 + bt.GetMinute();
-        InRTH = (m >= 570 && m < 960);
-    }
-
-    bool CCIBuy  = CCI[sc.Index] > -100 && CCI[sc.Index-1] <= -100;
-    bool CCISell = CCI[sc.Index] < 100 && CCI[sc.Index-1] >= 100;
+    if ((sc.Index - Trade->LastSignalIndex) < Params.MinBarsBetweenTrades) Blocked = true;
 
-    bool AtBot20 = sc.Close[sc.Index] < Band_Bot_20[sc.Index];
-    bool AtTop20 = sc.Close[sc.Index] > Band_Top_20[sc.Index];
+    s_MomentumSignal Signal;
+    Signal.Direction = 0;
 
-    bool InShallowLongZone  = (sc.Low[sc.Index] <= Band_Bot_05) && (sc.Close[sc.Index] >= Band_Bot_20[sc.Index]);
-    bool InShallowShortZone = (sc.High[sc.Index] >= Band_Top_05) && (sc.Close[sc.Index] <= Band_Top_20[sc.Index]);
-
-    bool CandleBullish      = sc.Close[sc.Index] > sc.Open[sc.Index-1];
-    bool CandleBearish      = sc.Close[sc.Index] < sc.Open[sc.Index-1];
-    bool TouchedSMA         = (sc.Low[sc.Index] <= SMA100[sc.Index] && sc.High[sc.Index] >= SMA100[sc.Index]);
-
-    float Highest5          = sc.GetHighest(sc.High, 5, sc.Index - 1);
-    float Lowest5           = sc.GetLowest(sc.Low, 5, sc.Index - 1);
-
-    // --- SETUP A: MOMENTUM ---
-    bool SetupA_Long  = (totalScore < 70 && CCIBuy);
-    if (IsChoppy || StrongDown || IsExtremeDown) SetupA_Long = false;
-
-    bool SetupA_Short = (totalScore > 130 && totalScore < 190 && CCISell);
-    if (IsChoppy || StrongUp || IsExtremeUp)     SetupA_Short = false;
-
-    // --- SETUP B: EXTREME REVERSION (2.0 SD) ---
-    float GateVal = SetupBSlopeGate.GetFloat();
-    bool SetupB_Long  = AtBot20 && CandleBullish && (CurrentSlope > GateVal);
-    bool SetupB_Short = AtTop20 && CandleBearish && (CurrentSlope < -GateVal);
-
-    // --- SETUP C: TREND PULLBACK ---
-    // Simplified: Just touch EMA50 or SMA100 in a trend with correct candle
-    bool SetupC_Long = false;
-    bool TouchedMA = TouchedSMA || (sc.Low[sc.Index] <= EMA50[sc.Index] && sc.High[sc.Index] >= EMA50[sc.Index]);
-    if (!IsChoppy && MajorityPositive && TouchedMA && CandleBullish)
+    if (!Blocked)
     {
-        SetupC_Long = true;
-    }
+        // Setups A-E and the RTH, structural, slope and slope direction filters
+        // live in momentum_bot_core.h, shared with the offline backtester
+        SCDateTime BarTime = sc.BaseDateTimeIn[sc.Index];
+        int MinuteOfDay = BarTime.GetHour() * 60 + BarTime.GetMinute();
 
-    bool SetupC_Short = false;
-    if (!IsChoppy && MajorityNegative && TouchedMA && CandleBearish)
-    {
-        SetupC_Short = true;
-    }
+        s_MomentumBarContext Bar;
+        MomentumBuildContext(Bar, Series, &sc.Open[0], &VWAP[0], StdDev, CurrentSlope, totalScore, Chop, sc.Index, MinuteOfDay);
 
-    // --- SETUP D: EXTREME BREAKOUT ---
-    bool SetupD_Long = false;
-    if (!IsChoppy && IsExtremeUp && sc.Close[sc.Index] > EMA50[sc.Index] && sc.Close[sc.Index] > Highest5)
-    {
-        SetupD_Long = true;
-    }
-
-    bool SetupD_Short = false;
-    if (!IsChoppy && IsExtremeDown && sc.Close[sc.Index] < EMA50[sc.Index] && sc.Close[sc.Index] < Lowest5)
-    {
-        SetupD_Short = true;
-    }
-
-    // --- SETUP E: TREND CONTINUATION (Sell the Rally / Buy the Dip) ---
-    // Catches entries when price rallies to key resistance/support in trends
-    bool SetupE_Long = false;
-    bool SetupE_Short = false;
-
-    // Short: In downtrend, price rallied to resistance (EMA50/SMA100/VWAP-1SD), bearish candle
-    bool TouchedResistance = (sc.High[sc.Index] >= EMA50[sc.Index]) ||
-                              (sc.High[sc.Index] >= SMA100[sc.Index]) ||
-                              (sc.High[sc.Index] >= Band_Bot_10);  // VWAP -1SD as resistance in downtrend
-
-    // Use MajorityNegative (50%+ negative slopes) instead of StrongDown for easier triggering
-    if (!IsChoppy && MajorityNegative && TouchedResistance && CandleBearish)
-    {
-        SetupE_Short = true;
+        Signal = MomentumEvaluateSignal(Bar, Params);
     }
 
-    // Long: In uptrend, price dipped to support (EMA50/SMA100/VWAP+1SD), bullish candle
-    bool TouchedSupport = (sc.Low[sc.Index] <= EMA50[sc.Index]) ||
-                          (sc.Low[sc.Index] <= SMA100[sc.Index]) ||
-                          (sc.Low[sc.Index] <= Band_Top_10);  // VWAP +1SD as support in uptrend
-
-    // Use MajorityPositive (50%+ positive slopes) instead of StrongUp for easier triggering
-    if (!IsChoppy && MajorityPositive && TouchedSupport && CandleBullish)
-    {
-        SetupE_Long = true;
-    }
-
-    // --- TRIGGERS ---
-    bool DoLong  = InRTH && (SetupA_Long || SetupB_Long || SetupC_Long || SetupD_Long || SetupE_Long);
-    if (IsExtremeDown && !SetupD_Long) DoLong = false;
-
-    bool DoShort = InRTH && (SetupA_Short || SetupB_Short || SetupC_Short || SetupD_Short || SetupE_Short);
-    if (IsExtremeUp && !SetupD_Short) DoShort = false;
-
-    // --- STRUCTURAL FILTERS: Block counter-trend trades (EXCEPT Setup A mean-reversion) ---
-    // No longs when clearly in downtrend structure (below VWAP AND below SMA100)
-    bool DowntrendStructure = (sc.Close[sc.Index] < VWAP[sc.Index] && sc.Close[sc.Index] < SMA100[sc.Index]);
-    if (DowntrendStructure && !SetupA_Long) DoLong = false;
-
-    // No shorts when clearly in uptrend structure (above VWAP AND above SMA100)
-    bool UptrendStructure = (sc.Close[sc.Index] > VWAP[sc.Index] && sc.Close[sc.Index] > SMA100[sc.Index]);
-    if (UptrendStructure && !SetupA_Short) DoShort = false;
-
-    // --- SLOPE FILTERS: Block counter-trend trades (EXCEPT Setup A and D) ---
-    // No longs when slope is strongly negative (except Setup A and D)
-    if (StrongDown && !SetupD_Long && !SetupA_Long) DoLong = false;
-
-    // No shorts when slope is strongly positive (except Setup A and D)
-    if (StrongUp && !SetupD_Short && !SetupA_Short) DoShort = false;
+    // --- Stats ---
+    // Counted once per closed bar. The writer thread formats and writes a
+    // row when a day ends; the day in progress is written on the last call.
+    s_MomentumStatsRow StatsRow;
+    if (Stats->Day.AddBar(sc.Index, LastDayDate, CurrentSlope, StatsRow))
+        Stats->Writer.Push(StatsRow);
+    if (Signal.Direction != 0)
+        Stats->Day.AddSignal(Signal.Direction, Signal.Setup);
 
-    // --- SLOPE DIRECTION FILTER: 50%+ of last 20 bars (EXCEPT Setup A) ---
-    // No longs when majority of recent bars have negative slope
-    if (MajorityNegative && !SetupA_Long) DoLong = false;
-
-    // No shorts when majority of recent bars have positive slope
-    if (MajorityPositive && !SetupA_Short) DoShort = false;
-
-    // Target Selection Logic
-    float SlopeMag = (CurrentSlope > 0) ? CurrentSlope : -CurrentSlope;
-    float UsedMult = (SlopeMag > MinSlopeThreshold.GetFloat())
-        ? ExtTargetATRMult.GetFloat()
-        : TargetATRMult.GetFloat();
+    if (Blocked) return;
 
     // =========================================================================
     // 10. EXECUTION & SIGNAL GENERATION
     // =========================================================================
 
-
-    if (DoLong)
+    if (Signal.Direction == 0)
     {
-        // Determine which setup triggered
-        SCString SetupLabel = "";
-        if (SetupA_Long) { SetupLabel = "A"; SetupA_LongCount++; }
-        else if (SetupB_Long) { SetupLabel = "B"; SetupB_LongCount++; }
-        else if (SetupC_Long) { SetupLabel = "C"; SetupC_LongCount++; }
-        else if (SetupD_Long) { SetupLabel = "D"; SetupD_LongCount++; }
-        else if (SetupE_Long) { SetupLabel = "E"; SetupE_LongCount++; }
-
-        // 1. Paint Signal & Mark
-        LongSignal[sc.Index] = sc.Low[sc.Index] - (ATR[sc.Index] * 0.5f);
-        LastSignalIndex = sc.Index;
-
-        // Add setup label text
-        s_UseTool Tool;
-        Tool.Clear();
-        Tool.ChartNumber = sc.ChartNumber;
-        Tool.DrawingType = DRAWING_TEXT;
-        Tool.LineNumber = sc.Index + 100000;
-        Tool.BeginDateTime = sc.BaseDateTimeIn[sc.Index];
-        Tool.BeginValue = sc.Low[sc.Index] - (ATR[sc.Index] * 1.2f);
-        Tool.Text = SetupLabel;
-        Tool.Color = RGB(0, 200, 0);
-        Tool.FontBold = true;
-        Tool.FontSize = 12;
-        Tool.TextAlignment = DT_CENTER | DT_VCENTER;
-        Tool.AddMethod = UTAM_ADD_OR_ADJUST;
-        sc.UseTool(Tool);
-
-        // 2. Set Trade State
-        TradeDirection  = 1;
-        EntryPrice      = sc.Close[sc.Index];
-        StopPrice       = sc.Close[sc.Index] * (1.0f - (HardStopPercent.GetFloat() / 100.0f));
-        TargetPrice     = sc.Close[sc.Index] + (UsedMult * ATR[sc.Index]);
-
-        // 3. Real Execution
-        if (DailyCount < MaxDailyTrades.GetInt() && sc.SendOrdersToTradeService)
-        {
-            s_SCNewOrder Order;
-            Order.OrderQuantity          = ContractsPerTrade.GetInt();
-            Order.OrderType              = SCT_ORDERTYPE_MARKET;
-            Order.TimeInForce            = SCT_TIF_GOOD_TILL_CANCELED;
-            Order.Stop1Offset            = sc.Close[sc.Index] * (HardStopPercent.GetFloat() / 100.0f);
-            Order.Target1Offset          = UsedMult * ATR[sc.Index];
-            Order.AttachedOrderTarget1Type = SCT_ORDERTYPE_LIMIT;
-            Order.AttachedOrderStop1Type   = SCT_ORDERTYPE_STOP;
-
-            if (sc.BuyEntry(Order) > 0)
-            {
-                DailyCount++;
-                LastTradeIndex = sc.Index;
-            }
-        }
+        DailyTrades[sc.Index] = (float)DailyCount;
+        return;
     }
-    else if (DoShort)
-    {
-        // Determine which setup triggered
-        SCString SetupLabel = "";
-        if (SetupA_Short) { SetupLabel = "A"; SetupA_ShortCount++; }
-        else if (SetupB_Short) { SetupLabel = "B"; SetupB_ShortCount++; }
-        else if (SetupC_Short) { SetupLabel = "C"; SetupC_ShortCount++; }
-        else if (SetupD_Short) { SetupLabel = "D"; SetupD_ShortCount++; }
-        else if (SetupE_Short) { SetupLabel = "E"; SetupE_ShortCount++; }
 
-        // 1. Paint Signal & Mark
+    bool IsLong = (Signal.Direction == 1);
+    float UsedMult = Signal.TargetMult;
+
+    // 1. Paint Signal & Mark
+    if (IsLong)
+        LongSignal[sc.Index] = sc.Low[sc.Index] - (ATR[sc.Index] * 0.5f);
+    else
         ShortSignal[sc.Index] = sc.High[sc.Index] + (ATR[sc.Index] * 0.5f);
-        LastSignalIndex = sc.Index;
 
-        // Add setup label text
-        s_UseTool Tool;
-        Tool.Clear();
-        Tool.ChartNumber = sc.ChartNumber;
-        Tool.DrawingType = DRAWING_TEXT;
-        Tool.LineNumber = sc.Index + 200000;
-        Tool.BeginDateTime = sc.BaseDateTimeIn[sc.Index];
-        Tool.BeginValue = sc.High[sc.Index] + (ATR[sc.Index] * 1.2f);
-        Tool.Text = SetupLabel;
-        Tool.Color = RGB(255, 50, 50);
-        Tool.FontBold = true;
-        Tool.FontSize = 12;
-        Tool.TextAlignment = DT_CENTER | DT_VCENTER;
-        Tool.AddMethod = UTAM_ADD_OR_ADJUST;
-        sc.UseTool(Tool);
+    // Record the setup label; RefreshSignalLabels draws it when it is near the visible bars
+    s_MomentumSignalLabel Label;
+    Label.Index = sc.Index;
+    Label.Direction = Signal.Direction;
+    Label.Setup = Signal.Setup;
+    Label.Price = IsLong ? sc.Low[sc.Index] - (ATR[sc.Index] * 1.2f) : sc.High[sc.Index] + (ATR[sc.Index] * 1.2f);
+    Labels->Add(Label);
 
-        // 2. Set Trade State
-        TradeDirection  = -1;
-        EntryPrice      = sc.Close[sc.Index];
-        StopPrice       = sc.Close[sc.Index] * (1.0f + (HardStopPercent.GetFloat() / 100.0f));
-        TargetPrice     = sc.Close[sc.Index] - (UsedMult * ATR[sc.Index]);
+    if (sc.Index == sc.ArraySize - 1)
+        RefreshSignalLabels(sc, *Labels);
 
-        // 3. Real Execution
-        if (DailyCount < MaxDailyTrades.GetInt() && sc.SendOrdersToTradeService)
+    // 2. Set Trade State
+    MomentumOpenTrade(*Trade, Signal, sc.Close[sc.Index], ATR[sc.Index], Params, sc.Index);
+
+    // 3. Real Execution
+    if (DailyCount < MaxDailyTrades.GetInt() && sc.SendOrdersToTradeService)
+    {
+        s_SCNewOrder Order;
+        Order.OrderQuantity          = ContractsPerTrade.GetInt();
+        Order.OrderType              = SCT_ORDERTYPE_MARKET;
+        Order.TimeInForce            = SCT_TIF_GOOD_TILL_CANCELED;
+        Order.Stop1Offset            = sc.Close[sc.Index] * (Params.HardStopPercent / 100.0f);
+        Order.Target1Offset          = UsedMult * ATR[sc.Index];
+        Order.AttachedOrderTarget1Type = SCT_ORDERTYPE_LIMIT;
+        Order.AttachedOrderStop1Type   = SCT_ORDERTYPE_STOP;
+
+        int Result = IsLong ? sc.BuyEntry(Order) : sc.SellEntry(Order);
+        if (Result > 0)
         {
-            s_SCNewOrder Order;
-            Order.OrderQuantity          = ContractsPerTrade.GetInt();
-            Order.OrderType              = SCT_ORDERTYPE_MARKET;
-            Order.TimeInForce            = SCT_TIF_GOOD_TILL_CANCELED;
-            Order.Stop1Offset            = sc.Close[sc.Index] * (HardStopPercent.GetFloat() / 100.0f);
-            Order.Target1Offset          = UsedMult * ATR[sc.Index];
-            Order.AttachedOrderTarget1Type = SCT_ORDERTYPE_LIMIT;
-            Order.AttachedOrderStop1Type   = SCT_ORDERTYPE_STOP;
-
-            if (sc.SellEntry(Order) > 0)
-            {
-                DailyCount++;
-                LastTradeIndex = sc.Index;
-            }
+            DailyCount++;
+            LastTradeIndex = sc.Index;
         }
     }
 
     DailyTrades[sc.Index] = (float)DailyCount;
-}
\ No newline at end of file
+}
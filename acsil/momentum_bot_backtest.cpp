@@ -0,0 +1,440 @@
+/*
+    XYL Momentum Bot - offline backtester
+
+    Replays Sierra Chart bar data through momentum_bot_core.h, the same
+    signal and virtual trade logic the study runs, without Sierra Chart.
+    Not a study: build it as a normal command line program.
+
+        g++ -O2 -std=c++17 -pthread -o momentum_bot_backtest momentum_bot_backtest.cpp
+
+    Input is a bar file exported with Edit >> Export Bar Data to Text File:
+
+        Date, Time, Open, High, Low, Last, Volume, NumberOfTrades, BidVolume, AskVolume
+
+    Usage:
+
+        momentum_bot_backtest [options] bars.txt
+
+        --session-start HH:MM   Trading day start. Bars at or after this time
+                                belong to the next trading day (evening
+                                sessions). Default 00:00.
+        --param Name=Value      Override an input, using the study's input
+                                variable names (e.g. --param ChopLookback=30).
+        --chart-mode            Do not block signals while a virtual trade is
+                                open, like the chart does when it recalculates
+                                history. Default is live behavior.
+        --no-trades             Print only the summary.
+
+    Sweep mode (any --sweep given) prints a ranked report instead of trades:
+
+        --sweep Name=Min:Max[:Step]
+                                Sweep an input. Repeat for more inputs. Without
+                                --random every combination is run.
+        --random N              Run N sets drawn at random from the ranges.
+        --seed N                Random seed. Default 1.
+        --threads N             Worker threads. Default: all cores.
+        --top N                 Rows in the report. Default 20, 0 = all.
+
+    Walk-forward mode optimizes the --sweep sets on rolling in-sample slices
+    and scores each winner on the slice that follows:
+
+        --walk-forward IN:OUT   In-sample and out-of-sample lengths in
+                                trading days. Prints one row per window.
+*/
+
+#include "momentum_bot_core.h"
+#include "momentum_bot_sweep.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int DaysFromCivil(int Year, int Month, int Day)
+{
+    Year -= Month <= 2;
+    int Era = (Year >= 0 ? Year : Year - 399) / 400;
+    int YearOfEra = Year - Era * 400;
+    int DayOfYear = (153 * (Month + (Month > 2 ? -3 : 9)) + 2) / 5 + Day - 1;
+    int DayOfEra = YearOfEra * 365 + YearOfEra / 4 - YearOfEra / 100 + DayOfYear;
+    return Era * 146097 + DayOfEra - 719468;
+}
+
+static bool ParseHHMM(const char* Text, int& Minutes)
+{
+    int Hour = 0, Minute = 0;
+    if (sscanf(Text, "%d:%d", &Hour, &Minute) != 2 || Hour < 0 || Hour > 23 || Minute < 0 || Minute > 59)
+        return false;
+
+    Minutes = Hour * 60 + Minute;
+    return true;
+}
+
+// Reads a Sierra Chart bar export. Returns false if the file can't be opened.
+static bool LoadBars(const char* Path, int SessionStartMinute, s_MomentumBars& Bars)
+{
+    FILE* File = fopen(Path, "r");
+    if (File == NULL)
+        return false;
+
+    char Line[512];
+    while (fgets(Line, sizeof(Line), File) != NULL)
+    {
+        int Year, Month, Day, Hour, Minute;
+        double Second;
+        float Open, High, Low, Last, Volume, NumTrades, BidVolume, AskVolume;
+
+        // The header line and anything malformed fail to parse and are skipped
+        int Fields = sscanf(Line, "%d/%d/%d , %d:%d:%lf , %f , %f , %f , %f , %f , %f , %f , %f",
+            &Year, &Month, &Day, &Hour, &Minute, &Second,
+            &Open, &High, &Low, &Last, &Volume, &NumTrades, &BidVolume, &AskVolume);
+        if (Fields != 14)
+            continue;
+
+        int DayNumber = DaysFromCivil(Year, Month, Day);
+        int MinuteOfDay = Hour * 60 + Minute;
+
+        int TradingDate = DayNumber;
+        if (SessionStartMinute > 0 && MinuteOfDay >= SessionStartMinute)
+            TradingDate++;
+
+        Bars.TradingDate.push_back(TradingDate);
+        Bars.MinuteOfDay.push_back(MinuteOfDay);
+        Bars.DateTime.push_back(DayNumber + (MinuteOfDay * 60 + Second) / 86400.0);
+        Bars.Open.push_back(Open);
+        Bars.High.push_back(High);
+        Bars.Low.push_back(Low);
+        Bars.Close.push_back(Last);
+        Bars.Volume.push_back(Volume);
+        Bars.BidVolume.push_back(BidVolume);
+        Bars.AskVolume.push_back(AskVolume);
+    }
+
+    fclose(File);
+    return true;
+}
+
+static void FormatDateTime(double DateTime, char* Buffer, size_t Size)
+{
+    // Inverse of DaysFromCivil
+    int Z = (int)floor(DateTime) + 719468;
+    int Era = (Z >= 0 ? Z : Z - 146096) / 146097;
+    int DayOfEra = Z - Era * 146097;
+    int YearOfEra = (DayOfEra - DayOfEra / 1460 + DayOfEra / 36524 - DayOfEra / 146096) / 365;
+    int DayOfYear = DayOfEra - (365 * YearOfEra + YearOfEra / 4 - YearOfEra / 100);
+    int MP = (5 * DayOfYear + 2) / 153;
+    int Day = DayOfYear - (153 * MP + 2) / 5 + 1;
+    int Month = MP + (MP < 10 ? 3 : -9);
+    int Year = YearOfEra + Era * 400 + (Month <= 2);
+
+    int Seconds = (int)floor((DateTime - floor(DateTime)) * 86400.0 + 0.5);
+    snprintf(Buffer, Size, "%04d-%02d-%02d %02d:%02d:%02d", Year, Month, Day, Seconds / 3600, (Seconds / 60) % 60, Seconds % 60);
+}
+
+// Name=Min:Max[:Step]
+static bool ParseSweepRange(const char* Text, s_MomentumSweepRange& Range)
+{
+    std::string Spec = Text;
+    size_t Equals = Spec.find('=');
+    if (Equals == std::string::npos)
+        return false;
+
+    Range.Field = MomentumFindParam(Spec.substr(0, Equals).c_str());
+    if (Range.Field == NULL)
+        return false;
+
+    Range.Step = 0;
+    int Fields = sscanf(Spec.c_str() + Equals + 1, "%lf:%lf:%lf", &Range.Min, &Range.Max, &Range.Step);
+    return Fields >= 2 && Range.Max >= Range.Min;
+}
+
+static void PrintSweepReport(const std::vector<s_MomentumParams>& Sets, const std::vector<s_MomentumSweepRange>& Ranges,
+    const std::vector<s_MomentumSweepResult>& Ranked, int Top)
+{
+    printf("Rank,NetPnL,MaxDrawdown,Trades,WinPct,LongA,LongB,LongC,LongD,LongE,ShortA,ShortB,ShortC,ShortD,ShortE");
+    for (size_t r = 0; r < Ranges.size(); r++)
+        printf(",%s", Ranges[r].Field->Name);
+    printf("\n");
+
+    int Rows = (Top > 0 && Top < (int)Ranked.size()) ? Top : (int)Ranked.size();
+    for (int n = 0; n < Rows; n++)
+    {
+        const s_MomentumBacktestResult& R = Ranked[n].Result;
+        int NumTrades = R.Wins + R.Losses;
+
+        printf("%d,%.4f,%.4f,%d,%.1f", n + 1, R.NetPnL, R.MaxDrawdown, NumTrades, NumTrades > 0 ? R.Wins * 100.0 / NumTrades : 0.0);
+        for (int d = 0; d < 2; d++)
+        {
+            for (int k = 0; k < NUM_MOMENTUM_SETUPS; k++)
+                printf(",%d", R.SetupCounts[d][k]);
+        }
+        for (size_t r = 0; r < Ranges.size(); r++)
+            printf(",%g", MomentumGetParam(Sets[Ranked[n].SetIndex], *Ranges[r].Field));
+        printf("\n");
+    }
+}
+
+static void PrintWalkForwardReport(const s_MomentumBars& Bars, const std::vector<s_MomentumParams>& Sets,
+    const std::vector<s_MomentumSweepRange>& Ranges, const std::vector<s_MomentumWalkForwardWindow>& Windows)
+{
+    printf("Window,InStart,OutStart,OutEnd,InPnL,InDrawdown,OutPnL,OutDrawdown,OutTrades");
+    for (size_t r = 0; r < Ranges.size(); r++)
+        printf(",%s", Ranges[r].Field->Name);
+    printf("\n");
+
+    double Equity = 0.0, Peak = 0.0, Drawdown = 0.0;
+    int Trades = 0;
+
+    for (size_t w = 0; w < Windows.size(); w++)
+    {
+        const s_MomentumWalkForwardWindow& W = Windows[w];
+        char InStart[64], OutStart[64], OutEnd[64];
+        FormatDateTime(Bars.DateTime[W.InBegin], InStart, sizeof(InStart));
+        FormatDateTime(Bars.DateTime[W.OutBegin], OutStart, sizeof(OutStart));
+        FormatDateTime(Bars.DateTime[W.OutEnd - 1], OutEnd, sizeof(OutEnd));
+
+        printf("%d,%s,%s,%s,%.4f,%.4f,%.4f,%.4f,%d", (int)w + 1, InStart, OutStart, OutEnd,
+            W.InSample.NetPnL, W.InSample.MaxDrawdown, W.OutOfSample.NetPnL, W.OutOfSample.MaxDrawdown,
+            W.OutOfSample.Wins + W.OutOfSample.Losses);
+        for (size_t r = 0; r < Ranges.size(); r++)
+            printf(",%g", MomentumGetParam(Sets[W.BestSet], *Ranges[r].Field));
+        printf("\n");
+
+        // Out-of-sample slices stitched into one equity curve
+        for (size_t t = 0; t < W.OutOfSample.Trades.size(); t++)
+        {
+            Equity += W.OutOfSample.Trades[t].PnL;
+            if (Equity > Peak) Peak = Equity;
+            if (Peak - Equity > Drawdown) Drawdown = Peak - Equity;
+            Trades++;
+        }
+    }
+
+    fprintf(stderr, "Walk-forward: Windows=%d OutOfSamplePnL=%.4f OutOfSampleMaxDrawdown=%.4f OutOfSampleTrades=%d\n",
+        (int)Windows.size(), Equity, Drawdown, Trades);
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "usage: momentum_bot_backtest [--session-start HH:MM] [--param Name=Value]... [--chart-mode] [--no-trades]\n");
+    fprintf(stderr, "           [--sweep Name=Min:Max[:Step]]... [--random N] [--seed N] [--threads N] [--top N]\n");
+    fprintf(stderr, "           [--walk-forward IN:OUT] bars.txt\n");
+    fprintf(stderr, "inputs:");
+    for (int i = 0; i < NUM_MOMENTUM_PARAM_FIELDS; i++)
+        fprintf(stderr, " %s", MOMENTUM_PARAM_FIELDS[i].Name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char** argv)
+{
+    s_MomentumParams Params;
+    Params.SetDefaults();
+
+    int SessionStartMinute = 0;
+    bool ChartMode = false;
+    bool PrintTrades = true;
+    const char* Path = NULL;
+
+    std::vector<s_MomentumSweepRange> Ranges;
+    int RandomCount = 0;
+    unsigned Seed = 1;
+    int NumThreads = (int)std::thread::hardware_concurrency();
+    int Top = 20;
+    int InDays = 0, OutDays = 0;
+
+    for (int a = 1; a < argc; a++)
+    {
+        std::string Arg = argv[a];
+
+        if (Arg == "--session-start" && a + 1 < argc)
+        {
+            if (!ParseHHMM(argv[++a], SessionStartMinute))
+            {
+                fprintf(stderr, "bad session start time: %s\n", argv[a]);
+                return 1;
+            }
+        }
+        else if (Arg == "--param" && a + 1 < argc)
+        {
+            std::string Assignment = argv[++a];
+            size_t Equals = Assignment.find('=');
+            const s_MomentumParamField* Field = (Equals == std::string::npos) ? NULL : MomentumFindParam(Assignment.substr(0, Equals).c_str());
+            if (Field == NULL)
+            {
+                fprintf(stderr, "unknown input: %s\n", Assignment.c_str());
+                PrintUsage();
+                return 1;
+            }
+            MomentumSetParam(Params, *Field, atof(Assignment.c_str() + Equals + 1));
+        }
+        else if (Arg == "--sweep" && a + 1 < argc)
+        {
+            s_MomentumSweepRange Range;
+            if (!ParseSweepRange(argv[++a], Range))
+            {
+                fprintf(stderr, "bad sweep range: %s\n", argv[a]);
+                PrintUsage();
+                return 1;
+            }
+            Ranges.push_back(Range);
+        }
+        else if (Arg == "--walk-forward" && a + 1 < argc)
+        {
+            if (sscanf(argv[++a], "%d:%d", &InDays, &OutDays) != 2 || InDays < 1 || OutDays < 1)
+            {
+                fprintf(stderr, "bad walk-forward windows: %s\n", argv[a]);
+                return 1;
+            }
+        }
+        else if (Arg == "--random" && a + 1 < argc)
+            RandomCount = atoi(argv[++a]);
+        else if (Arg == "--seed" && a + 1 < argc)
+            Seed = (unsigned)strtoul(argv[++a], NULL, 10);
+        else if (Arg == "--threads" && a + 1 < argc)
+            NumThreads = atoi(argv[++a]);
+        else if (Arg == "--top" && a + 1 < argc)
+            Top = atoi(argv[++a]);
+        else if (Arg == "--chart-mode")
+            ChartMode = true;
+        else if (Arg == "--no-trades")
+            PrintTrades = false;
+        else if (Arg[0] != '-' && Path == NULL)
+            Path = argv[a];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (Path == NULL)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (NumThreads < 1)
+        NumThreads = 1;
+
+    if (InDays > 0 && Ranges.empty())
+    {
+        fprintf(stderr, "--walk-forward needs at least one --sweep range\n");
+        return 1;
+    }
+
+    if (Params.ATRLength < 1 || Params.ChopLookback < 1)
+    {
+        fprintf(stderr, "ATRLength and ChopLookback must be at least 1\n");
+        return 1;
+    }
+
+    std::chrono::steady_clock::time_point LoadStart = std::chrono::steady_clock::now();
+
+    s_MomentumBars Bars;
+    if (!LoadBars(Path, SessionStartMinute, Bars))
+    {
+        fprintf(stderr, "can't open %s\n", Path);
+        return 1;
+    }
+    if (Bars.Size() == 0)
+    {
+        fprintf(stderr, "no bars in %s\n", Path);
+        return 1;
+    }
+
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+    std::chrono::steady_clock::time_point FeatureStart = std::chrono::steady_clock::now();
+
+    if (!Ranges.empty())
+    {
+        std::vector<s_MomentumParams> Sets;
+        if (RandomCount > 0)
+            MomentumBuildRandom(Params, Ranges, RandomCount, Seed, Sets);
+        else
+            MomentumBuildGrid(Params, Ranges, Sets);
+
+        for (size_t n = 0; n < Sets.size(); n++)
+        {
+            if (Sets[n].ATRLength < 1 || Sets[n].ChopLookback < 1)
+            {
+                fprintf(stderr, "ATRLength and ChopLookback must be at least 1\n");
+                return 1;
+            }
+        }
+
+        s_MomentumFeatureSet FeatureSet;
+        FeatureSet.Build(Bars, Sets, NumThreads);
+
+        std::chrono::steady_clock::time_point SweepStart = std::chrono::steady_clock::now();
+
+        if (InDays > 0)
+        {
+            std::vector<s_MomentumWalkForwardWindow> Windows;
+            MomentumWalkForward(Bars, FeatureSet, Sets, InDays, OutDays, ChartMode, NumThreads, Windows);
+
+            std::chrono::steady_clock::time_point WalkEnd = std::chrono::steady_clock::now();
+
+            PrintWalkForwardReport(Bars, Sets, Ranges, Windows);
+
+            fprintf(stderr, "Bars=%d Sets=%d ATRLengths=%d Threads=%d (%s mode)\n", Bars.Size(), (int)Sets.size(),
+                (int)FeatureSet.ByATRLength.size(), NumThreads, ChartMode ? "chart" : "live");
+            fprintf(stderr, "Timing: load %.1f ms, features %.1f ms, walk-forward %.1f ms\n",
+                Milliseconds(FeatureStart - LoadStart).count(), Milliseconds(SweepStart - FeatureStart).count(),
+                Milliseconds(WalkEnd - SweepStart).count());
+            return 0;
+        }
+
+        std::vector<s_MomentumSweepResult> Results;
+        MomentumRunSweep(Bars, FeatureSet, Sets, 0, Bars.Size(), ChartMode, NumThreads, Results);
+        MomentumRankSweep(Results);
+
+        std::chrono::steady_clock::time_point SweepEnd = std::chrono::steady_clock::now();
+
+        PrintSweepReport(Sets, Ranges, Results, Top);
+
+        fprintf(stderr, "Bars=%d Sets=%d ATRLengths=%d Threads=%d (%s mode)\n", Bars.Size(), (int)Sets.size(),
+            (int)FeatureSet.ByATRLength.size(), NumThreads, ChartMode ? "chart" : "live");
+        fprintf(stderr, "Timing: load %.1f ms, features %.1f ms, sweep %.1f ms (%.3f ms per set)\n",
+            Milliseconds(FeatureStart - LoadStart).count(), Milliseconds(SweepStart - FeatureStart).count(),
+            Milliseconds(SweepEnd - SweepStart).count(), Milliseconds(SweepEnd - SweepStart).count() / (Sets.empty() ? 1 : Sets.size()));
+        return 0;
+    }
+
+    s_MomentumFeatures Features;
+    MomentumBuildFeatures(Bars, Params.ATRLength, Features);
+
+    std::chrono::steady_clock::time_point ReplayStart = std::chrono::steady_clock::now();
+
+    s_MomentumBacktestResult Result;
+    MomentumRunBacktest(Bars, Features, Params, 0, Bars.Size(), ChartMode, PrintTrades, Result);
+
+    std::chrono::steady_clock::time_point End = std::chrono::steady_clock::now();
+
+    if (PrintTrades)
+    {
+        printf("EntryTime,ExitTime,Direction,Setup,EntryPrice,ExitPrice,PnL,ExitReason\n");
+        for (size_t t = 0; t < Result.Trades.size(); t++)
+        {
+            const s_MomentumTradeResult& R = Result.Trades[t];
+            char EntryTime[64], ExitTime[64];
+            FormatDateTime(Bars.DateTime[R.EntryIndex], EntryTime, sizeof(EntryTime));
+            FormatDateTime(Bars.DateTime[R.ExitIndex], ExitTime, sizeof(ExitTime));
+
+            printf("%s,%s,%s,%s,%.6g,%.6g,%.6g,%s\n", EntryTime, ExitTime, R.Direction == 1 ? "Long" : "Short",
+                MOMENTUM_SETUP_LABELS[R.Setup], R.EntryPrice, R.ExitPrice, R.PnL, MOMENTUM_EXIT_REASON_NAMES[R.ExitReason]);
+        }
+    }
+
+    int NumTrades = Result.Wins + Result.Losses;
+    fprintf(stderr, "Bars=%d Trades=%d Wins=%d Losses=%d NetPnL=%.4f MaxDrawdown=%.4f (%s mode)\n",
+        Bars.Size(), NumTrades, Result.Wins, Result.Losses, Result.NetPnL, Result.MaxDrawdown, ChartMode ? "chart" : "live");
+    fprintf(stderr, "Setup Counts | Long: A=%d B=%d C=%d D=%d E=%d | Short: A=%d B=%d C=%d D=%d E=%d\n",
+        Result.SetupCounts[0][SETUP_A], Result.SetupCounts[0][SETUP_B], Result.SetupCounts[0][SETUP_C], Result.SetupCounts[0][SETUP_D], Result.SetupCounts[0][SETUP_E],
+        Result.SetupCounts[1][SETUP_A], Result.SetupCounts[1][SETUP_B], Result.SetupCounts[1][SETUP_C], Result.SetupCounts[1][SETUP_D], Result.SetupCounts[1][SETUP_E]);
+    fprintf(stderr, "Timing: load %.1f ms, features %.1f ms, replay %.1f ms\n",
+        Milliseconds(FeatureStart - LoadStart).count(), Milliseconds(ReplayStart - FeatureStart).count(), Milliseconds(End - ReplayStart).count());
+
+    return 0;
+}
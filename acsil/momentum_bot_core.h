@@ -0,0 +1,1499 @@
+#ifndef MOMENTUM_BOT_CORE_H
+#define MOMENTUM_BOT_CORE_H
+
+/*
+    Platform independent core of the XYL Momentum Bot.
+
+    Everything the study needs to turn bar data into signals and virtual
+    trades, with no dependency on sierrachart.h: the session VWAP
+    accumulator, the rolling chop windows, the fused indicator kernel,
+    setups A-E with their filters, and the virtual trade state machine
+    (stop, target, trailing stop, signal spacing).
+
+    momentum_bot.cpp feeds it from the chart; momentum_bot_backtest.cpp
+    feeds it from bar files on Linux. Both must produce the same signals
+    for the same bars and inputs, so logic changes belong here.
+*/
+
+#include "session_vwap.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Fixed capacity rolling window over the most recent bars. Keeps the sum of
+// the values in the window so moving it by one bar is constant work. Pushing
+// the same bar index again (real-time updates of the forming bar) replaces
+// that bar's value instead of adding a new one.
+template <typename T>
+struct s_RollingWindow
+{
+    std::vector<T> Values;
+    int Head;           // Slot of the most recent bar
+    int Count;
+    int LastBarIndex;
+    T Sum;
+
+    void Reset(int Capacity)
+    {
+        Values.assign(Capacity > 0 ? Capacity : 1, T());
+        Head = -1;
+        Count = 0;
+        LastBarIndex = -1;
+        Sum = T();
+    }
+
+    int GetCapacity() const { return (int)Values.size(); }
+
+    // Returns false if BarIndex is neither the last pushed bar nor the next
+    // one, in which case the caller has to Reset and refill the window.
+    bool Push(int BarIndex, T Value)
+    {
+        if (Count > 0 && BarIndex == LastBarIndex)
+        {
+            Sum += Value - Values[Head];
+            Values[Head] = Value;
+            return true;
+        }
+
+        if (Count > 0 && BarIndex != LastBarIndex + 1)
+            return false;
+
+        int Capacity = GetCapacity();
+        Head = (Head + 1) % Capacity;
+        if (Count == Capacity)
+            Sum -= Values[Head];
+        else
+            Count++;
+
+        Values[Head] = Value;
+        Sum += Value;
+        LastBarIndex = BarIndex;
+
+        // Re-sum once per lap so floating point drift cannot build up
+        if (Head == 0)
+        {
+            Sum = T();
+            for (int i = 0; i < Count; i++)
+                Sum += Values[i];
+        }
+        return true;
+    }
+};
+
+// Rolling windows behind the chop / slope direction filter
+struct s_MomentumRollingState
+{
+    s_RollingWindow<int> SmallSlope;    // 1 if |slope| < chop threshold
+    s_RollingWindow<int> NegSlope;      // 1 if slope < 0
+    s_RollingWindow<int> PosSlope;      // 1 if slope > 0
+
+    void Reset(int Lookback)
+    {
+        SmallSlope.Reset(Lookback);
+        NegSlope.Reset(Lookback);
+        PosSlope.Reset(Lookback);
+    }
+};
+
+const float CHOP_SLOPE_THRESHOLD = 0.05f;  // 0.05% threshold for "no real movement"
+
+inline void PushSlope(s_MomentumRollingState& Rolling, int Index, float Slope)
+{
+    float AbsSlope = (Slope > 0) ? Slope : -Slope;
+    Rolling.SmallSlope.Push(Index, AbsSlope < CHOP_SLOPE_THRESHOLD ? 1 : 0);
+    Rolling.NegSlope.Push(Index, Slope < 0 ? 1 : 0);
+    Rolling.PosSlope.Push(Index, Slope > 0 ? 1 : 0);
+}
+
+// -----------------------------------------------------------------------------
+// Fused indicator kernel
+//
+// Computes SMA100, EMA1000, EMA50, ATR, SMA20 of ATR, RSI, CCI, ADX, MFI and
+// Stochastic %K for one bar at a time in a single forward pass over the OHLCV
+// arrays. On a full recalculation the whole chart is swept once; afterwards
+// only the forming bar (and bars appended since) are computed.
+//
+// The series are passed as a struct of arrays pointing straight at the bar
+// data and the study's subgraph arrays, so the sweep streams through memory
+// and no extra per-bar storage is needed. Everything that carries over from
+// bar to bar (running window sums, Wilder smoothing) is a handful of scalars,
+// committed once per closed bar like the session VWAP sums.
+// -----------------------------------------------------------------------------
+
+const int SMA_TREND_LENGTH = 100;
+const int EMA_LONG_LENGTH  = 1000;
+const int EMA_FAST_LENGTH  = 50;
+const int ATR_AVG_LENGTH   = 20;
+const int RSI_LENGTH       = 14;
+const int CCI_LENGTH       = 14;
+const float CCI_MULTIPLIER = 0.015f;
+const int ADX_LENGTH       = 14;
+const int MFI_LENGTH       = 14;
+const int STOCH_LENGTH     = 14;
+
+struct s_MomentumSeries
+{
+    // Inputs
+    const float* High;
+    const float* Low;
+    const float* Close;
+    const float* Volume;
+
+    // Outputs
+    float* SMA100;
+    float* EMA1000;
+    float* EMA50;
+    float* ATR;
+    float* ATR20;
+    float* RSI;
+    float* CCISMA;
+    float* CCI;
+    float* ADX;
+    float* MFI;
+    float* StochK;
+};
+
+struct s_MomentumKernelState
+{
+    int NextIndex;              // First bar not yet folded into the sums below
+    double CloseSumTrend;
+    double TRSum;
+    double ATRSum;
+    double UpSum;
+    double DownSum;
+    double CloseSumCCI;
+    double PosFlowSum;
+    double NegFlowSum;
+    double SmoothedTR;
+    double SmoothedPlusDM;
+    double SmoothedMinusDM;
+    double DXSum;               // First ADX_LENGTH DX values, the ADX seed
+
+    void Reset()
+    {
+        NextIndex = 0;
+        CloseSumTrend = TRSum = ATRSum = UpSum = DownSum = CloseSumCCI = 0.0;
+        PosFlowSum = NegFlowSum = 0.0;
+        SmoothedTR = SmoothedPlusDM = SmoothedMinusDM = 0.0;
+        DXSum = 0.0;
+    }
+};
+
+inline float KernelTrueRange(const s_MomentumSeries& S, int i)
+{
+    if (i == 0)
+        return S.High[0] - S.Low[0];
+
+    float PrevClose = S.Close[i - 1];
+    float Hi = (S.High[i] > PrevClose) ? S.High[i] : PrevClose;
+    float Lo = (S.Low[i] < PrevClose) ? S.Low[i] : PrevClose;
+    return Hi - Lo;
+}
+
+inline float KernelCloseChange(const s_MomentumSeries& S, int i)
+{
+    return (i == 0) ? 0.0f : S.Close[i] - S.Close[i - 1];
+}
+
+// Money flow of a single bar, split by the direction of the typical price
+inline void KernelMoneyFlow(const s_MomentumSeries& S, int i, double& PosFlow, double& NegFlow)
+{
+    PosFlow = 0.0;
+    NegFlow = 0.0;
+    if (i < 1)
+        return;
+
+    float tpNow  = (S.High[i] + S.Low[i] + S.Close[i]) / 3.0f;
+    float tpPrev = (S.High[i-1] + S.Low[i-1] + S.Close[i-1]) / 3.0f;
+
+    if (tpNow > tpPrev)
+        PosFlow = tpNow * S.Volume[i];
+    else if (tpNow < tpPrev)
+        NegFlow = tpNow * S.Volume[i];
+}
+
+// Advances State over bar i (State.NextIndex must equal i) and writes bar i's outputs.
+// During warm-up the simple averages use the bars available so far. CCI and
+// ADX are seeded like sc.CCI and sc.ADX and are 0 until they have a full
+// window (CCI_LENGTH bars) or a Wilder seed (2 * ADX_LENGTH bars).
+inline void KernelStep(s_MomentumKernelState& State, const s_MomentumSeries& S, int i, int ATRLength)
+{
+    float C = S.Close[i];
+
+    // --- SMA 100 / EMA 1000 / EMA 50 ---
+    State.CloseSumTrend += C;
+    if (i >= SMA_TREND_LENGTH)
+        State.CloseSumTrend -= S.Close[i - SMA_TREND_LENGTH];
+    S.SMA100[i] = (float)(State.CloseSumTrend / (i + 1 < SMA_TREND_LENGTH ? i + 1 : SMA_TREND_LENGTH));
+
+    if (i == 0)
+    {
+        S.EMA1000[i] = C;
+        S.EMA50[i] = C;
+    }
+    else
+    {
+        S.EMA1000[i] = S.EMA1000[i - 1] + (2.0f / (EMA_LONG_LENGTH + 1)) * (C - S.EMA1000[i - 1]);
+        S.EMA50[i]   = S.EMA50[i - 1] + (2.0f / (EMA_FAST_LENGTH + 1)) * (C - S.EMA50[i - 1]);
+    }
+
+    // --- ATR (simple) and its 20 bar average ---
+    float TR = KernelTrueRange(S, i);
+    State.TRSum += TR;
+    if (i >= ATRLength)
+        State.TRSum -= KernelTrueRange(S, i - ATRLength);
+    S.ATR[i] = (float)(State.TRSum / (i + 1 < ATRLength ? i + 1 : ATRLength));
+
+    State.ATRSum += S.ATR[i];
+    if (i >= ATR_AVG_LENGTH)
+        State.ATRSum -= S.ATR[i - ATR_AVG_LENGTH];
+    S.ATR20[i] = (float)(State.ATRSum / (i + 1 < ATR_AVG_LENGTH ? i + 1 : ATR_AVG_LENGTH));
+
+    // --- RSI (simple) ---
+    float Change = KernelCloseChange(S, i);
+    State.UpSum   += (Change > 0) ? Change : 0.0f;
+    State.DownSum += (Change < 0) ? -Change : 0.0f;
+    if (i >= RSI_LENGTH)
+    {
+        float OldChange = KernelCloseChange(S, i - RSI_LENGTH);
+        State.UpSum   -= (OldChange > 0) ? OldChange : 0.0f;
+        State.DownSum -= (OldChange < 0) ? -OldChange : 0.0f;
+    }
+    if (State.DownSum > 0)
+        S.RSI[i] = 100.0f - 100.0f / (1.0f + (float)(State.UpSum / State.DownSum));
+    else
+        S.RSI[i] = (State.UpSum > 0) ? 100.0f : 50.0f;
+
+    // --- CCI (simple) on close ---
+    State.CloseSumCCI += C;
+    if (i >= CCI_LENGTH)
+        State.CloseSumCCI -= S.Close[i - CCI_LENGTH];
+    int CCIBars = (i + 1 < CCI_LENGTH) ? i + 1 : CCI_LENGTH;
+    float CCIAvg = (float)(State.CloseSumCCI / CCIBars);
+    S.CCISMA[i] = CCIAvg;
+
+    // Mean deviation over a full window only
+    S.CCI[i] = 0.0f;
+    if (i >= CCI_LENGTH - 1)
+    {
+        float MeanDev = 0.0f;
+        for (int k = i - CCI_LENGTH + 1; k <= i; k++)
+            MeanDev += fabs(S.Close[k] - CCIAvg);
+        MeanDev /= CCI_LENGTH;
+        if (MeanDev > 0)
+            S.CCI[i] = (C - CCIAvg) / (CCI_MULTIPLIER * MeanDev);
+    }
+
+    // --- ADX (Wilder) ---
+    // Smoothed TR and DM start as the sums over bars 1..N, so DX exists from
+    // bar N. ADX starts at bar 2N - 1 as the average of the first N DX values.
+    float PlusDM = 0.0f;
+    float MinusDM = 0.0f;
+    if (i > 0)
+    {
+        float UpMove = S.High[i] - S.High[i - 1];
+        float DownMove = S.Low[i - 1] - S.Low[i];
+        if (UpMove > DownMove && UpMove > 0) PlusDM = UpMove;
+        if (DownMove > UpMove && DownMove > 0) MinusDM = DownMove;
+
+        if (i <= ADX_LENGTH)
+        {
+            State.SmoothedTR      += TR;
+            State.SmoothedPlusDM  += PlusDM;
+            State.SmoothedMinusDM += MinusDM;
+        }
+        else
+        {
+            State.SmoothedTR      += TR - State.SmoothedTR / ADX_LENGTH;
+            State.SmoothedPlusDM  += PlusDM - State.SmoothedPlusDM / ADX_LENGTH;
+            State.SmoothedMinusDM += MinusDM - State.SmoothedMinusDM / ADX_LENGTH;
+        }
+    }
+
+    float DX = 0.0f;
+    if (i >= ADX_LENGTH && State.SmoothedTR > 0)
+    {
+        double PlusDI = 100.0 * State.SmoothedPlusDM / State.SmoothedTR;
+        double MinusDI = 100.0 * State.SmoothedMinusDM / State.SmoothedTR;
+        if (PlusDI + MinusDI > 0)
+            DX = (float)(100.0 * fabs(PlusDI - MinusDI) / (PlusDI + MinusDI));
+    }
+
+    S.ADX[i] = 0.0f;
+    if (i >= ADX_LENGTH && i < 2 * ADX_LENGTH - 1)
+        State.DXSum += DX;
+    else if (i == 2 * ADX_LENGTH - 1)
+    {
+        State.DXSum += DX;
+        S.ADX[i] = (float)(State.DXSum / ADX_LENGTH);
+    }
+    else if (i > 2 * ADX_LENGTH - 1)
+        S.ADX[i] = S.ADX[i - 1] + (DX - S.ADX[i - 1]) / ADX_LENGTH;
+
+    // --- MFI ---
+    double PosFlow, NegFlow;
+    KernelMoneyFlow(S, i, PosFlow, NegFlow);
+    State.PosFlowSum += PosFlow;
+    State.NegFlowSum += NegFlow;
+    if (i >= MFI_LENGTH)
+    {
+        KernelMoneyFlow(S, i - MFI_LENGTH, PosFlow, NegFlow);
+        State.PosFlowSum -= PosFlow;
+        State.NegFlowSum -= NegFlow;
+    }
+    double posFlow = State.PosFlowSum;
+    double negFlow = State.NegFlowSum;
+    S.MFI[i] = (posFlow + negFlow > 0) ? 100.0f - (100.0f / (1.0f + (float)(posFlow / negFlow))) : 50.0f;
+
+    // --- Stochastic %K ---
+    float HH = S.High[i];
+    float LL = S.Low[i];
+    for (int k = (i - STOCH_LENGTH + 1 > 0 ? i - STOCH_LENGTH + 1 : 0); k < i; k++)
+    {
+        if (S.High[k] > HH) HH = S.High[k];
+        if (S.Low[k] < LL) LL = S.Low[k];
+    }
+    S.StochK[i] = (HH - LL != 0) ? 100.0f * (C - LL) / (HH - LL) : 0.0f;
+
+    State.NextIndex = i + 1;
+}
+
+// Computes bar Index. Bars before it are committed first; bar Index itself
+// is computed from a copy of the committed state so it can be recomputed on
+// every real-time update until it closes.
+inline void KernelUpdate(s_MomentumKernelState& Committed, const s_MomentumSeries& S, int Index, int ATRLength)
+{
+    if (Index < Committed.NextIndex)
+        Committed.Reset();  // Stepped back behind the committed bars, rebuild from the start
+
+    while (Committed.NextIndex < Index)
+        KernelStep(Committed, S, Committed.NextIndex, ATRLength);
+
+    s_MomentumKernelState Forming = Committed;
+    KernelStep(Forming, S, Index, ATRLength);
+}
+
+// Sweeps [0, ArraySize) in one pass on a full recalculation
+inline void KernelSweep(s_MomentumKernelState& Committed, const s_MomentumSeries& S, int ArraySize, int ATRLength)
+{
+    Committed.Reset();
+    if (ArraySize > 0)
+        KernelUpdate(Committed, S, ArraySize - 1, ATRLength);
+}
+
+
+// -----------------------------------------------------------------------------
+// Inputs
+// -----------------------------------------------------------------------------
+
+// Study inputs the signal and exit logic depends on
+struct s_MomentumParams
+{
+    float HardStopPercent;
+    float TargetATRMult;
+    float ExtTargetATRMult;
+    float TrailTriggerATR;
+    float TrailDistATR;
+    int ATRLength;
+    int TradeRTHOnly;
+    float MinSlopeThreshold;
+    float ExtremeSlopeBlock;
+    float SetupBSlopeGate;
+    int ChopLookback;
+    int ChopFlatBarPct;
+    int MinBarsBetweenTrades;
+    int SlopeDirThreshold;
+
+    // Same defaults as the study's SetDefaults
+    void SetDefaults()
+    {
+        HardStopPercent      = 0.12f;
+        TargetATRMult        = 4.0f;
+        ExtTargetATRMult     = 6.0f;
+        TrailTriggerATR      = 2.5f;
+        TrailDistATR         = 0.7f;
+        ATRLength            = 14;
+        TradeRTHOnly         = 0;
+        MinSlopeThreshold    = 0.10f;
+        ExtremeSlopeBlock    = 0.10f;
+        SetupBSlopeGate      = 0.06f;
+        ChopLookback         = 20;
+        ChopFlatBarPct       = 70;
+        MinBarsBetweenTrades = 5;
+        SlopeDirThreshold    = 50;
+    }
+};
+
+// Parameters by name (the study's input variable names), for command line tools
+struct s_MomentumParamField
+{
+    const char* Name;
+    float s_MomentumParams::* FloatField;
+    int s_MomentumParams::* IntField;
+};
+
+static const s_MomentumParamField MOMENTUM_PARAM_FIELDS[] =
+{
+    { "HardStopPercent",      &s_MomentumParams::HardStopPercent,   NULL },
+    { "TargetATRMult",        &s_MomentumParams::TargetATRMult,     NULL },
+    { "ExtTargetATRMult",     &s_MomentumParams::ExtTargetATRMult,  NULL },
+    { "TrailTriggerATR",      &s_MomentumParams::TrailTriggerATR,   NULL },
+    { "TrailDistATR",         &s_MomentumParams::TrailDistATR,      NULL },
+    { "ATRLength",            NULL, &s_MomentumParams::ATRLength },
+    { "TradeRTHOnly",         NULL, &s_MomentumParams::TradeRTHOnly },
+    { "MinSlopeThreshold",    &s_MomentumParams::MinSlopeThreshold, NULL },
+    { "ExtremeSlopeBlock",    &s_MomentumParams::ExtremeSlopeBlock, NULL },
+    { "SetupBSlopeGate",      &s_MomentumParams::SetupBSlopeGate,   NULL },
+    { "ChopLookback",         NULL, &s_MomentumParams::ChopLookback },
+    { "ChopFlatBarPct",       NULL, &s_MomentumParams::ChopFlatBarPct },
+    { "MinBarsBetweenTrades", NULL, &s_MomentumParams::MinBarsBetweenTrades },
+    { "SlopeDirThreshold",    NULL, &s_MomentumParams::SlopeDirThreshold },
+};
+
+const int NUM_MOMENTUM_PARAM_FIELDS = sizeof(MOMENTUM_PARAM_FIELDS) / sizeof(MOMENTUM_PARAM_FIELDS[0]);
+
+inline const s_MomentumParamField* MomentumFindParam(const char* Name)
+{
+    for (int i = 0; i < NUM_MOMENTUM_PARAM_FIELDS; i++)
+    {
+        if (strcmp(MOMENTUM_PARAM_FIELDS[i].Name, Name) == 0)
+            return &MOMENTUM_PARAM_FIELDS[i];
+    }
+    return NULL;
+}
+
+inline void MomentumSetParam(s_MomentumParams& P, const s_MomentumParamField& Field, double Value)
+{
+    if (Field.FloatField != NULL)
+        P.*Field.FloatField = (float)Value;
+    else
+        P.*Field.IntField = (int)floor(Value + 0.5);
+}
+
+inline double MomentumGetParam(const s_MomentumParams& P, const s_MomentumParamField& Field)
+{
+    return (Field.FloatField != NULL) ? (double)(P.*Field.FloatField) : (double)(P.*Field.IntField);
+}
+
+// True if every parameter is the same in both sets
+inline bool MomentumSameParams(const s_MomentumParams& A, const s_MomentumParams& B)
+{
+    for (int i = 0; i < NUM_MOMENTUM_PARAM_FIELDS; i++)
+    {
+        if (MomentumGetParam(A, MOMENTUM_PARAM_FIELDS[i]) != MomentumGetParam(B, MOMENTUM_PARAM_FIELDS[i]))
+            return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Trend, chop and scoring
+// -----------------------------------------------------------------------------
+
+// Percentage price change over 5 bars, for cross-instrument compatibility
+inline float MomentumSlope(const float* Close, int i)
+{
+    if (i >= 5 && Close[i] > 0 && Close[i - 5] > 0)
+        return ((Close[i] - Close[i - 5]) / Close[i]) * 100.0f;
+
+    return 0.0f;
+}
+
+struct s_MomentumChop
+{
+    bool IsChoppy;
+    bool MajorityNegative;
+    bool MajorityPositive;
+};
+
+// Choppy if X% of the lookback has tiny slopes. X%+ negative slopes = no
+// longs, X%+ positive slopes = no shorts.
+inline s_MomentumChop MomentumChopState(const s_MomentumRollingState& Rolling, const s_MomentumParams& P)
+{
+    int BarsChecked = Rolling.SmallSlope.Count;
+
+    float ChopPercent = (BarsChecked > 0) ? (Rolling.SmallSlope.Sum * 100.0f / BarsChecked) : 0.0f;
+    float NegSlopePct = (BarsChecked > 0) ? (Rolling.NegSlope.Sum * 100.0f / BarsChecked) : 0.0f;
+    float PosSlopePct = (BarsChecked > 0) ? (Rolling.PosSlope.Sum * 100.0f / BarsChecked) : 0.0f;
+    float DirThreshold = (float)P.SlopeDirThreshold;
+
+    s_MomentumChop Chop;
+    Chop.IsChoppy = (ChopPercent >= (float)P.ChopFlatBarPct);
+    Chop.MajorityNegative = (NegSlopePct >= DirThreshold);
+    Chop.MajorityPositive = (PosSlopePct >= DirThreshold);
+    return Chop;
+}
+
+// Composite momentum score (0..220) from the kernel outputs and session VWAP
+inline int MomentumScore(const s_MomentumSeries& S, const float* VWAP, int i, bool DeltaRising)
+{
+    float cC = S.Close[i];
+    bool pHigh = (cC > S.SMA100[i] && cC > S.EMA1000[i] && cC > VWAP[i]);
+    bool pLow  = (cC < S.SMA100[i] && cC < S.EMA1000[i] && cC < VWAP[i]);
+
+    int sPrice = pHigh ? 50 : (pLow ? 0 : 25);
+    int sRSI   = S.RSI[i] > 70 ? 25 : (S.RSI[i] < 30 ? 0 : 15);
+
+    float vP   = (i >= 20) ? VWAP[i - 20] : 0.0f;
+    float vm   = (vP > 0) ? ((VWAP[i] - vP) / vP) * 100.0f : 0.0f;
+    int sVW    = vm > 1 ? 25 : (vm < -1 ? 0 : 15);
+
+    int sADX   = S.ADX[i] > 40 ? 20 : (S.ADX[i] > 25 ? 10 : 0);
+    int sStoch = S.StochK[i] > 80 ? 20 : (S.StochK[i] < 20 ? 0 : 12);
+    int sCCI   = S.CCI[i] > 100 ? 20 : (S.CCI[i] < -100 ? 0 : 12);
+    int sMFI   = S.MFI[i] > 80 ? 15 : (S.MFI[i] < 20 ? 0 : 10);
+    int sVol   = (S.ATR[i] > S.ATR20[i] * 1.5) ? 10 : 5;
+    int sDel   = DeltaRising ? 15 : 0;
+
+    return sPrice + sRSI + sVW + sADX + sStoch + sCCI + sMFI + sVol + sDel;
+}
+
+// Highest high / lowest low of the Length bars ending at EndIndex
+inline float MomentumHighest(const float* Array, int EndIndex, int Length)
+{
+    if (EndIndex < 0)
+        return Array[0];
+
+    float Result = Array[EndIndex];
+    for (int k = EndIndex - 1; k > EndIndex - Length && k >= 0; k--)
+    {
+        if (Array[k] > Result) Result = Array[k];
+    }
+    return Result;
+}
+
+inline float MomentumLowest(const float* Array, int EndIndex, int Length)
+{
+    if (EndIndex < 0)
+        return Array[0];
+
+    float Result = Array[EndIndex];
+    for (int k = EndIndex - 1; k > EndIndex - Length && k >= 0; k--)
+    {
+        if (Array[k] < Result) Result = Array[k];
+    }
+    return Result;
+}
+
+// -----------------------------------------------------------------------------
+// Setups A-E and entry filters (section 9 of the study)
+// -----------------------------------------------------------------------------
+
+enum MomentumSetupEnum
+{
+    SETUP_A = 0,
+    SETUP_B,
+    SETUP_C,
+    SETUP_D,
+    SETUP_E,
+    NUM_MOMENTUM_SETUPS
+};
+
+static const char* const MOMENTUM_SETUP_LABELS[NUM_MOMENTUM_SETUPS] = { "A", "B", "C", "D", "E" };
+
+// Everything the setups read for one closed bar
+struct s_MomentumBarContext
+{
+    int Index;
+    int MinuteOfDay;            // Bar start time, minutes after midnight
+    float Open;
+    float High;
+    float Low;
+    float Close;
+    float PrevOpen;
+    float ATR;
+    float CCI;
+    float PrevCCI;
+    float SMA100;
+    float EMA50;
+    float VWAP;
+    float BandTop20;
+    float BandBot20;
+    float BandTop10;
+    float BandBot10;
+    float BandTop05;
+    float BandBot05;
+    float Highest5;             // Of the 5 bars before this one
+    float Lowest5;
+    float Slope;
+    int Score;
+    s_MomentumChop Chop;
+};
+
+inline void MomentumBuildContext(s_MomentumBarContext& B, const s_MomentumSeries& S, const float* Open,
+    const float* VWAP, float StdDev, float Slope, int Score, const s_MomentumChop& Chop, int i, int MinuteOfDay)
+{
+    int Prev = (i > 0) ? i - 1 : 0;
+
+    B.Index       = i;
+    B.MinuteOfDay = MinuteOfDay;
+    B.Open        = Open[i];
+    B.High        = S.High[i];
+    B.Low         = S.Low[i];
+    B.Close       = S.Close[i];
+    B.PrevOpen    = Open[Prev];
+    B.ATR         = S.ATR[i];
+    B.CCI         = S.CCI[i];
+    B.PrevCCI     = S.CCI[Prev];
+    B.SMA100      = S.SMA100[i];
+    B.EMA50       = S.EMA50[i];
+    B.VWAP        = VWAP[i];
+    B.BandTop20   = VWAP[i] + (2.0f * StdDev);
+    B.BandBot20   = VWAP[i] - (2.0f * StdDev);
+    B.BandTop10   = VWAP[i] + (1.0f * StdDev);
+    B.BandBot10   = VWAP[i] - (1.0f * StdDev);
+    B.BandTop05   = VWAP[i] + (0.5f * StdDev);
+    B.BandBot05   = VWAP[i] - (0.5f * StdDev);
+    B.Highest5    = MomentumHighest(S.High, i - 1, 5);
+    B.Lowest5     = MomentumLowest(S.Low, i - 1, 5);
+    B.Slope       = Slope;
+    B.Score       = Score;
+    B.Chop        = Chop;
+}
+
+// Per-bar conditions the setup and filter rules are built from. A bar's
+// atoms are one word, bit a for atom a.
+enum MomentumAtomEnum
+{
+    ATOM_IN_RTH = 0,
+    ATOM_CHOPPY,
+    ATOM_STRONG_UP,             // Slope > Trend Detection Slope
+    ATOM_STRONG_DOWN,
+    ATOM_EXTREME_UP,            // Slope > Kill Switch Slope
+    ATOM_EXTREME_DOWN,
+    ATOM_MAJORITY_POSITIVE,     // Slope direction over the chop lookback
+    ATOM_MAJORITY_NEGATIVE,
+    ATOM_CCI_BUY,               // CCI crossed up through -100
+    ATOM_CCI_SELL,              // CCI crossed down through 100
+    ATOM_SCORE_LOW,             // Score < 70
+    ATOM_SCORE_HIGH,            // 130 < Score < 190
+    ATOM_BELOW_BOT20,
+    ATOM_ABOVE_TOP20,
+    ATOM_CANDLE_BULLISH,        // Close above the previous bar's open
+    ATOM_CANDLE_BEARISH,
+    ATOM_SLOPE_ABOVE_GATE,      // Slope > Setup B gate
+    ATOM_SLOPE_BELOW_GATE,      // Slope < -Setup B gate
+    ATOM_TOUCHED_MA,            // Bar range spans SMA100 or EMA50
+    ATOM_TOUCHED_RESISTANCE,    // High reached EMA50, SMA100 or VWAP -1SD
+    ATOM_TOUCHED_SUPPORT,       // Low reached EMA50, SMA100 or VWAP +1SD
+    ATOM_ABOVE_EMA50,
+    ATOM_BELOW_EMA50,
+    ATOM_ABOVE_HIGHEST5,
+    ATOM_BELOW_LOWEST5,
+    ATOM_DOWNTREND_STRUCTURE,   // Below VWAP and SMA100
+    ATOM_UPTREND_STRUCTURE,     // Above VWAP and SMA100
+    NUM_MOMENTUM_ATOMS
+};
+
+#define MOMENTUM_ATOM(a) (1u << (a))
+#define MOMENTUM_SETUP(s) (1u << (s))
+
+// A setup fires on bars where every Require atom is set and no Forbid atom is
+struct s_MomentumSetupRule
+{
+    unsigned Require;
+    unsigned Forbid;
+};
+
+// [0] = Long, [1] = Short, in setup order. A new setup is a new row here (and
+// new atoms if it needs conditions that don't exist yet).
+static constexpr s_MomentumSetupRule MOMENTUM_SETUP_RULES[2][NUM_MOMENTUM_SETUPS] =
+{
+    {
+        // A: Momentum - extreme low score with a CCI buy cross
+        { MOMENTUM_ATOM(ATOM_SCORE_LOW) | MOMENTUM_ATOM(ATOM_CCI_BUY),
+          MOMENTUM_ATOM(ATOM_CHOPPY) | MOMENTUM_ATOM(ATOM_STRONG_DOWN) | MOMENTUM_ATOM(ATOM_EXTREME_DOWN) },
+        // B: Extreme reversion at the 2.0 SD band
+        { MOMENTUM_ATOM(ATOM_BELOW_BOT20) | MOMENTUM_ATOM(ATOM_CANDLE_BULLISH) | MOMENTUM_ATOM(ATOM_SLOPE_ABOVE_GATE), 0 },
+        // C: Trend pullback to EMA50 / SMA100
+        { MOMENTUM_ATOM(ATOM_MAJORITY_POSITIVE) | MOMENTUM_ATOM(ATOM_TOUCHED_MA) | MOMENTUM_ATOM(ATOM_CANDLE_BULLISH),
+          MOMENTUM_ATOM(ATOM_CHOPPY) },
+        // D: Extreme breakout over the 5-bar high
+        { MOMENTUM_ATOM(ATOM_EXTREME_UP) | MOMENTUM_ATOM(ATOM_ABOVE_EMA50) | MOMENTUM_ATOM(ATOM_ABOVE_HIGHEST5),
+          MOMENTUM_ATOM(ATOM_CHOPPY) },
+        // E: Trend continuation, buy the dip to support
+        { MOMENTUM_ATOM(ATOM_MAJORITY_POSITIVE) | MOMENTUM_ATOM(ATOM_TOUCHED_SUPPORT) | MOMENTUM_ATOM(ATOM_CANDLE_BULLISH),
+          MOMENTUM_ATOM(ATOM_CHOPPY) },
+    },
+    {
+        { MOMENTUM_ATOM(ATOM_SCORE_HIGH) | MOMENTUM_ATOM(ATOM_CCI_SELL),
+          MOMENTUM_ATOM(ATOM_CHOPPY) | MOMENTUM_ATOM(ATOM_STRONG_UP) | MOMENTUM_ATOM(ATOM_EXTREME_UP) },
+        { MOMENTUM_ATOM(ATOM_ABOVE_TOP20) | MOMENTUM_ATOM(ATOM_CANDLE_BEARISH) | MOMENTUM_ATOM(ATOM_SLOPE_BELOW_GATE), 0 },
+        { MOMENTUM_ATOM(ATOM_MAJORITY_NEGATIVE) | MOMENTUM_ATOM(ATOM_TOUCHED_MA) | MOMENTUM_ATOM(ATOM_CANDLE_BEARISH),
+          MOMENTUM_ATOM(ATOM_CHOPPY) },
+        { MOMENTUM_ATOM(ATOM_EXTREME_DOWN) | MOMENTUM_ATOM(ATOM_BELOW_EMA50) | MOMENTUM_ATOM(ATOM_BELOW_LOWEST5),
+          MOMENTUM_ATOM(ATOM_CHOPPY) },
+        // E: Trend continuation, sell the rally to resistance
+        { MOMENTUM_ATOM(ATOM_MAJORITY_NEGATIVE) | MOMENTUM_ATOM(ATOM_TOUCHED_RESISTANCE) | MOMENTUM_ATOM(ATOM_CANDLE_BEARISH),
+          MOMENTUM_ATOM(ATOM_CHOPPY) },
+    },
+};
+
+// An entry filter blocks a direction on bars where Blocker is set, unless
+// one of the ExemptSetups fired on that bar
+struct s_MomentumFilterRule
+{
+    int Blocker;
+    unsigned ExemptSetups;
+};
+
+const int NUM_MOMENTUM_FILTERS = 4;
+
+static constexpr s_MomentumFilterRule MOMENTUM_FILTER_RULES[2][NUM_MOMENTUM_FILTERS] =
+{
+    {
+        { ATOM_EXTREME_DOWN,        MOMENTUM_SETUP(SETUP_D) },                              // Kill switch
+        { ATOM_DOWNTREND_STRUCTURE, MOMENTUM_SETUP(SETUP_A) },                              // Structure
+        { ATOM_STRONG_DOWN,         MOMENTUM_SETUP(SETUP_A) | MOMENTUM_SETUP(SETUP_D) },    // Slope
+        { ATOM_MAJORITY_NEGATIVE,   MOMENTUM_SETUP(SETUP_A) },                              // Slope direction
+    },
+    {
+        { ATOM_EXTREME_UP,          MOMENTUM_SETUP(SETUP_D) },
+        { ATOM_UPTREND_STRUCTURE,   MOMENTUM_SETUP(SETUP_A) },
+        { ATOM_STRONG_UP,           MOMENTUM_SETUP(SETUP_A) | MOMENTUM_SETUP(SETUP_D) },
+        { ATOM_MAJORITY_POSITIVE,   MOMENTUM_SETUP(SETUP_A) },
+    },
+};
+
+// Atoms of one bar, bit a set if atom a holds. The conditions combine with
+// & and | rather than && and || so the whole word is built without branches.
+inline unsigned MomentumAtomBits(const s_MomentumBarContext& B, const s_MomentumParams& P)
+{
+    bool InRTH = !P.TradeRTHOnly || (B.MinuteOfDay >= 570 && B.MinuteOfDay < 960);
+
+    unsigned Bits = 0;
+    Bits |= (unsigned)(InRTH) << ATOM_IN_RTH;
+    Bits |= (unsigned)(B.Chop.IsChoppy) << ATOM_CHOPPY;
+    Bits |= (unsigned)(B.Slope > P.MinSlopeThreshold) << ATOM_STRONG_UP;
+    Bits |= (unsigned)(B.Slope < -P.MinSlopeThreshold) << ATOM_STRONG_DOWN;
+    Bits |= (unsigned)(B.Slope > P.ExtremeSlopeBlock) << ATOM_EXTREME_UP;
+    Bits |= (unsigned)(B.Slope < -P.ExtremeSlopeBlock) << ATOM_EXTREME_DOWN;
+    Bits |= (unsigned)(B.Chop.MajorityPositive) << ATOM_MAJORITY_POSITIVE;
+    Bits |= (unsigned)(B.Chop.MajorityNegative) << ATOM_MAJORITY_NEGATIVE;
+    Bits |= (unsigned)((B.CCI > -100) & (B.PrevCCI <= -100)) << ATOM_CCI_BUY;
+    Bits |= (unsigned)((B.CCI < 100) & (B.PrevCCI >= 100)) << ATOM_CCI_SELL;
+    Bits |= (unsigned)(B.Score < 70) << ATOM_SCORE_LOW;
+    Bits |= (unsigned)((B.Score > 130) & (B.Score < 190)) << ATOM_SCORE_HIGH;
+    Bits |= (unsigned)(B.Close < B.BandBot20) << ATOM_BELOW_BOT20;
+    Bits |= (unsigned)(B.Close > B.BandTop20) << ATOM_ABOVE_TOP20;
+    Bits |= (unsigned)(B.Close > B.PrevOpen) << ATOM_CANDLE_BULLISH;
+    Bits |= (unsigned)(B.Close < B.PrevOpen) << ATOM_CANDLE_BEARISH;
+    Bits |= (unsigned)(B.Slope > P.SetupBSlopeGate) << ATOM_SLOPE_ABOVE_GATE;
+    Bits |= (unsigned)(B.Slope < -P.SetupBSlopeGate) << ATOM_SLOPE_BELOW_GATE;
+    Bits |= (unsigned)(((B.Low <= B.SMA100) & (B.High >= B.SMA100)) | ((B.Low <= B.EMA50) & (B.High >= B.EMA50))) << ATOM_TOUCHED_MA;
+    Bits |= (unsigned)((B.High >= B.EMA50) | (B.High >= B.SMA100) | (B.High >= B.BandBot10)) << ATOM_TOUCHED_RESISTANCE;
+    Bits |= (unsigned)((B.Low <= B.EMA50) | (B.Low <= B.SMA100) | (B.Low <= B.BandTop10)) << ATOM_TOUCHED_SUPPORT;
+    Bits |= (unsigned)(B.Close > B.EMA50) << ATOM_ABOVE_EMA50;
+    Bits |= (unsigned)(B.Close < B.EMA50) << ATOM_BELOW_EMA50;
+    Bits |= (unsigned)(B.Close > B.Highest5) << ATOM_ABOVE_HIGHEST5;
+    Bits |= (unsigned)(B.Close < B.Lowest5) << ATOM_BELOW_LOWEST5;
+    Bits |= (unsigned)((B.Close < B.VWAP) & (B.Close < B.SMA100)) << ATOM_DOWNTREND_STRUCTURE;
+    Bits |= (unsigned)((B.Close > B.VWAP) & (B.Close > B.SMA100)) << ATOM_UPTREND_STRUCTURE;
+    return Bits;
+}
+
+// Expands the rule table for one direction at compile time: the setups that
+// fire for a bar's atoms, bit s for setup s. Require and Forbid are
+// constants, so each rule folds down to two mask compares.
+template <int Direction, int Setup>
+struct s_MomentumRuleTable
+{
+    static unsigned Evaluate(unsigned Atoms)
+    {
+        const unsigned Require = MOMENTUM_SETUP_RULES[Direction][Setup].Require;
+        const unsigned Forbid = MOMENTUM_SETUP_RULES[Direction][Setup].Forbid;
+        unsigned Fired = (unsigned)(((Atoms & Require) == Require) & ((Atoms & Forbid) == 0)) << Setup;
+        return Fired | s_MomentumRuleTable<Direction, Setup + 1>::Evaluate(Atoms);
+    }
+};
+
+template <int Direction>
+struct s_MomentumRuleTable<Direction, NUM_MOMENTUM_SETUPS>
+{
+    static unsigned Evaluate(unsigned) { return 0; }
+};
+
+// Setups of one direction that fire on a bar and get past the filters
+template <int Direction>
+inline unsigned MomentumBarSetups(unsigned Atoms)
+{
+    unsigned Setups = s_MomentumRuleTable<Direction, 0>::Evaluate(Atoms);
+    if (Setups == 0)
+        return 0;
+
+    for (int f = 0; f < NUM_MOMENTUM_FILTERS; f++)
+    {
+        const s_MomentumFilterRule& Filter = MOMENTUM_FILTER_RULES[Direction][f];
+        if ((Atoms & MOMENTUM_ATOM(Filter.Blocker)) && (Setups & Filter.ExemptSetups) == 0)
+            return 0;
+    }
+    return Setups;
+}
+
+struct s_MomentumSignal
+{
+    int Direction;              // 0=None, 1=Long, -1=Short
+    int Setup;                  // First triggering setup, A before B ... before E
+    float TargetMult;           // Target distance in ATRs
+};
+
+inline float MomentumTargetMult(float Slope, const s_MomentumParams& P)
+{
+    float SlopeMag = (Slope > 0) ? Slope : -Slope;
+    return (SlopeMag > P.MinSlopeThreshold) ? P.ExtTargetATRMult : P.TargetATRMult;
+}
+
+// Setups A-E and the entry filters for one bar. Long wins a bar where both
+// directions pass.
+inline s_MomentumSignal MomentumEvaluateSignal(const s_MomentumBarContext& B, const s_MomentumParams& P)
+{
+    s_MomentumSignal Signal;
+    Signal.Direction = 0;
+    Signal.Setup = -1;
+    Signal.TargetMult = MomentumTargetMult(B.Slope, P);
+
+    unsigned Atoms = MomentumAtomBits(B, P);
+    if ((Atoms & MOMENTUM_ATOM(ATOM_IN_RTH)) == 0)
+        return Signal;
+
+    unsigned Setups = MomentumBarSetups<0>(Atoms);
+    Signal.Direction = 1;
+    if (Setups == 0)
+    {
+        Setups = MomentumBarSetups<1>(Atoms);
+        Signal.Direction = -1;
+    }
+    if (Setups == 0)
+    {
+        Signal.Direction = 0;
+        return Signal;
+    }
+
+    // The first setup in table order wins
+    for (int s = 0; s < NUM_MOMENTUM_SETUPS; s++)
+    {
+        if (Setups & MOMENTUM_SETUP(s))
+        {
+            Signal.Setup = s;
+            break;
+        }
+    }
+    return Signal;
+}
+
+// -----------------------------------------------------------------------------
+// Virtual trade state (sections 8 and 10 of the study)
+// -----------------------------------------------------------------------------
+
+enum MomentumExitReasonEnum
+{
+    EXIT_NONE = 0,
+    EXIT_STOP,
+    EXIT_TARGET,
+    EXIT_SESSION_RESET,         // Trade state is cleared at the start of a trading day
+    EXIT_REPLACED,              // A new signal replaced the trade (chart history mode)
+    EXIT_END_OF_DATA
+};
+
+static const char* const MOMENTUM_EXIT_REASON_NAMES[] = { "None", "Stop", "Target", "SessionReset", "Replaced", "EndOfData" };
+
+struct s_MomentumTrade
+{
+    int Direction;              // 0=Flat, 1=Long, -1=Short
+    double EntryPrice;
+    double StopPrice;
+    double TargetPrice;
+    int EntryIndex;
+    int Setup;
+    int LastExitIndex;          // Cooldown after exit
+    int LastSignalIndex;        // Track last signal bar
+
+    void Reset()
+    {
+        Direction = 0;
+        EntryPrice = StopPrice = TargetPrice = 0.0;
+        EntryIndex = -1;
+        Setup = -1;
+        LastExitIndex = -1000000;
+        LastSignalIndex = -1000000;
+    }
+};
+
+// Stop / target check and trailing stop for an open trade. Returns the exit
+// reason (EXIT_NONE if still open) and the exit price.
+inline int MomentumCheckExit(s_MomentumTrade& T, const s_MomentumParams& P, float High, float Low, float Close, float ATR, int Index, double& ExitPrice)
+{
+    int Reason = EXIT_NONE;
+    ExitPrice = 0.0;
+
+    if (T.Direction == 1) // Long
+    {
+        if (Low <= T.StopPrice)
+        {
+            Reason = EXIT_STOP;
+            ExitPrice = T.StopPrice;
+        }
+        else if (High >= T.TargetPrice)
+        {
+            Reason = EXIT_TARGET;
+            ExitPrice = T.TargetPrice;
+        }
+
+        // Trailing Stop
+        if (Reason == EXIT_NONE && (Close - T.EntryPrice) > (P.TrailTriggerATR * ATR))
+        {
+            float NewStop = Close - (P.TrailDistATR * ATR);
+            if (NewStop > T.StopPrice)
+                T.StopPrice = NewStop;
+        }
+    }
+    else if (T.Direction == -1) // Short
+    {
+        if (High >= T.StopPrice)
+        {
+            Reason = EXIT_STOP;
+            ExitPrice = T.StopPrice;
+        }
+        else if (Low <= T.TargetPrice)
+        {
+            Reason = EXIT_TARGET;
+            ExitPrice = T.TargetPrice;
+        }
+
+        // Trailing Stop
+        if (Reason == EXIT_NONE && (T.EntryPrice - Close) > (P.TrailTriggerATR * ATR))
+        {
+            float NewStop = Close + (P.TrailDistATR * ATR);
+            if (NewStop < T.StopPrice)
+                T.StopPrice = NewStop;
+        }
+    }
+
+    if (Reason != EXIT_NONE)
+    {
+        T.Direction = 0; // Trade Closed
+        T.LastExitIndex = Index; // Mark exit bar for cooldown
+    }
+    return Reason;
+}
+
+inline void MomentumOpenTrade(s_MomentumTrade& T, const s_MomentumSignal& Signal, float Close, float ATR, const s_MomentumParams& P, int Index)
+{
+    T.Direction       = Signal.Direction;
+    T.Setup           = Signal.Setup;
+    T.EntryIndex      = Index;
+    T.EntryPrice      = Close;
+    T.LastSignalIndex = Index;
+
+    if (Signal.Direction == 1)
+    {
+        T.StopPrice   = Close * (1.0f - (P.HardStopPercent / 100.0f));
+        T.TargetPrice = Close + (Signal.TargetMult * ATR);
+    }
+    else
+    {
+        T.StopPrice   = Close * (1.0f + (P.HardStopPercent / 100.0f));
+        T.TargetPrice = Close - (Signal.TargetMult * ATR);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// State checkpoints
+//
+// Everything the study carries from one bar to the next, for the last closed
+// bar: the kernel sums, session VWAP sums, chop windows and virtual trade,
+// plus the last few values of the series the study reads back (EMA[i - 1],
+// ATR[i - 20], VWAP[i - 20], ...), and records only the study knows about
+// (its day statistics, its signals) packed by the study. With that, a
+// reloaded chart can resume right after the checkpoint bar instead of
+// warming up from bar 0.
+//
+// Bar indexes are stored as they were when saved; ShiftIndexes moves them
+// to wherever the checkpoint bar is after the reload.
+// -----------------------------------------------------------------------------
+
+const uint32_t MOMENTUM_CHECKPOINT_MAGIC   = 0x4B434D58;    // "XMCK"
+const uint32_t MOMENTUM_CHECKPOINT_VERSION = 5;
+const int MOMENTUM_CHECKPOINT_TAIL         = 64;            // Bars of each series kept
+
+// Bars before the checkpoint bar the kernel still reads from the chart
+inline int MomentumKernelLookback(int ATRLength)
+{
+    int Lookback = SMA_TREND_LENGTH;
+    if (ATRLength + 1 > Lookback) Lookback = ATRLength + 1;
+    if (RSI_LENGTH + 1 > Lookback) Lookback = RSI_LENGTH + 1;
+    if (MFI_LENGTH + 1 > Lookback) Lookback = MFI_LENGTH + 1;
+    return Lookback;
+}
+
+struct s_MomentumByteWriter
+{
+    std::vector<char>& Out;
+
+    explicit s_MomentumByteWriter(std::vector<char>& Buffer) : Out(Buffer) {}
+
+    void PutBytes(const void* Data, size_t Size)
+    {
+        const char* Bytes = static_cast<const char*>(Data);
+        Out.insert(Out.end(), Bytes, Bytes + Size);
+    }
+
+    template <typename T>
+    void Put(const T& Value) { PutBytes(&Value, sizeof(T)); }
+
+    template <typename T>
+    void PutVector(const std::vector<T>& Values)
+    {
+        Put((uint32_t)Values.size());
+        if (!Values.empty())
+            PutBytes(&Values[0], Values.size() * sizeof(T));
+    }
+};
+
+// Reads past the end fail and leave Ok false; callers check it once at the end
+struct s_MomentumByteReader
+{
+    const char* Data;
+    size_t Size;
+    size_t Position;
+    bool Ok;
+
+    s_MomentumByteReader(const char* Buffer, size_t BufferSize) : Data(Buffer), Size(BufferSize), Position(0), Ok(true) {}
+
+    void GetBytes(void* Dest, size_t Count)
+    {
+        if (!Ok || Size - Position < Count)
+        {
+            Ok = false;
+            memset(Dest, 0, Count);
+            return;
+        }
+        memcpy(Dest, Data + Position, Count);
+        Position += Count;
+    }
+
+    template <typename T>
+    void Get(T& Value) { GetBytes(&Value, sizeof(T)); }
+
+    template <typename T>
+    void GetVector(std::vector<T>& Values, uint32_t MaxCount)
+    {
+        uint32_t Count = 0;
+        Get(Count);
+        if (!Ok || Count > MaxCount)
+        {
+            Ok = false;
+            Values.clear();
+            return;
+        }
+        Values.resize(Count);
+        if (Count > 0)
+            GetBytes(&Values[0], Count * sizeof(T));
+    }
+};
+
+struct s_MomentumCheckpoint
+{
+    std::string Key;                // Symbol and bar period
+    double LastBarDateTime;         // Checkpoint bar: last bar folded into the state
+    int LastBarIndex;               // Its index when saved
+    s_MomentumParams Params;        // Inputs the state was calculated with
+
+    s_MomentumKernelState Kernel;
+    s_SessionVWAPAccumulator SessionVWAP;
+    s_MomentumRollingState Rolling;
+    s_MomentumTrade Trade;
+
+    std::vector<int> StudyInts;     // Study specific values (day, daily trade count, ...)
+    std::vector<float> CloseTail;   // Closes of the tail bars, to check the chart still has the same data
+    std::vector<std::vector<float> > SeriesTail;    // Tail of each saved series, oldest first
+    std::vector<char> StudyData;    // Study specific records; their bar indexes are the study's to shift
+
+    void ShiftIndexes(int Delta)
+    {
+        LastBarIndex += Delta;
+        Kernel.NextIndex += Delta;
+        SessionVWAP.StartIndex += Delta;
+        SessionVWAP.FormingBarIndex += Delta;
+        Rolling.SmallSlope.LastBarIndex += Delta;
+        Rolling.NegSlope.LastBarIndex += Delta;
+        Rolling.PosSlope.LastBarIndex += Delta;
+        Trade.EntryIndex += Delta;
+        Trade.LastExitIndex += Delta;
+        Trade.LastSignalIndex += Delta;
+    }
+
+    void Serialize(std::vector<char>& Out) const
+    {
+        Out.clear();
+        s_MomentumByteWriter W(Out);
+
+        W.Put(MOMENTUM_CHECKPOINT_MAGIC);
+        W.Put(MOMENTUM_CHECKPOINT_VERSION);
+        W.PutVector(std::vector<char>(Key.begin(), Key.end()));
+        W.Put(LastBarDateTime);
+        W.Put(LastBarIndex);
+        for (int f = 0; f < NUM_MOMENTUM_PARAM_FIELDS; f++)
+        {
+            if (MOMENTUM_PARAM_FIELDS[f].FloatField != NULL)
+                W.Put(Params.*MOMENTUM_PARAM_FIELDS[f].FloatField);
+            else
+                W.Put(Params.*MOMENTUM_PARAM_FIELDS[f].IntField);
+        }
+        W.Put(Kernel);
+        W.Put(SessionVWAP);
+
+        const s_RollingWindow<int>* Windows[] = { &Rolling.SmallSlope, &Rolling.NegSlope, &Rolling.PosSlope };
+        for (int w = 0; w < 3; w++)
+        {
+            W.PutVector(Windows[w]->Values);
+            W.Put(Windows[w]->Head);
+            W.Put(Windows[w]->Count);
+            W.Put(Windows[w]->LastBarIndex);
+            W.Put(Windows[w]->Sum);
+        }
+
+        W.Put(Trade);
+        W.PutVector(StudyInts);
+        W.PutVector(CloseTail);
+        W.Put((uint32_t)SeriesTail.size());
+        for (size_t n = 0; n < SeriesTail.size(); n++)
+            W.PutVector(SeriesTail[n]);
+        W.PutVector(StudyData);
+    }
+
+    // False if the data is not a checkpoint of this version or is truncated
+    bool Deserialize(const char* Data, size_t Size)
+    {
+        s_MomentumByteReader R(Data, Size);
+
+        uint32_t Magic = 0, Version = 0;
+        R.Get(Magic);
+        R.Get(Version);
+        if (!R.Ok || Magic != MOMENTUM_CHECKPOINT_MAGIC || Version != MOMENTUM_CHECKPOINT_VERSION)
+            return false;
+
+        std::vector<char> KeyChars;
+        R.GetVector(KeyChars, 1024);
+        Key.assign(KeyChars.begin(), KeyChars.end());
+        R.Get(LastBarDateTime);
+        R.Get(LastBarIndex);
+        Params.SetDefaults();
+        for (int f = 0; f < NUM_MOMENTUM_PARAM_FIELDS; f++)
+        {
+            if (MOMENTUM_PARAM_FIELDS[f].FloatField != NULL)
+                R.Get(Params.*MOMENTUM_PARAM_FIELDS[f].FloatField);
+            else
+                R.Get(Params.*MOMENTUM_PARAM_FIELDS[f].IntField);
+        }
+        R.Get(Kernel);
+        R.Get(SessionVWAP);
+
+        s_RollingWindow<int>* Windows[] = { &Rolling.SmallSlope, &Rolling.NegSlope, &Rolling.PosSlope };
+        for (int w = 0; w < 3; w++)
+        {
+            R.GetVector(Windows[w]->Values, 1000000);
+            R.Get(Windows[w]->Head);
+            R.Get(Windows[w]->Count);
+            R.Get(Windows[w]->LastBarIndex);
+            R.Get(Windows[w]->Sum);
+
+            int Capacity = (int)Windows[w]->Values.size();
+            if (Capacity == 0 || Windows[w]->Count < 0 || Windows[w]->Count > Capacity
+                || Windows[w]->Head < -1 || Windows[w]->Head >= Capacity)
+                return false;
+        }
+
+        R.Get(Trade);
+        R.GetVector(StudyInts, 1024);
+        R.GetVector(CloseTail, MOMENTUM_CHECKPOINT_TAIL);
+
+        uint32_t NumSeries = 0;
+        R.Get(NumSeries);
+        if (!R.Ok || NumSeries > 256)
+            return false;
+
+        SeriesTail.resize(NumSeries);
+        for (uint32_t n = 0; n < NumSeries; n++)
+        {
+            R.GetVector(SeriesTail[n], MOMENTUM_CHECKPOINT_TAIL);
+            if (SeriesTail[n].size() != CloseTail.size())
+                return false;
+        }
+
+        R.GetVector(StudyData, 64 * 1024 * 1024);
+
+        return R.Ok && R.Position == Size;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Bar replay (backtesting outside Sierra Chart)
+// -----------------------------------------------------------------------------
+
+// Bar data in chart order. TradingDate is what sc.GetTradingDayDate returns
+// for the bar (any integer that changes once per trading day will do).
+struct s_MomentumBars
+{
+    std::vector<int> TradingDate;
+    std::vector<int> MinuteOfDay;
+    std::vector<double> DateTime;   // For reporting only
+    std::vector<float> Open;
+    std::vector<float> High;
+    std::vector<float> Low;
+    std::vector<float> Close;
+    std::vector<float> Volume;
+    std::vector<float> BidVolume;
+    std::vector<float> AskVolume;
+
+    int Size() const { return (int)Close.size(); }
+};
+
+// Per-bar values that depend only on the bars and ATR Length. Computed once
+// and read by every replay, whatever the other inputs are.
+struct s_MomentumFeatures
+{
+    int ATRLength;
+    std::vector<float> SMA100, EMA1000, EMA50, ATR, ATR20, RSI, CCISMA, CCI, ADX, MFI, StochK;
+    std::vector<float> VWAP;
+    std::vector<float> StdDev;
+    std::vector<float> Slope;
+    std::vector<int> Score;
+
+    // Replays only read the outputs, so a const feature set can be shared
+    // by several threads
+    s_MomentumSeries GetSeries(const s_MomentumBars& Bars) const
+    {
+        s_MomentumFeatures& F = const_cast<s_MomentumFeatures&>(*this);
+        s_MomentumSeries S;
+        S.High = Bars.High.data();
+        S.Low = Bars.Low.data();
+        S.Close = Bars.Close.data();
+        S.Volume = Bars.Volume.data();
+        S.SMA100 = F.SMA100.data();
+        S.EMA1000 = F.EMA1000.data();
+        S.EMA50 = F.EMA50.data();
+        S.ATR = F.ATR.data();
+        S.ATR20 = F.ATR20.data();
+        S.RSI = F.RSI.data();
+        S.CCISMA = F.CCISMA.data();
+        S.CCI = F.CCI.data();
+        S.ADX = F.ADX.data();
+        S.MFI = F.MFI.data();
+        S.StochK = F.StochK.data();
+        return S;
+    }
+};
+
+inline void MomentumBuildFeatures(const s_MomentumBars& Bars, int ATRLength, s_MomentumFeatures& F)
+{
+    int N = Bars.Size();
+    F.ATRLength = ATRLength;
+
+    std::vector<float>* Outputs[] = { &F.SMA100, &F.EMA1000, &F.EMA50, &F.ATR, &F.ATR20, &F.RSI, &F.CCISMA,
+        &F.CCI, &F.ADX, &F.MFI, &F.StochK, &F.VWAP, &F.StdDev, &F.Slope };
+    for (size_t k = 0; k < sizeof(Outputs) / sizeof(Outputs[0]); k++)
+        Outputs[k]->assign(N, 0.0f);
+    F.Score.assign(N, 0);
+
+    s_MomentumSeries S = F.GetSeries(Bars);
+    s_MomentumKernelState Kernel;
+    KernelSweep(Kernel, S, N, ATRLength);
+
+    s_SessionVWAPAccumulator SessionVWAP;
+    SessionVWAP.Reset(0, -1);
+
+    for (int i = 0; i < N; i++)
+    {
+        if (i == 0 || Bars.TradingDate[i] != SessionVWAP.SessionDate)
+            SessionVWAP.Reset(Bars.TradingDate[i], i);
+
+        while (SessionVWAP.FormingBarIndex < i)
+            SessionVWAP.Commit(Bars.Close[SessionVWAP.FormingBarIndex], Bars.Volume[SessionVWAP.FormingBarIndex]);
+
+        double VWAPValue = Bars.Close[i];
+        double StdDev = 0.0;
+        SessionVWAP.GetVWAP(Bars.Close[i], Bars.Volume[i], VWAPValue, StdDev);
+        F.VWAP[i] = (float)VWAPValue;
+        F.StdDev[i] = (float)StdDev;
+        F.Slope[i] = MomentumSlope(S.Close, i);
+
+        bool DeltaRising = (i > 0) && (Bars.AskVolume[i] - Bars.BidVolume[i] > 0);
+        F.Score[i] = MomentumScore(S, F.VWAP.data(), i, DeltaRising);
+    }
+}
+
+struct s_MomentumTradeResult
+{
+    int Direction;
+    int Setup;
+    int EntryIndex;
+    int ExitIndex;
+    int ExitReason;
+    double EntryPrice;
+    double ExitPrice;
+    double PnL;                 // Points, one contract
+};
+
+struct s_MomentumBacktestResult
+{
+    std::vector<s_MomentumTradeResult> Trades;
+    double NetPnL;
+    double PeakPnL;
+    double MaxDrawdown;
+    int Wins;
+    int Losses;
+    int SetupCounts[2][NUM_MOMENTUM_SETUPS];    // [0]=Long, [1]=Short
+
+    void Reset()
+    {
+        Trades.clear();
+        NetPnL = PeakPnL = MaxDrawdown = 0.0;
+        Wins = Losses = 0;
+        memset(SetupCounts, 0, sizeof(SetupCounts));
+    }
+
+    void AddTrade(const s_MomentumTrade& T, int ExitIndex, int ExitReason, double ExitPrice, bool KeepTrades)
+    {
+        s_MomentumTradeResult R;
+        R.Direction  = T.Direction;
+        R.Setup      = T.Setup;
+        R.EntryIndex = T.EntryIndex;
+        R.ExitIndex  = ExitIndex;
+        R.ExitReason = ExitReason;
+        R.EntryPrice = T.EntryPrice;
+        R.ExitPrice  = ExitPrice;
+        R.PnL        = (ExitPrice - T.EntryPrice) * T.Direction;
+
+        NetPnL += R.PnL;
+        if (NetPnL > PeakPnL) PeakPnL = NetPnL;
+        if (PeakPnL - NetPnL > MaxDrawdown) MaxDrawdown = PeakPnL - NetPnL;
+        if (R.PnL > 0) Wins++; else Losses++;
+
+        if (KeepTrades)
+            Trades.push_back(R);
+    }
+};
+
+// Replays the study's per-bar flow over closed bars. AllowSignalsInTrade
+// reproduces how the chart draws history on a full recalculation (signals
+// are not blocked by an open virtual trade); off, it behaves like live
+// trading, where an open trade blocks new signals.
+struct s_MomentumEngine
+{
+    s_MomentumParams Params;
+    bool AllowSignalsInTrade;
+    bool KeepTrades;
+    s_MomentumTrade Trade;
+    s_MomentumRollingState Rolling;
+    int LastDayDate;
+
+    void Reset(const s_MomentumParams& P)
+    {
+        Params = P;
+        Trade.Reset();
+        Rolling.Reset(P.ChopLookback);
+        LastDayDate = -1;
+    }
+
+    void ProcessBar(const s_MomentumBars& Bars, const s_MomentumFeatures& F, const s_MomentumSeries& S, int i, s_MomentumBacktestResult& Result)
+    {
+        // New trading day: the study resets the virtual trade
+        if (Bars.TradingDate[i] != LastDayDate)
+        {
+            if (Trade.Direction != 0 && i > 0)
+                Result.AddTrade(Trade, i - 1, EXIT_SESSION_RESET, Bars.Close[i - 1], KeepTrades);
+
+            Trade.Direction = 0;
+            LastDayDate = Bars.TradingDate[i];
+        }
+
+        // Chop windows (rebuild if the replay does not continue from the last bar)
+        if (Rolling.SmallSlope.Count > 0 && i != Rolling.SmallSlope.LastBarIndex + 1)
+            Rolling.Reset(Params.ChopLookback);
+        if (Rolling.SmallSlope.Count == 0)
+        {
+            for (int k = (i - Params.ChopLookback + 1 > 0 ? i - Params.ChopLookback + 1 : 0); k < i; k++)
+                PushSlope(Rolling, k, F.Slope[k]);
+        }
+        PushSlope(Rolling, i, F.Slope[i]);
+
+        // Exits
+        if (Trade.Direction != 0)
+        {
+            s_MomentumTrade Open = Trade;
+            double ExitPrice;
+            int Reason = MomentumCheckExit(Trade, Params, Bars.High[i], Bars.Low[i], Bars.Close[i], F.ATR[i], i, ExitPrice);
+            if (Reason != EXIT_NONE)
+                Result.AddTrade(Open, i, Reason, ExitPrice, KeepTrades);
+        }
+
+        // Signal gates. The chop state, bar context and rules are only worked
+        // out for bars that get past them.
+        if (!AllowSignalsInTrade && Trade.Direction != 0)
+            return;
+        if ((i - Trade.LastSignalIndex) < Params.MinBarsBetweenTrades)
+            return;
+
+        s_MomentumChop Chop = MomentumChopState(Rolling, Params);
+        s_MomentumBarContext B;
+        MomentumBuildContext(B, S, Bars.Open.data(), F.VWAP.data(), F.StdDev[i], F.Slope[i], F.Score[i], Chop, i, Bars.MinuteOfDay[i]);
+
+        s_MomentumSignal Signal = MomentumEvaluateSignal(B, Params);
+        if (Signal.Direction == 0)
+            return;
+
+        if (Trade.Direction != 0)
+            Result.AddTrade(Trade, i, EXIT_REPLACED, Bars.Close[i], KeepTrades);
+
+        Result.SetupCounts[Signal.Direction == 1 ? 0 : 1][Signal.Setup]++;
+        MomentumOpenTrade(Trade, Signal, Bars.Close[i], F.ATR[i], Params, i);
+    }
+
+    // Closes a trade still open after the last replayed bar
+    void Finish(const s_MomentumBars& Bars, int LastIndex, s_MomentumBacktestResult& Result)
+    {
+        if (Trade.Direction != 0 && LastIndex >= 0)
+        {
+            Result.AddTrade(Trade, LastIndex, EXIT_END_OF_DATA, Bars.Close[LastIndex], KeepTrades);
+            Trade.Direction = 0;
+        }
+    }
+};
+
+// Continues an engine (fresh from Reset, or a copy taken at an earlier
+// checkpoint) over bars [Begin, End). Open trades are left open.
+inline void MomentumRunEngine(s_MomentumEngine& Engine, const s_MomentumBars& Bars, const s_MomentumFeatures& F,
+    int Begin, int End, s_MomentumBacktestResult& Result)
+{
+    s_MomentumSeries S = F.GetSeries(Bars);
+    for (int i = Begin; i < End; i++)
+        Engine.ProcessBar(Bars, F, S, i, Result);
+}
+
+// Replays bars [Begin, End) with one parameter set. F must have been built
+// with P.ATRLength. Checkpoint, if given, receives the engine state after
+// the last bar, before any open trade is closed, so a later slice can resume
+// from it instead of replaying from the first bar.
+inline void MomentumRunBacktest(const s_MomentumBars& Bars, const s_MomentumFeatures& F, const s_MomentumParams& P,
+    int Begin, int End, bool AllowSignalsInTrade, bool KeepTrades, s_MomentumBacktestResult& Result,
+    s_MomentumEngine* Checkpoint = NULL)
+{
+    s_MomentumEngine Engine;
+    Engine.AllowSignalsInTrade = AllowSignalsInTrade;
+    Engine.KeepTrades = KeepTrades;
+    Engine.Reset(P);
+    Result.Reset();
+
+    MomentumRunEngine(Engine, Bars, F, Begin, End, Result);
+
+    if (Checkpoint != NULL)
+        *Checkpoint = Engine;
+
+    Engine.Finish(Bars, End - 1, Result);
+}
+
+#endif // MOMENTUM_BOT_CORE_H
@@ -0,0 +1,385 @@
+#ifndef MOMENTUM_BOT_STATS_H
+#define MOMENTUM_BOT_STATS_H
+
+/*
+    Distribution statistics for the Momentum Bot.
+
+    Per trading day, a histogram of Price Slope over configurable bucket edges
+    and a count of signals per setup and direction. Counting a bar is a bucket
+    search and an increment; nothing is formatted in the study.
+
+    When a trading day ends the study hands a fixed-size row to
+    s_MomentumStatsWriter, whose background thread formats it and appends it
+    to a CSV file. The day in progress is written once, marked incomplete,
+    when the study stops. A writer that appends to the file after a resume
+    first drops the rows from the resumed day on, so each date has one row.
+
+    Platform independent, like momentum_bot_core.h.
+*/
+
+#include "momentum_bot_core.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+const int MOMENTUM_STATS_MAX_EDGES = 31;
+const char* const MOMENTUM_STATS_DEFAULT_EDGES = "-0.08,-0.05,0,0.05,0.08";
+
+// -----------------------------------------------------------------------------
+// Histogram
+// -----------------------------------------------------------------------------
+
+// Bucket 0 holds values below Edges[0], bucket k values in
+// [Edges[k-1], Edges[k]) and the last bucket values >= the last edge
+struct s_MomentumHistogram
+{
+    int NumEdges;
+    float Edges[MOMENTUM_STATS_MAX_EDGES];
+    uint32_t Counts[MOMENTUM_STATS_MAX_EDGES + 1];
+    uint32_t Total;
+    float Min;
+    float Max;
+
+    int NumBuckets() const { return NumEdges + 1; }
+
+    // Comma separated, strictly ascending. Returns false, leaving the edges
+    // unchanged, if Text is not a valid list.
+    bool SetEdges(const char* Text)
+    {
+        float Parsed[MOMENTUM_STATS_MAX_EDGES];
+        int Count = 0;
+
+        const char* p = Text;
+        while (*p != '\0')
+        {
+            char* End;
+            double Value = strtod(p, &End);
+            if (End == p || Count == MOMENTUM_STATS_MAX_EDGES)
+                return false;
+            if (Count > 0 && (float)Value <= Parsed[Count - 1])
+                return false;
+            Parsed[Count++] = (float)Value;
+
+            p = End;
+            while (*p == ' ')
+                p++;
+            if (*p == ',')
+                p++;
+            else if (*p != '\0')
+                return false;
+        }
+
+        if (Count == 0)
+            return false;
+
+        NumEdges = Count;
+        memcpy(Edges, Parsed, sizeof(float) * Count);
+        Clear();
+        return true;
+    }
+
+    void Clear()
+    {
+        memset(Counts, 0, sizeof(Counts));
+        Total = 0;
+        Min = 0.0f;
+        Max = 0.0f;
+    }
+
+    void Add(float Value)
+    {
+        int Bucket = (int)(std::upper_bound(Edges, Edges + NumEdges, Value) - Edges);
+        Counts[Bucket]++;
+
+        if (Total == 0 || Value < Min) Min = Value;
+        if (Total == 0 || Value > Max) Max = Value;
+        Total++;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Daily statistics
+// -----------------------------------------------------------------------------
+
+// One CSV row. Plain data: the study copies counts, the writer formats them.
+struct s_MomentumStatsRow
+{
+    int TradingDate;            // Days since 1899-12-30 (SCDateTime date)
+    int Complete;               // 0 = day still in progress
+    s_MomentumHistogram Slope;
+    uint32_t SetupCounts[2][NUM_MOMENTUM_SETUPS];   // [0]=Long, [1]=Short
+};
+
+struct s_MomentumDayStats
+{
+    int TradingDate;
+    int LastBarIndex;           // Last bar counted, so a bar is never counted twice
+    s_MomentumHistogram Slope;
+    uint32_t SetupCounts[2][NUM_MOMENTUM_SETUPS];
+
+    // Edges that fail to parse fall back to the defaults
+    void Reset(const char* EdgesText)
+    {
+        if (!Slope.SetEdges(EdgesText))
+            Slope.SetEdges(MOMENTUM_STATS_DEFAULT_EDGES);
+
+        TradingDate = 0;
+        LastBarIndex = -1;
+        memset(SetupCounts, 0, sizeof(SetupCounts));
+    }
+
+    // Counts one closed bar. Returns true when the bar starts a new trading
+    // day, after copying the finished day into Finished.
+    bool AddBar(int Index, int Date, float PriceSlope, s_MomentumStatsRow& Finished)
+    {
+        if (Index <= LastBarIndex)
+            return false;
+        LastBarIndex = Index;
+
+        bool NewDay = (Date != TradingDate && Slope.Total > 0);
+        if (NewDay)
+            GetRow(Finished, true);
+
+        if (Date != TradingDate)
+        {
+            TradingDate = Date;
+            Slope.Clear();
+            memset(SetupCounts, 0, sizeof(SetupCounts));
+        }
+
+        Slope.Add(PriceSlope);
+        return NewDay;
+    }
+
+    void AddSignal(int Direction, int Setup)
+    {
+        SetupCounts[Direction == 1 ? 0 : 1][Setup]++;
+    }
+
+    void GetRow(s_MomentumStatsRow& Row, bool Complete) const
+    {
+        Row.TradingDate = TradingDate;
+        Row.Complete = Complete ? 1 : 0;
+        Row.Slope = Slope;
+        memcpy(Row.SetupCounts, SetupCounts, sizeof(SetupCounts));
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Background CSV writer
+// -----------------------------------------------------------------------------
+
+// Proleptic Gregorian date of an SCDateTime day number
+inline void MomentumCivilFromSCDate(int SCDate, int& Year, int& Month, int& Day)
+{
+    // Shift to days since 0000-03-01
+    int z = SCDate + 693899;
+    int Era = (z >= 0 ? z : z - 146096) / 146097;
+    int DayOfEra = z - Era * 146097;
+    int YearOfEra = (DayOfEra - DayOfEra / 1460 + DayOfEra / 36524 - DayOfEra / 146096) / 365;
+    int DayOfYear = DayOfEra - (365 * YearOfEra + YearOfEra / 4 - YearOfEra / 100);
+    int MonthIndex = (5 * DayOfYear + 2) / 153;
+
+    Day = DayOfYear - (153 * MonthIndex + 2) / 5 + 1;
+    Month = MonthIndex < 10 ? MonthIndex + 3 : MonthIndex - 9;
+    Year = YearOfEra + Era * 400 + (Month <= 2 ? 1 : 0);
+}
+
+struct s_MomentumStatsWriter
+{
+    std::thread Thread;
+    std::mutex Lock;
+    std::condition_variable Wake;
+    std::deque<s_MomentumStatsRow> Pending;
+    bool Stopping;
+    bool Running;
+
+    s_MomentumStatsWriter() : Stopping(false), Running(false) {}
+    ~s_MomentumStatsWriter() { Stop(); }
+
+    // Starts the writer thread on Path. Append keeps the rows already in the
+    // file dated before AppendFromDate (an SCDateTime date, 0 keeps them
+    // all); otherwise it is rewritten from the start. The header line is
+    // written whenever the file starts out empty.
+    void Start(const std::string& Path, bool Append, int AppendFromDate = 0)
+    {
+        Stop();
+
+        Stopping = false;
+        Running = true;
+        Thread = std::thread(&s_MomentumStatsWriter::Run, this, Path, Append, AppendFromDate);
+    }
+
+    // Writes out the rows already queued, then ends the thread
+    void Stop()
+    {
+        if (!Running)
+            return;
+
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+            Stopping = true;
+        }
+        Wake.notify_one();
+        Thread.join();
+
+        Running = false;
+        Pending.clear();
+    }
+
+    void Push(const s_MomentumStatsRow& Row)
+    {
+        if (!Running)
+            return;
+
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+            Pending.push_back(Row);
+        }
+        Wake.notify_one();
+    }
+
+    static void WriteHeader(FILE* File, const s_MomentumHistogram& Slope)
+    {
+        fprintf(File, "Date,Complete,Bars,MinSlope,MaxSlope");
+        for (int b = 0; b < Slope.NumBuckets(); b++)
+        {
+            if (b == 0)
+                fprintf(File, ",Slope_lt_%g", Slope.Edges[0]);
+            else if (b == Slope.NumEdges)
+                fprintf(File, ",Slope_ge_%g", Slope.Edges[b - 1]);
+            else
+                fprintf(File, ",Slope_%g_to_%g", Slope.Edges[b - 1], Slope.Edges[b]);
+        }
+        for (int d = 0; d < 2; d++)
+        {
+            for (int k = 0; k < NUM_MOMENTUM_SETUPS; k++)
+                fprintf(File, ",%s_%s", d == 0 ? "Long" : "Short", MOMENTUM_SETUP_LABELS[k]);
+        }
+        fprintf(File, "\n");
+    }
+
+    static void WriteRow(FILE* File, const s_MomentumStatsRow& Row)
+    {
+        int Year, Month, Day;
+        MomentumCivilFromSCDate(Row.TradingDate, Year, Month, Day);
+
+        fprintf(File, "%04d-%02d-%02d,%d,%u,%.4f,%.4f", Year, Month, Day, Row.Complete,
+            Row.Slope.Total, Row.Slope.Min, Row.Slope.Max);
+        for (int b = 0; b < Row.Slope.NumBuckets(); b++)
+            fprintf(File, ",%u", Row.Slope.Counts[b]);
+        for (int d = 0; d < 2; d++)
+        {
+            for (int k = 0; k < NUM_MOMENTUM_SETUPS; k++)
+                fprintf(File, ",%u", Row.SetupCounts[d][k]);
+        }
+        fprintf(File, "\n");
+    }
+
+    // Removes the rows at the end of the file at Path dated on or after
+    // FromDate. Rows are in date order and start with the date as
+    // YYYY-MM-DD, which sorts as text.
+    static void DropRowsFrom(const std::string& Path, int FromDate)
+    {
+        FILE* File = fopen(Path.c_str(), "rb");
+        if (File == NULL)
+            return;
+
+        std::string Text;
+        char Buffer[4096];
+        size_t Read;
+        while ((Read = fread(Buffer, 1, sizeof(Buffer), File)) > 0)
+            Text.append(Buffer, Read);
+        fclose(File);
+
+        int Year, Month, Day;
+        MomentumCivilFromSCDate(FromDate, Year, Month, Day);
+        char FromText[16];
+        snprintf(FromText, sizeof(FromText), "%04d-%02d-%02d", Year, Month, Day);
+
+        size_t Keep = Text.size();
+        while (Keep > 0)
+        {
+            size_t LineEnd = (Text[Keep - 1] == '\n') ? Keep - 1 : Keep;
+            size_t LineBegin = (LineEnd == 0) ? std::string::npos : Text.rfind('\n', LineEnd - 1);
+            LineBegin = (LineBegin == std::string::npos) ? 0 : LineBegin + 1;
+
+            // The header does not start with a digit
+            if (LineEnd - LineBegin < 10 || Text[LineBegin] < '0' || Text[LineBegin] > '9'
+                || Text.compare(LineBegin, 10, FromText) < 0)
+                break;
+            Keep = LineBegin;
+        }
+
+        if (Keep == Text.size())
+            return;
+
+        File = fopen(Path.c_str(), "wb");
+        if (File == NULL)
+            return;
+        fwrite(Text.data(), 1, Keep, File);
+        fclose(File);
+    }
+
+    void Run(std::string Path, bool Append, int AppendFromDate)
+    {
+        if (Append && AppendFromDate > 0)
+            DropRowsFrom(Path, AppendFromDate);
+
+        FILE* File = fopen(Path.c_str(), Append ? "ab" : "wb");
+        bool NeedHeader = false;
+        if (File != NULL)
+        {
+            fseek(File, 0, SEEK_END);
+            NeedHeader = (ftell(File) == 0);
+        }
+
+        std::deque<s_MomentumStatsRow> Batch;
+        for (;;)
+        {
+            bool Done;
+            {
+                std::unique_lock<std::mutex> Guard(Lock);
+                Wake.wait(Guard, [this]() { return Stopping || !Pending.empty(); });
+                Batch.swap(Pending);
+                Done = Stopping;
+            }
+
+            if (File != NULL)
+            {
+                for (size_t r = 0; r < Batch.size(); r++)
+                {
+                    if (NeedHeader)
+                    {
+                        WriteHeader(File, Batch[r].Slope);
+                        NeedHeader = false;
+                    }
+                    WriteRow(File, Batch[r]);
+                }
+                fflush(File);
+            }
+            Batch.clear();
+
+            if (Done)
+                break;
+        }
+
+        if (File != NULL)
+            fclose(File);
+    }
+};
+
+// What the study keeps behind its persistent pointer
+struct s_MomentumStatsSink
+{
+    s_MomentumDayStats Day;
+    s_MomentumStatsWriter Writer;
+};
+
+#endif // MOMENTUM_BOT_STATS_H
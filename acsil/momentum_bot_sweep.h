@@ -0,0 +1,356 @@
+#ifndef MOMENTUM_BOT_SWEEP_H
+#define MOMENTUM_BOT_SWEEP_H
+
+/*
+    Parameter sweeps for the Momentum Bot core (momentum_bot_core.h).
+
+    A sweep is a list of parameter sets, built as a grid or drawn at random
+    from per-input ranges. Each set is one task. Tasks run on all cores through
+    a small work-stealing scheduler: every worker owns a deque, pops from its
+    back and, once empty, steals from the front of the others. Replays with a
+    large MinBarsBetweenTrades or a short slice finish much faster than others,
+    so static partitioning leaves cores idle.
+
+    Indicator features depend only on the bars and ATR Length. They are built
+    once per distinct ATR Length and shared read-only by every worker.
+*/
+
+#include "momentum_bot_core.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+// -----------------------------------------------------------------------------
+// Work-stealing scheduler
+// -----------------------------------------------------------------------------
+
+struct s_WorkStealingQueue
+{
+    std::mutex Lock;
+    std::deque<int> Tasks;
+
+    bool PopBack(int& Task)
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        if (Tasks.empty())
+            return false;
+
+        Task = Tasks.back();
+        Tasks.pop_back();
+        return true;
+    }
+
+    bool StealFront(int& Task)
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+        if (Tasks.empty())
+            return false;
+
+        Task = Tasks.front();
+        Tasks.pop_front();
+        return true;
+    }
+};
+
+// Runs Body(Task) for Task in [0, NumTasks) on NumThreads workers. Tasks are
+// all known up front, so a worker that finds every queue empty is done.
+inline void MomentumParallelFor(int NumTasks, int NumThreads, const std::function<void(int)>& Body)
+{
+    if (NumThreads < 1)
+        NumThreads = 1;
+    if (NumThreads > NumTasks)
+        NumThreads = NumTasks;
+    if (NumTasks <= 0)
+        return;
+
+    if (NumThreads == 1)
+    {
+        for (int t = 0; t < NumTasks; t++)
+            Body(t);
+        return;
+    }
+
+    // Contiguous blocks keep neighbouring sets (same ATR Length, similar
+    // inputs) on the same worker until stealing starts
+    std::vector<s_WorkStealingQueue> Queues(NumThreads);
+    for (int w = 0; w < NumThreads; w++)
+    {
+        int First = (int)((long long)NumTasks * w / NumThreads);
+        int Last = (int)((long long)NumTasks * (w + 1) / NumThreads);
+        for (int t = First; t < Last; t++)
+            Queues[w].Tasks.push_back(t);
+    }
+
+    std::vector<std::thread> Workers;
+    for (int w = 0; w < NumThreads; w++)
+    {
+        Workers.push_back(std::thread([&Queues, &Body, NumThreads, w]()
+        {
+            int Task;
+            for (;;)
+            {
+                if (Queues[w].PopBack(Task))
+                {
+                    Body(Task);
+                    continue;
+                }
+
+                bool Stole = false;
+                for (int v = 1; v < NumThreads && !Stole; v++)
+                    Stole = Queues[(w + v) % NumThreads].StealFront(Task);
+
+                if (!Stole)
+                    return;
+
+                Body(Task);
+            }
+        }));
+    }
+
+    for (size_t w = 0; w < Workers.size(); w++)
+        Workers[w].join();
+}
+
+// -----------------------------------------------------------------------------
+// Parameter sets
+// -----------------------------------------------------------------------------
+
+// One swept input: Min..Max in steps of Step (Step <= 0 means continuous for
+// random draws and a single value for grids)
+struct s_MomentumSweepRange
+{
+    const s_MomentumParamField* Field;
+    double Min;
+    double Max;
+    double Step;
+
+    int NumSteps() const
+    {
+        if (Step <= 0 || Max <= Min)
+            return 1;
+
+        return (int)floor((Max - Min) / Step + 1e-9) + 1;
+    }
+};
+
+// Every combination of the ranges applied on top of Base. The first range
+// varies slowest.
+inline void MomentumBuildGrid(const s_MomentumParams& Base, const std::vector<s_MomentumSweepRange>& Ranges, std::vector<s_MomentumParams>& Sets)
+{
+    Sets.clear();
+
+    long long Total = 1;
+    for (size_t r = 0; r < Ranges.size(); r++)
+        Total *= Ranges[r].NumSteps();
+
+    Sets.reserve((size_t)Total);
+    for (long long n = 0; n < Total; n++)
+    {
+        s_MomentumParams P = Base;
+        long long Rest = n;
+        for (int r = (int)Ranges.size() - 1; r >= 0; r--)
+        {
+            int Steps = Ranges[r].NumSteps();
+            int k = (int)(Rest % Steps);
+            Rest /= Steps;
+            MomentumSetParam(P, *Ranges[r].Field, Ranges[r].Min + k * Ranges[r].Step);
+        }
+        Sets.push_back(P);
+    }
+}
+
+// Count sets drawn uniformly from the ranges, snapped to Step when it is set
+inline void MomentumBuildRandom(const s_MomentumParams& Base, const std::vector<s_MomentumSweepRange>& Ranges, int Count, unsigned Seed, std::vector<s_MomentumParams>& Sets)
+{
+    Sets.clear();
+    Sets.reserve(Count);
+
+    std::mt19937 Generator(Seed);
+    for (int n = 0; n < Count; n++)
+    {
+        s_MomentumParams P = Base;
+        for (size_t r = 0; r < Ranges.size(); r++)
+        {
+            const s_MomentumSweepRange& R = Ranges[r];
+            double Value;
+            if (R.Step > 0)
+            {
+                std::uniform_int_distribution<int> Pick(0, R.NumSteps() - 1);
+                Value = R.Min + Pick(Generator) * R.Step;
+            }
+            else
+            {
+                std::uniform_real_distribution<double> Pick(R.Min, R.Max);
+                Value = Pick(Generator);
+            }
+            MomentumSetParam(P, *R.Field, Value);
+        }
+        Sets.push_back(P);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Sweep
+// -----------------------------------------------------------------------------
+
+// Features keyed by ATR Length, the only input they depend on
+struct s_MomentumFeatureSet
+{
+    std::map<int, s_MomentumFeatures> ByATRLength;
+
+    // Builds the features for every ATR Length the sets use, in parallel
+    void Build(const s_MomentumBars& Bars, const std::vector<s_MomentumParams>& Sets, int NumThreads)
+    {
+        std::vector<int> Missing;
+        for (size_t s = 0; s < Sets.size(); s++)
+        {
+            int Length = Sets[s].ATRLength;
+            if (ByATRLength.find(Length) == ByATRLength.end())
+            {
+                ByATRLength[Length].ATRLength = Length;
+                Missing.push_back(Length);
+            }
+        }
+
+        // Map nodes are stable, so workers can fill them without locking
+        std::vector<s_MomentumFeatures*> Targets;
+        for (size_t m = 0; m < Missing.size(); m++)
+            Targets.push_back(&ByATRLength[Missing[m]]);
+
+        MomentumParallelFor((int)Targets.size(), NumThreads, [&](int t)
+        {
+            MomentumBuildFeatures(Bars, Targets[t]->ATRLength, *Targets[t]);
+        });
+    }
+
+    const s_MomentumFeatures& Get(int ATRLength) const
+    {
+        return ByATRLength.find(ATRLength)->second;
+    }
+};
+
+struct s_MomentumSweepResult
+{
+    int SetIndex;
+    s_MomentumBacktestResult Result;
+};
+
+// Replays bars [Begin, End) once per parameter set. Results are in set order.
+// Checkpoints, if given, receives each set's engine state at End.
+inline void MomentumRunSweep(const s_MomentumBars& Bars, const s_MomentumFeatureSet& Features,
+    const std::vector<s_MomentumParams>& Sets, int Begin, int End, bool AllowSignalsInTrade, int NumThreads,
+    std::vector<s_MomentumSweepResult>& Results, std::vector<s_MomentumEngine>* Checkpoints = NULL)
+{
+    Results.assign(Sets.size(), s_MomentumSweepResult());
+    if (Checkpoints != NULL)
+        Checkpoints->resize(Sets.size());
+
+    MomentumParallelFor((int)Sets.size(), NumThreads, [&](int s)
+    {
+        Results[s].SetIndex = s;
+        MomentumRunBacktest(Bars, Features.Get(Sets[s].ATRLength), Sets[s], Begin, End, AllowSignalsInTrade, false,
+            Results[s].Result, Checkpoints != NULL ? &(*Checkpoints)[s] : NULL);
+    });
+}
+
+// Best first: higher net PnL, then smaller drawdown
+inline bool MomentumSweepBetter(const s_MomentumSweepResult& A, const s_MomentumSweepResult& B)
+{
+    if (A.Result.NetPnL != B.Result.NetPnL)
+        return A.Result.NetPnL > B.Result.NetPnL;
+    if (A.Result.MaxDrawdown != B.Result.MaxDrawdown)
+        return A.Result.MaxDrawdown < B.Result.MaxDrawdown;
+    return A.SetIndex < B.SetIndex;
+}
+
+inline void MomentumRankSweep(std::vector<s_MomentumSweepResult>& Results)
+{
+    std::sort(Results.begin(), Results.end(), MomentumSweepBetter);
+}
+
+// -----------------------------------------------------------------------------
+// Walk-forward
+// -----------------------------------------------------------------------------
+
+// First bar of every trading day
+inline void MomentumTradingDayStarts(const s_MomentumBars& Bars, std::vector<int>& Starts)
+{
+    Starts.clear();
+    for (int i = 0; i < Bars.Size(); i++)
+    {
+        if (i == 0 || Bars.TradingDate[i] != Bars.TradingDate[i - 1])
+            Starts.push_back(i);
+    }
+}
+
+struct s_MomentumWalkForwardWindow
+{
+    int InBegin;                // Bar ranges, [Begin, End)
+    int InEnd;
+    int OutBegin;
+    int OutEnd;
+    int BestSet;                // Index into the parameter sets
+    s_MomentumBacktestResult InSample;      // Of the best set
+    s_MomentumBacktestResult OutOfSample;
+};
+
+// Rolling windows of InDays trading days optimized over Sets, each followed
+// by OutDays scored with the winner. Windows step by OutDays, so the
+// out-of-sample slices tile the history after the first in-sample slice.
+//
+// Features cover the whole history and are shared by every window; the
+// out-of-sample replay resumes from the winner's in-sample checkpoint (chop
+// windows, signal spacing), so no window replays bars before its own start
+// and the total cost stays linear in the history length.
+inline void MomentumWalkForward(const s_MomentumBars& Bars, const s_MomentumFeatureSet& Features,
+    const std::vector<s_MomentumParams>& Sets, int InDays, int OutDays, bool AllowSignalsInTrade, int NumThreads,
+    std::vector<s_MomentumWalkForwardWindow>& Windows)
+{
+    Windows.clear();
+
+    std::vector<int> Starts;
+    MomentumTradingDayStarts(Bars, Starts);
+    int NumDays = (int)Starts.size();
+    Starts.push_back(Bars.Size());
+
+    std::vector<s_MomentumSweepResult> Results;
+    std::vector<s_MomentumEngine> Checkpoints;
+
+    for (int FirstDay = 0; FirstDay + InDays < NumDays; FirstDay += OutDays)
+    {
+        s_MomentumWalkForwardWindow W;
+        W.InBegin  = Starts[FirstDay];
+        W.InEnd    = Starts[FirstDay + InDays];
+        W.OutBegin = W.InEnd;
+        W.OutEnd   = Starts[(FirstDay + InDays + OutDays < NumDays) ? FirstDay + InDays + OutDays : NumDays];
+
+        MomentumRunSweep(Bars, Features, Sets, W.InBegin, W.InEnd, AllowSignalsInTrade, NumThreads, Results, &Checkpoints);
+
+        int Best = 0;
+        for (int s = 1; s < (int)Results.size(); s++)
+        {
+            if (MomentumSweepBetter(Results[s], Results[Best]))
+                Best = s;
+        }
+        W.BestSet = Best;
+        W.InSample = Results[Best].Result;
+
+        // The in-sample result already closed its open trade at the boundary
+        s_MomentumEngine Engine = Checkpoints[Best];
+        Engine.KeepTrades = true;
+        Engine.Trade.Direction = 0;
+
+        W.OutOfSample.Reset();
+        MomentumRunEngine(Engine, Bars, Features.Get(Sets[Best].ATRLength), W.OutBegin, W.OutEnd, W.OutOfSample);
+        Engine.Finish(Bars, W.OutEnd - 1, W.OutOfSample);
+
+        Windows.push_back(W);
+    }
+}
+
+#endif // MOMENTUM_BOT_SWEEP_H
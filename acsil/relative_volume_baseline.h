@@ -0,0 +1,367 @@
+#ifndef RELATIVE_VOLUME_BASELINE_H
+#define RELATIVE_VOLUME_BASELINE_H
+
+/*
+    Time-of-day volume baseline for the Relative Volume study.
+
+    A session is divided into fixed slots, one bar period each but at least
+    RVOL_MIN_SLOT_SECONDS, so a session has at most 1440 slots. For every
+    completed session the table keeps a row of cumulative volume through
+    each slot, and for the last LookbackSessions rows it keeps per-slot
+    running sums. The averages the study plots are then a lookup per bar:
+    - cumulative volume through slot s,
+    - volume of slot s alone,
+    - full session volume.
+    A row is added, and the oldest one dropped, only when a session
+    completes. Sessions without volume at a slot do not count towards that
+    slot's average.
+
+    Each slot also keeps a quantile sketch of the same cumulative and slot
+    volumes, so a median or percentile rank is a lookup too, and FOMC or
+    rollover days do not drag it like they drag the mean.
+
+    s_RVolSessionDirectory splits the bars into sessions in one forward
+    pass. Platform independent.
+*/
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// Quantile sketch
+// -----------------------------------------------------------------------------
+
+const int RVOL_SKETCH_BUCKETS = 512;
+const double RVOL_SKETCH_GAMMA = 1.05;      // Bucket width ratio: quantiles within ~2.5%
+const double RVOL_SKETCH_MIN = 0.01;        // Top of bucket 0; the top bucket starts near 7e8
+
+// Log-bucket sketch (as in DDSketch): bucket b counts the values in
+// (MIN * GAMMA^(b-1), MIN * GAMMA^b]. Memory is fixed however many values
+// it holds, two sketches merge by adding counts, and unlike t-digest or KLL
+// a value can be removed exactly, which the sliding lookback needs.
+struct s_RVolSketch
+{
+    uint16_t Counts[RVOL_SKETCH_BUCKETS];
+    int Total;
+
+    void Clear()
+    {
+        memset(Counts, 0, sizeof(Counts));
+        Total = 0;
+    }
+
+    // Position of Value in buckets: bucket b spans (b - 1, b]
+    static double GetBucketPosition(double Value)
+    {
+        static const double InvLogGamma = 1.0 / log(RVOL_SKETCH_GAMMA);
+        return log(Value / RVOL_SKETCH_MIN) * InvLogGamma;
+    }
+
+    static int GetBucket(double Value)
+    {
+        if (Value <= RVOL_SKETCH_MIN)
+            return 0;
+        int Bucket = (int)ceil(GetBucketPosition(Value));
+        return Bucket < RVOL_SKETCH_BUCKETS ? Bucket : RVOL_SKETCH_BUCKETS - 1;
+    }
+
+    // Value with the same relative error to both ends of the bucket
+    static double GetBucketValue(int Bucket)
+    {
+        return RVOL_SKETCH_MIN * pow(RVOL_SKETCH_GAMMA, Bucket) * 2.0 / (RVOL_SKETCH_GAMMA + 1.0);
+    }
+
+    // Adds (Sign = 1) or removes (Sign = -1) a value
+    void Add(double Value, int Sign)
+    {
+        Counts[GetBucket(Value)] += Sign;
+        Total += Sign;
+    }
+
+    void Merge(const s_RVolSketch& Other)
+    {
+        for (int b = 0; b < RVOL_SKETCH_BUCKETS; b++)
+            Counts[b] += Other.Counts[b];
+        Total += Other.Total;
+    }
+
+    // Value at quantile q (0.5 = median), 0 if empty
+    double GetQuantile(double q) const
+    {
+        if (Total == 0)
+            return 0.0;
+
+        int Target = (int)(q * (Total - 1));
+        int Below = 0;
+        for (int b = 0; b < RVOL_SKETCH_BUCKETS; b++)
+        {
+            Below += Counts[b];
+            if (Below > Target)
+                return GetBucketValue(b);
+        }
+        return GetBucketValue(RVOL_SKETCH_BUCKETS - 1);
+    }
+
+    // Percentage of the values below Value. Values in its own bucket are
+    // taken as spread evenly (in log terms) over the bucket. 0 if empty.
+    float GetPercentRank(double Value) const
+    {
+        if (Total == 0)
+            return 0.0f;
+
+        int Bucket = GetBucket(Value);
+        int Below = 0;
+        for (int b = 0; b < Bucket; b++)
+            Below += Counts[b];
+
+        double Fraction = 0.5;
+        if (Bucket > 0 && Bucket < RVOL_SKETCH_BUCKETS - 1)
+            Fraction = GetBucketPosition(Value) - (Bucket - 1);
+
+        return (float)(100.0 * (Below + Fraction * Counts[Bucket]) / Total);
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Session directory
+// -----------------------------------------------------------------------------
+
+struct s_RVolSession
+{
+    int Date;           // Date the session starts on
+    int StartIndex;     // First bar
+    int EndIndex;       // Last bar added so far
+};
+
+// Sessions start at StartSeconds into the day, so a bar before that time
+// belongs to the session that started the day before (18:00 start: Monday
+// 09:30 is in Sunday's session). Sessions exist only where there are bars,
+// so holidays are skipped and a half day simply ends early.
+struct s_RVolSessionDirectory
+{
+    int StartSeconds;
+    std::vector<s_RVolSession> Sessions;    // Oldest first
+
+    void Reset(int SessionStartSeconds)
+    {
+        StartSeconds = SessionStartSeconds;
+        Sessions.clear();
+    }
+
+    int GetSessionDate(int Date, int TimeInSeconds) const
+    {
+        return TimeInSeconds >= StartSeconds ? Date : Date - 1;
+    }
+
+    // Seconds from the start of the session on SessionDate
+    int GetSecondsIntoSession(int SessionDate, int Date, int TimeInSeconds) const
+    {
+        return (Date - SessionDate) * 86400 + TimeInSeconds - StartSeconds;
+    }
+
+    // Adds the next bar. Returns true if it starts a new session.
+    bool AddBar(int Index, int Date, int TimeInSeconds)
+    {
+        int SessionDate = GetSessionDate(Date, TimeInSeconds);
+        if (!Sessions.empty() && Sessions.back().Date == SessionDate)
+        {
+            Sessions.back().EndIndex = Index;
+            return false;
+        }
+
+        s_RVolSession Session;
+        Session.Date = SessionDate;
+        Session.StartIndex = Index;
+        Session.EndIndex = Index;
+        Sessions.push_back(Session);
+        return true;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Baseline table
+// -----------------------------------------------------------------------------
+
+// Shortest slot. Each slot holds two sketches (about 2 KB), so 1-second
+// slots would take some 180 MB per chart.
+const int RVOL_MIN_SLOT_SECONDS = 60;
+
+struct s_RVolBaseline
+{
+    int SlotSeconds;
+    int SlotsPerSession;
+    int LookbackSessions;
+
+    // The last LookbackSessions completed sessions, oldest first: cumulative
+    // volume through each slot
+    std::deque<std::vector<double> > Rows;
+
+    // Sums over Rows of the values > 0, how many there were, and their
+    // sketches
+    std::vector<double> CumSum;
+    std::vector<int> CumCount;
+    std::vector<double> SlotSum;
+    std::vector<int> SlotCount;
+    double FullSum;
+    int FullCount;
+    std::vector<s_RVolSketch> CumSketch;
+    std::vector<s_RVolSketch> SlotSketch;
+
+    // Session being built: volume of each slot
+    std::vector<double> Building;
+
+    // Lookback is capped by the sketch counts. Seconds is the bar period,
+    // 0 for bars without one.
+    void Reset(int Seconds, int Lookback)
+    {
+        SlotSeconds = Seconds > RVOL_MIN_SLOT_SECONDS ? Seconds : RVOL_MIN_SLOT_SECONDS;
+        SlotsPerSession = (86400 + SlotSeconds - 1) / SlotSeconds;
+        LookbackSessions = Lookback > 0 ? (Lookback < UINT16_MAX ? Lookback : UINT16_MAX) : 1;
+
+        Rows.clear();
+        CumSum.assign(SlotsPerSession, 0.0);
+        CumCount.assign(SlotsPerSession, 0);
+        SlotSum.assign(SlotsPerSession, 0.0);
+        SlotCount.assign(SlotsPerSession, 0);
+        FullSum = 0.0;
+        FullCount = 0;
+        CumSketch.resize(SlotsPerSession);
+        SlotSketch.resize(SlotsPerSession);
+        for (int s = 0; s < SlotsPerSession; s++)
+        {
+            CumSketch[s].Clear();
+            SlotSketch[s].Clear();
+        }
+        Building.assign(SlotsPerSession, 0.0);
+    }
+
+    // Slot of a bar starting SecondsIntoSession after the session start
+    int GetSlot(int SecondsIntoSession) const
+    {
+        int Slot = SecondsIntoSession / SlotSeconds;
+        if (Slot < 0)
+            return 0;
+        if (Slot >= SlotsPerSession)
+            return SlotsPerSession - 1;
+        return Slot;
+    }
+
+    // Adds a closed bar to the session being built
+    void AddBar(int Slot, float Volume)
+    {
+        Building[Slot] += Volume;
+    }
+
+    // The session being built is complete: it becomes a row of the table
+    // and a new, empty session is started. Row, if given, is used instead
+    // of the volume built from the bars (a complete copy of the session
+    // from elsewhere).
+    void EndSession(const double* Row = NULL)
+    {
+        if (Row == NULL)
+        {
+            double Cum = 0.0;
+            for (int s = 0; s < SlotsPerSession; s++)
+            {
+                Cum += Building[s];
+                Building[s] = Cum;
+            }
+            Row = &Building[0];
+        }
+
+        AddRow(Row);
+        Building.assign(SlotsPerSession, 0.0);
+    }
+
+    // Appends a completed session, dropping the oldest beyond the lookback
+    void AddRow(const double* Row)
+    {
+        Rows.push_back(std::vector<double>(Row, Row + SlotsPerSession));
+        Apply(Rows.back(), 1);
+
+        if ((int)Rows.size() > LookbackSessions)
+        {
+            Apply(Rows.front(), -1);
+            Rows.pop_front();
+        }
+    }
+
+    // Averages over the completed sessions in the table, 0 if none counted
+    float GetAvgCumVolume(int Slot) const
+    {
+        return CumCount[Slot] > 0 ? (float)(CumSum[Slot] / CumCount[Slot]) : 0.0f;
+    }
+
+    float GetAvgSlotVolume(int Slot) const
+    {
+        return SlotCount[Slot] > 0 ? (float)(SlotSum[Slot] / SlotCount[Slot]) : 0.0f;
+    }
+
+    float GetAvgFullSessionVolume() const
+    {
+        return FullCount > 0 ? (float)(FullSum / FullCount) : 0.0f;
+    }
+
+    // Medians over the completed sessions in the table, 0 if none counted
+    float GetMedianCumVolume(int Slot) const
+    {
+        return (float)CumSketch[Slot].GetQuantile(0.5);
+    }
+
+    float GetMedianSlotVolume(int Slot) const
+    {
+        return (float)SlotSketch[Slot].GetQuantile(0.5);
+    }
+
+    // Percentile rank of a cumulative volume among the sessions in the
+    // table at Slot
+    float GetCumVolumePercentRank(int Slot, double CumVolume) const
+    {
+        return CumSketch[Slot].GetPercentRank(CumVolume);
+    }
+
+    // Cumulative volume through Slot of the session SessionsAgo completed
+    // sessions back (1 = the last one), -1 if it has left the table
+    double GetCumVolume(int SessionsAgo, int Slot) const
+    {
+        int k = (int)Rows.size() - SessionsAgo;
+        return (SessionsAgo >= 1 && k >= 0) ? Rows[k][Slot] : -1.0;
+    }
+
+    // Adds (Sign = 1) or removes (Sign = -1) a row's contribution. Volumes
+    // are whole numbers well below 2^53, so removing is exact.
+    void Apply(const std::vector<double>& Row, int Sign)
+    {
+        double Previous = 0.0;
+        for (int s = 0; s < SlotsPerSession; s++)
+        {
+            if (Row[s] > 0.0)
+            {
+                CumSum[s] += Sign * Row[s];
+                CumCount[s] += Sign;
+                CumSketch[s].Add(Row[s], Sign);
+            }
+
+            double SlotVolume = Row[s] - Previous;
+            if (SlotVolume > 0.0)
+            {
+                SlotSum[s] += Sign * SlotVolume;
+                SlotCount[s] += Sign;
+                SlotSketch[s].Add(SlotVolume, Sign);
+            }
+            Previous = Row[s];
+        }
+
+        if (Row[SlotsPerSession - 1] > 0.0)
+        {
+            FullSum += Sign * Row[SlotsPerSession - 1];
+            FullCount += Sign;
+        }
+    }
+};
+
+#endif // RELATIVE_VOLUME_BASELINE_H
@@ -0,0 +1,292 @@
+#ifndef RVOL_BASELINE_FILE_H
+#define RVOL_BASELINE_FILE_H
+
+/*
+    Relative Volume baseline sessions shared between charts through a
+    memory mapped file, one file per symbol and session template (start time
+    and slot length). Include after sierrachart.h (Windows).
+
+    The file is a ring of the last RVOL_FILE_CAPACITY completed sessions,
+    each stored as its date followed by the cumulative volume through each
+    slot (a row of s_RVolBaseline). The chart that takes an exclusive lock
+    on a sidecar file (Path + ".lock") becomes the owner. It maps the file
+    read-write and appends sessions as they complete. Every other chart, in
+    this process or another, fails to take the lock and maps the file
+    read-only. The lock goes with the owner's handle, so once the owner
+    closes the file the next chart to open it takes over, as does a reader
+    that calls Open again. A chart loading its history takes the sessions
+    before its first bar from the file, and the sessions the file already
+    holds are not rebuilt from bars.
+
+    Rows are limited to RVOL_FILE_MAX_SLOTS slots (one a minute over 24
+    hours), which keeps the file under 4 MB.
+
+    The owner writes a row before it bumps the session count, so readers
+    never see a row being written. Readers use at most Capacity - 1 rows,
+    so the slot being overwritten is never read.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+const uint32_t RVOL_FILE_MAGIC = 0x4C4F5652;    // "RVOL"
+const uint32_t RVOL_FILE_VERSION = 1;
+const int RVOL_FILE_CAPACITY = 300;
+const int RVOL_FILE_MAX_SLOTS = 1440;
+
+struct s_RVolFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    int32_t SlotSeconds;
+    int32_t SlotsPerSession;
+    int32_t StartSeconds;
+    int32_t Capacity;
+    volatile LONG NumSessions;  // Sessions ever appended; session k is in row k % Capacity
+    int32_t Reserved;
+};
+
+struct s_RVolBaselineFile
+{
+    HANDLE OwnerLock;           // Sidecar lock file, locked by the owner
+    HANDLE File;
+    HANDLE Mapping;
+    char* View;
+    bool Owner;
+    int SlotsPerSession;
+    LONG NumSessions;           // Header count as of the last Refresh
+    std::string OpenPath;
+
+    s_RVolBaselineFile() : OwnerLock(INVALID_HANDLE_VALUE), File(INVALID_HANDLE_VALUE), Mapping(NULL), View(NULL), Owner(false), SlotsPerSession(0), NumSessions(0) {}
+    ~s_RVolBaselineFile() { Close(); }
+
+    bool IsOpen() const { return View != NULL; }
+
+    // Opens or creates the file at Path. The lock on Path + ".lock" decides
+    // the owner. Returns false, with nothing open, if the file cannot be
+    // used; a reader also fails while no owner has created the file yet,
+    // and rows longer than RVOL_FILE_MAX_SLOTS are not shared. A file
+    // already open at Path is kept, so ownership is not given up; if it is
+    // open read-only and the owner has since closed it, the lock is taken
+    // and the file mapped again read-write. Call again to retry after a
+    // failure or to pick up ownership.
+    bool Open(const char* Path, int SlotSeconds, int Slots, int StartSeconds)
+    {
+        if (IsOpen() && OpenPath == Path && SlotsPerSession == Slots)
+        {
+            if (Owner || !TryLock())
+            {
+                Refresh();
+                return true;
+            }
+
+            // The owner has gone: keep the lock, map the file for writing
+            CloseView();
+            Owner = true;
+            return MapFile(Path, SlotSeconds, Slots, StartSeconds);
+        }
+
+        Close();
+        if (Slots <= 0 || Slots > RVOL_FILE_MAX_SLOTS)
+            return false;
+        SlotsPerSession = Slots;
+
+        // Byte ranges locked through one handle are refused through every
+        // other handle, also within the process, so exactly one chart holds it
+        std::string LockPath = std::string(Path) + ".lock";
+        OwnerLock = CreateFileA(LockPath.c_str(), GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        Owner = TryLock();
+        return MapFile(Path, SlotSeconds, Slots, StartSeconds);
+    }
+
+    void Close()
+    {
+        CloseView();
+        if (OwnerLock != INVALID_HANDLE_VALUE)
+        {
+            if (Owner)
+            {
+                OVERLAPPED Overlapped;
+                memset(&Overlapped, 0, sizeof(Overlapped));
+                UnlockFileEx(OwnerLock, 0, 1, 0, &Overlapped);
+            }
+            CloseHandle(OwnerLock);
+            OwnerLock = INVALID_HANDLE_VALUE;
+        }
+        Owner = false;
+        NumSessions = 0;
+        OpenPath.clear();
+    }
+
+    // Takes the owner lock if no other handle holds it
+    bool TryLock()
+    {
+        if (OwnerLock == INVALID_HANDLE_VALUE)
+            return false;
+
+        OVERLAPPED Overlapped;
+        memset(&Overlapped, 0, sizeof(Overlapped));
+        return LockFileEx(OwnerLock, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &Overlapped) != FALSE;
+    }
+
+    // Maps the file at Path, read-write for the owner, and checks or
+    // writes its header. Closes everything on failure.
+    bool MapFile(const char* Path, int SlotSeconds, int Slots, int StartSeconds)
+    {
+        ULONGLONG Size = sizeof(s_RVolFileHeader) + (ULONGLONG)RVOL_FILE_CAPACITY * GetRowBytes();
+
+        File = CreateFileA(Path, Owner ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, Owner ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (File == INVALID_HANDLE_VALUE)
+        {
+            Close();
+            return false;
+        }
+
+        LARGE_INTEGER FileSize;
+        if (!Owner && (!GetFileSizeEx(File, &FileSize) || (ULONGLONG)FileSize.QuadPart < Size))
+        {
+            Close();
+            return false;
+        }
+
+        // The owner's mapping grows a new file to its full size
+        Mapping = CreateFileMappingA(File, NULL, Owner ? PAGE_READWRITE : PAGE_READONLY,
+            (DWORD)(Size >> 32), (DWORD)(Size & 0xFFFFFFFF), NULL);
+        if (Mapping != NULL)
+            View = (char*)MapViewOfFile(Mapping, Owner ? (FILE_MAP_READ | FILE_MAP_WRITE) : FILE_MAP_READ, 0, 0, (size_t)Size);
+        if (View == NULL)
+        {
+            Close();
+            return false;
+        }
+
+        s_RVolFileHeader* Header = GetHeader();
+        bool Matches = (Header->Magic == RVOL_FILE_MAGIC && Header->Version == RVOL_FILE_VERSION
+            && Header->SlotSeconds == SlotSeconds && Header->SlotsPerSession == Slots
+            && Header->StartSeconds == StartSeconds && Header->Capacity == RVOL_FILE_CAPACITY);
+
+        if (!Matches)
+        {
+            if (!Owner)
+            {
+                Close();
+                return false;
+            }
+
+            // New file, or one from an older layout: start it over
+            Header->NumSessions = 0;
+            Header->Version = RVOL_FILE_VERSION;
+            Header->SlotSeconds = SlotSeconds;
+            Header->SlotsPerSession = Slots;
+            Header->StartSeconds = StartSeconds;
+            Header->Capacity = RVOL_FILE_CAPACITY;
+            Header->Reserved = 0;
+            Header->Magic = RVOL_FILE_MAGIC;
+        }
+
+        OpenPath = Path;
+        Refresh();
+        return true;
+    }
+
+    // Unmaps the file, keeping the owner lock
+    void CloseView()
+    {
+        if (View != NULL)
+        {
+            if (Owner)
+                FlushViewOfFile(View, 0);
+            UnmapViewOfFile(View);
+            View = NULL;
+        }
+        if (Mapping != NULL)
+        {
+            CloseHandle(Mapping);
+            Mapping = NULL;
+        }
+        if (File != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(File);
+            File = INVALID_HANDLE_VALUE;
+        }
+    }
+
+    // Picks up the sessions the owner appended since the last call. Rows
+    // are numbered as of this call, so they stay put while they are read.
+    void Refresh()
+    {
+        if (View != NULL)
+            NumSessions = GetHeader()->NumSessions;
+    }
+
+    // Rows that can be read, newest last
+    int GetNumRows() const
+    {
+        return NumSessions < RVOL_FILE_CAPACITY - 1 ? (int)NumSessions : RVOL_FILE_CAPACITY - 1;
+    }
+
+    // Row k of the readable rows (0 = oldest): its date and slot values
+    int GetRowDate(int k) const
+    {
+        return *reinterpret_cast<const int32_t*>(GetRecord(k));
+    }
+
+    const double* GetRow(int k) const
+    {
+        return reinterpret_cast<const double*>(GetRecord(k) + sizeof(double));
+    }
+
+    // Readable row of the session on Date, -1 if the file does not have it
+    int FindRow(int Date) const
+    {
+        for (int k = GetNumRows() - 1; k >= 0; k--)
+        {
+            int RowDate = GetRowDate(k);
+            if (RowDate == Date)
+                return k;
+            if (RowDate < Date)
+                break;
+        }
+        return -1;
+    }
+
+    // Owner only. Sessions are kept in date order, so a session not after
+    // the newest one in the file is ignored.
+    void Append(int Date, const double* Row)
+    {
+        if (View == NULL || !Owner)
+            return;
+
+        if (NumSessions > 0 && GetRowDate(GetNumRows() - 1) >= Date)
+            return;
+
+        char* Record = View + sizeof(s_RVolFileHeader) + (size_t)(NumSessions % RVOL_FILE_CAPACITY) * GetRowBytes();
+        *reinterpret_cast<int32_t*>(Record) = Date;
+        memcpy(Record + sizeof(double), Row, sizeof(double) * SlotsPerSession);
+
+        NumSessions++;
+        InterlockedExchange(&GetHeader()->NumSessions, NumSessions);
+    }
+
+    // Each record is the date, padded to 8 bytes, then the slot values
+    size_t GetRowBytes() const
+    {
+        return sizeof(double) * (1 + (size_t)SlotsPerSession);
+    }
+
+    s_RVolFileHeader* GetHeader() const
+    {
+        return reinterpret_cast<s_RVolFileHeader*>(View);
+    }
+
+    const char* GetRecord(int k) const
+    {
+        int First = (int)NumSessions - GetNumRows();
+        return View + sizeof(s_RVolFileHeader) + (size_t)((First + k) % RVOL_FILE_CAPACITY) * GetRowBytes();
+    }
+};
+
+#endif // RVOL_BASELINE_FILE_H
@@ -0,0 +1,92 @@
+#ifndef SESSION_VWAP_H
+#define SESSION_VWAP_H
+
+/*
+    Running session VWAP sums shared by the studies that plot session VWAP
+    and its standard deviation bands. Platform independent.
+*/
+
+#include <cmath>
+
+// Neumaier compensated sum. Keeps long running sums (a 1-tick chart can have
+// 60k+ bars in one session) accurate without re-summing from the start.
+struct s_CompensatedSum
+{
+    double Sum;
+    double Compensation;
+
+    void Reset()
+    {
+        Sum = 0.0;
+        Compensation = 0.0;
+    }
+
+    void Add(double Value)
+    {
+        double t = Sum + Value;
+        if (fabs(Sum) >= fabs(Value))
+            Compensation += (Sum - t) + Value;
+        else
+            Compensation += (Value - t) + Sum;
+        Sum = t;
+    }
+
+    double Get() const { return Sum + Compensation; }
+};
+
+// Running session sums for VWAP and the volume weighted standard deviation.
+// Closed bars are committed exactly once. The still-forming bar is never
+// committed, its contribution is added on top at read time, so repeated
+// real-time updates of the last bar replace its values instead of re-adding them.
+struct s_SessionVWAPAccumulator
+{
+    int SessionDate;
+    int StartIndex;             // First bar of the session
+    int FormingBarIndex;        // First bar not yet committed to the sums below
+    s_CompensatedSum Volume;    // Committed bars [StartIndex, FormingBarIndex)
+    s_CompensatedSum PV;
+    s_CompensatedSum P2V;
+
+    void Reset(int Date, int FirstIndex)
+    {
+        SessionDate = Date;
+        StartIndex = FirstIndex;
+        FormingBarIndex = FirstIndex;
+        Volume.Reset();
+        PV.Reset();
+        P2V.Reset();
+    }
+
+    void Commit(float Price, float BarVolume)
+    {
+        Volume.Add(BarVolume);
+        PV.Add((double)Price * BarVolume);
+        P2V.Add((double)Price * Price * BarVolume);
+        FormingBarIndex++;
+    }
+
+    // Session totals including the forming bar
+    void GetTotals(float Price, float BarVolume, double& TotalVol, double& TotalPV, double& TotalP2V) const
+    {
+        TotalVol = Volume.Get() + BarVolume;
+        TotalPV  = PV.Get() + (double)Price * BarVolume;
+        TotalP2V = P2V.Get() + (double)Price * Price * BarVolume;
+    }
+
+    // VWAP and volume weighted standard deviation including the forming bar.
+    // Returns false, leaving both untouched, while the session has no volume.
+    bool GetVWAP(float Price, float BarVolume, double& VWAP, double& StdDev) const
+    {
+        double TotalVol, TotalPV, TotalP2V;
+        GetTotals(Price, BarVolume, TotalVol, TotalPV, TotalP2V);
+        if (TotalVol <= 0)
+            return false;
+
+        VWAP = TotalPV / TotalVol;
+        double Variance = TotalP2V / TotalVol - VWAP * VWAP;
+        StdDev = sqrt(Variance > 0 ? Variance : 0.0);
+        return true;
+    }
+};
+
+#endif // SESSION_VWAP_H
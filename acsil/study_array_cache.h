@@ -0,0 +1,141 @@
+#ifndef STUDY_ARRAY_CACHE_H
+#define STUDY_ARRAY_CACHE_H
+
+/*
+    Cache for a subgraph array of another study, on this chart or another
+    chart. Include after sierrachart.h.
+
+    With AutoLoop the study function runs once per bar, so looking the array
+    up inside it repeats the lookup for every bar of a full recalculation.
+    Resolve() only looks it up on the first bar of each update pass
+    (sc.UpdateStartIndex) or when the reference changes, and checks that the
+    array has one value per bar of the chart it belongs to.
+
+    For another chart, an index map gives the bar of that chart containing
+    each bar of this chart (the last bar starting at or before it). The map
+    is built with one merge over both date-time arrays and extended as bars
+    are added, so a 1 minute VIX chart can drive a 10 second chart without
+    a date-time search per bar.
+*/
+
+#include <vector>
+
+struct s_StudyArrayCache
+{
+    int ChartNumber;            // 0 = this chart
+    int StudyID;
+    int SubgraphIndex;
+    int ResolvedPass;           // sc.UpdateStartIndex of the pass the array was looked up in, -1 = none
+    int ResolvedArraySize;      // This chart's size in that pass
+    bool Valid;
+    SCFloatArray Array;
+
+    // Other chart only
+    std::vector<int> IndexMap;  // This chart's bar -> other chart's bar, -1 = before its first bar
+    int MappedOtherSize;        // Other chart's size when the map was last extended
+    SCDateTime MappedOtherFirst;// and its first bar, to notice history loaded in front
+
+    void Reset()
+    {
+        ChartNumber = 0;
+        StudyID = -1;
+        SubgraphIndex = -1;
+        ResolvedPass = -1;
+        ResolvedArraySize = -1;
+        Valid = false;
+        IndexMap.clear();
+        MappedOtherSize = 0;
+        MappedOtherFirst = 0;
+    }
+
+    // Looks the array up if this is a new update pass or a different
+    // reference. Returns false if the array is missing or does not line up
+    // with its chart's bars.
+    bool Resolve(SCStudyInterfaceRef sc, int Chart, int ID, int Subgraph)
+    {
+        if (Chart == sc.ChartNumber)
+            Chart = 0;
+
+        bool SameReference = (Chart == ChartNumber && ID == StudyID && Subgraph == SubgraphIndex);
+        if (SameReference && ResolvedPass == sc.UpdateStartIndex && ResolvedArraySize == sc.ArraySize && sc.Index != sc.UpdateStartIndex)
+            return Valid;
+
+        if (!SameReference)
+        {
+            Reset();
+            ChartNumber = Chart;
+            StudyID = ID;
+            SubgraphIndex = Subgraph;
+        }
+
+        ResolvedPass = sc.UpdateStartIndex;
+        ResolvedArraySize = sc.ArraySize;
+
+        if (ChartNumber == 0)
+        {
+            sc.GetStudyArrayUsingID(StudyID, SubgraphIndex, Array);
+            Valid = (Array.GetArraySize() == sc.ArraySize);
+            return Valid;
+        }
+
+        SCDateTimeArray OtherDateTimes;
+        sc.GetChartDateTimeArray(ChartNumber, OtherDateTimes);
+        sc.GetStudyArrayFromChartUsingID(ChartNumber, StudyID, SubgraphIndex, Array);
+
+        int OtherSize = OtherDateTimes.GetArraySize();
+        Valid = (OtherSize > 0 && Array.GetArraySize() == OtherSize);
+        if (!Valid)
+            return false;
+
+        // Start over if this chart was recalculated from the start or the
+        // other chart changed other than by adding bars at the end
+        if (sc.UpdateStartIndex == 0 || (int)IndexMap.size() > sc.ArraySize
+            || OtherSize < MappedOtherSize || OtherDateTimes[0] != MappedOtherFirst)
+        {
+            IndexMap.clear();
+            MappedOtherSize = 0;
+        }
+
+        // Once the other chart has new bars, bars mapped to its previous last
+        // bar may belong to one of them, so they are mapped again
+        if (OtherSize > MappedOtherSize)
+        {
+            while (!IndexMap.empty() && IndexMap.back() >= MappedOtherSize - 1)
+                IndexMap.pop_back();
+        }
+
+        int j = (IndexMap.empty() || IndexMap.back() < 0) ? 0 : IndexMap.back();
+        for (int i = (int)IndexMap.size(); i < sc.ArraySize; i++)
+        {
+            while (j + 1 < OtherSize && OtherDateTimes[j + 1] <= sc.BaseDateTimeIn[i])
+                j++;
+            IndexMap.push_back(OtherDateTimes[j] <= sc.BaseDateTimeIn[i] ? j : -1);
+        }
+
+        MappedOtherSize = OtherSize;
+        MappedOtherFirst = OtherDateTimes[0];
+        return true;
+    }
+
+    // Bar of the referenced array for this chart's bar, -1 if there is none
+    int GetIndex(int Index) const
+    {
+        if (ChartNumber == 0)
+            return Index;
+        return (Index >= 0 && Index < (int)IndexMap.size()) ? IndexMap[Index] : -1;
+    }
+
+    // Change of the referenced array over BarsBack of its own bars, ending
+    // at the bar for this chart's bar Index
+    bool GetChange(int Index, int BarsBack, float& Change) const
+    {
+        int Current = GetIndex(Index);
+        if (!Valid || Current <= BarsBack)
+            return false;
+
+        Change = Array[Current] - Array[Current - BarsBack];
+        return true;
+    }
+};
+
+#endif // STUDY_ARRAY_CACHE_H
@@ -1,4 +1,8 @@
 #include "sierrachart.h"
+#include "session_vwap.h"
+#include "study_array_cache.h"
+
+#include <deque>
 
 SCDLLName("XYL - VWAP Bands Strategy")
 
@@ -11,6 +15,52 @@ SCDLLName("XYL - VWAP Bands Strategy")
     3. VIX Filter: Uses external Study ID 15 (VOLX) slope to confirm regime.
 */
 
+// Maximum of a value over a sliding window of bars (monotonic deque). Only
+// closed bars are committed; the forming bar is compared at read time, so
+// its repeated real-time updates never touch the deque.
+struct s_SlidingWindowMax
+{
+    struct s_Entry
+    {
+        int Index;
+        float Value;
+    };
+
+    std::deque<s_Entry> Entries;    // Committed bars, values strictly decreasing front to back
+    int NextIndex;                  // First bar not yet committed
+
+    void Reset(int FirstIndex)
+    {
+        Entries.clear();
+        NextIndex = FirstIndex;
+    }
+
+    // A bar's value can never be the maximum again once a later bar is at least as large
+    void Commit(float Value)
+    {
+        while (!Entries.empty() && Entries.back().Value <= Value)
+            Entries.pop_back();
+
+        s_Entry Entry;
+        Entry.Index = NextIndex++;
+        Entry.Value = Value;
+        Entries.push_back(Entry);
+    }
+
+    void DropBefore(int FirstIndex)
+    {
+        while (!Entries.empty() && Entries.front().Index < FirstIndex)
+            Entries.pop_front();
+    }
+
+    float GetMax(float FormingValue) const
+    {
+        if (Entries.empty() || FormingValue > Entries.front().Value)
+            return FormingValue;
+        return Entries.front().Value;
+    }
+};
+
 SCSFExport scsf_VWAPBandsStrategy(SCStudyInterfaceRef sc)
 {
     // --- INPUTS ---
@@ -37,6 +87,7 @@ SCSFExport scsf_VWAPBandsStrategy(SCStudyInterfaceRef sc)
     SCInputRef Input_VIXStudyID = sc.Input[13]; // ID 15
     SCInputRef Input_VIXSubgraphIndex = sc.Input[14]; // Usually 0
     SCInputRef Input_VIXSlopeBars = sc.Input[15];
+    SCInputRef Input_VIXChartNumber = sc.Input[16]; // 0 = this chart
 
     // --- SUBGRAPHS ---
     SCSubgraphRef Subgraph_VWAP = sc.Subgraph[0];
@@ -45,6 +96,7 @@ SCSFExport scsf_VWAPBandsStrategy(SCStudyInterfaceRef sc)
     SCSubgraphRef Subgraph_ATR = sc.Subgraph[3];
     SCSubgraphRef Subgraph_CVD = sc.Subgraph[4];        // Cumulative Delta
     SCSubgraphRef Subgraph_ActiveMult = sc.Subgraph[5]; // Which multiplier is active?
+    SCSubgraphRef Subgraph_ZScore = sc.Subgraph[6];     // Bar's furthest excursion from VWAP, in SD
 
     if (sc.SetDefaults)
     {
@@ -99,6 +151,9 @@ SCSFExport scsf_VWAPBandsStrategy(SCStudyInterfaceRef sc)
         Input_VIXSubgraphIndex.SetInt(0);
         Input_VIXSlopeBars.Name = "VIX Slope Lookback";
         Input_VIXSlopeBars.SetInt(5);
+        Input_VIXChartNumber.Name = "VIX Chart Number (0 = This Chart)";
+        Input_VIXChartNumber.SetInt(0);
+        Input_VIXChartNumber.SetDescription("Chart holding the VIX study. On another chart the slope lookback counts that chart's bars.");
 
         // Subgraph Styling
         Subgraph_VWAP.Name = "VWAP";
@@ -119,6 +174,33 @@ SCSFExport scsf_VWAPBandsStrategy(SCStudyInterfaceRef sc)
         Subgraph_ActiveMult.Name = "Active Multiplier";
         Subgraph_ActiveMult.DrawStyle = DRAWSTYLE_IGNORE;
 
+        Subgraph_ZScore.Name = "Band Z-Score";
+        Subgraph_ZScore.DrawStyle = DRAWSTYLE_IGNORE;
+
+        return;
+    }
+
+    // Study is being removed - clean up memory
+    if (sc.LastCallToFunction)
+    {
+        s_SessionVWAPAccumulator* SessionVWAP = reinterpret_cast<s_SessionVWAPAccumulator*>(sc.GetPersistentPointer(0));
+        if (SessionVWAP != NULL)
+        {
+            delete SessionVWAP;
+            sc.SetPersistentPointer(0, NULL);
+        }
+        s_SlidingWindowMax* ZScoreMax = reinterpret_cast<s_SlidingWindowMax*>(sc.GetPersistentPointer(1));
+        if (ZScoreMax != NULL)
+        {
+            delete ZScoreMax;
+            sc.SetPersistentPointer(1, NULL);
+        }
+        s_StudyArrayCache* VIXCache = reinterpret_cast<s_StudyArrayCache*>(sc.GetPersistentPointer(2));
+        if (VIXCache != NULL)
+        {
+            delete VIXCache;
+            sc.SetPersistentPointer(2, NULL);
+        }
         return;
     }
 
@@ -129,122 +211,101 @@ SCSFExport scsf_VWAPBandsStrategy(SCStudyInterfaceRef sc)
     // ATR
     sc.ATR(sc.BaseData, Subgraph_ATR, Input_ATRPeriod.GetInt(), MOVAVGTYPE_SIMPLE);
 
-    // Cumulative Delta Calculation
-    float AskVol = sc.BaseData[SC_ASKVOL][sc.Index];
-    float BidVol = sc.BaseData[SC_BIDVOL][sc.Index];
-    float BarDelta = AskVol - BidVol;
-
-    if (sc.Index == 0)
-        Subgraph_CVD[sc.Index] = BarDelta;
-    else
-        Subgraph_CVD[sc.Index] = Subgraph_CVD[sc.Index - 1] + BarDelta;
+    // Session VWAP sums live in persistent memory: each closed bar is added
+    // once, the forming bar is added on top at read time
+    s_SessionVWAPAccumulator* SessionVWAP = reinterpret_cast<s_SessionVWAPAccumulator*>(sc.GetPersistentPointer(0));
+    if (SessionVWAP == NULL)
+    {
+        SessionVWAP = new s_SessionVWAPAccumulator;
+        SessionVWAP->Reset(0, 0);
+        sc.SetPersistentPointer(0, SessionVWAP);
+    }
 
-    // Reset CVD at start of day (Optional, but good for cleanliness)
-    int DayStartBarIndex = sc.Index;
+    // New trading day, or a recalculation stepped back behind the committed
+    // bars: restart the sums at the session's first bar. Normally the first
+    // bar of the day is the current bar, so the walk back stops immediately.
     int CurrentDate = sc.GetTradingDayDate(sc.BaseDateTimeIn[sc.Index]);
 
-    if (DayStartBarIndex > 0)
+    if (sc.Index == 0 || CurrentDate != SessionVWAP->SessionDate || sc.Index < SessionVWAP->FormingBarIndex)
     {
-        while (DayStartBarIndex > 0)
-        {
-            int PrevBarDate = sc.GetTradingDayDate(sc.BaseDateTimeIn[DayStartBarIndex - 1]);
-            if (PrevBarDate != CurrentDate) break;
+        int DayStartBarIndex = sc.Index;
+        while (DayStartBarIndex > 0 && sc.GetTradingDayDate(sc.BaseDateTimeIn[DayStartBarIndex - 1]) == CurrentDate)
             DayStartBarIndex--;
-        }
 
-        // If this is the very first bar of the day, reset CVD
-        if (DayStartBarIndex == sc.Index)
-            Subgraph_CVD[sc.Index] = BarDelta;
+        SessionVWAP->Reset(CurrentDate, DayStartBarIndex);
     }
 
-    // VWAP Calculation
-    double CumulativePV = 0.0;
-    double CumulativeVolume = 0.0;
-    double CumulativeP2V = 0.0;
-
-    for (int i = DayStartBarIndex; i <= sc.Index; i++)
+    // Commit bars that have closed since the last call (usually just the previous bar)
+    while (SessionVWAP->FormingBarIndex < sc.Index)
     {
-        float Price = sc.BaseData[SC_LAST][i];
-        float Volume = sc.BaseData[SC_VOLUME][i];
-
-        CumulativePV += Price * Volume;
-        CumulativeVolume += Volume;
-        CumulativeP2V += (Price * Price) * Volume;
+        int i = SessionVWAP->FormingBarIndex;
+        SessionVWAP->Commit(sc.BaseData[SC_LAST][i], sc.BaseData[SC_VOLUME][i]);
     }
 
-    double VWAP = 0;
-    double StdDev = 0;
-
-    if (CumulativeVolume > 0)
-    {
-        VWAP = CumulativePV / CumulativeVolume;
-        Subgraph_VWAP[sc.Index] = (float)VWAP;
+    // Cumulative Delta, reset on the first bar of the session
+    float AskVol = sc.BaseData[SC_ASKVOL][sc.Index];
+    float BidVol = sc.BaseData[SC_BIDVOL][sc.Index];
+    float BarDelta = AskVol - BidVol;
 
-        double MeanOfSquares = CumulativeP2V / CumulativeVolume;
-        double Variance = MeanOfSquares - (VWAP * VWAP);
-        if (Variance < 0) Variance = 0;
-        StdDev = sqrt(Variance);
-    }
+    if (sc.Index == SessionVWAP->StartIndex)
+        Subgraph_CVD[sc.Index] = BarDelta;
     else
-    {
-        VWAP = sc.Close[sc.Index];
-        Subgraph_VWAP[sc.Index] = (float)VWAP;
-    }
+        Subgraph_CVD[sc.Index] = Subgraph_CVD[sc.Index - 1] + BarDelta;
+
+    // VWAP Calculation
+    double VWAP = sc.Close[sc.Index];
+    double StdDev = 0;
+
+    SessionVWAP->GetVWAP(sc.BaseData[SC_LAST][sc.Index], sc.BaseData[SC_VOLUME][sc.Index], VWAP, StdDev);
+    Subgraph_VWAP[sc.Index] = (float)VWAP;
 
     // ---------------------------------------------------------
     // 2. DYNAMIC BAND SELECTION
     // ---------------------------------------------------------
 
-    // We need to determine which StdDev Multiplier to use based on recent price action.
     // "If last 10 bars not crossing 2.0, use 1.5. If not 1.5, use 1.0"
+    // A bar crossed a band if its furthest excursion from VWAP, in standard
+    // deviations at that bar, reached the band's multiplier.
 
-    float SelectedMultiplier = Input_StdDev_Low.GetFloat(); // Start with lowest (fallback)
+    float ZScore = 0;
+    if (StdDev > 0)
+    {
+        float Deviation = 0;
+        if (sc.BaseData[SC_LAST][sc.Index] > VWAP) Deviation = (float)(sc.BaseData[SC_HIGH][sc.Index] - VWAP);
+        else Deviation = (float)(VWAP - sc.BaseData[SC_LOW][sc.Index]);
 
-    // Safety check for history
+        ZScore = (float)(Deviation / StdDev);
+    }
+    Subgraph_ZScore[sc.Index] = ZScore;
+
+    // Largest Z-Score over the last Lookback bars, including this one
     int Lookback = Input_DynamicLookback.GetInt();
-    if (sc.Index >= Lookback)
+    int WindowStart = sc.Index - Lookback + 1;
+
+    s_SlidingWindowMax* ZScoreMax = reinterpret_cast<s_SlidingWindowMax*>(sc.GetPersistentPointer(1));
+    if (ZScoreMax == NULL)
     {
-        bool HitHigh = false;
-        bool HitMed = false;
+        ZScoreMax = new s_SlidingWindowMax;
+        ZScoreMax->Reset(0);
+        sc.SetPersistentPointer(1, ZScoreMax);
+    }
 
-        float MultHigh = Input_StdDev_High.GetFloat();
-        float MultMed = Input_StdDev_Med.GetFloat();
+    // Full recalculation, or a recalculation stepped back behind the committed bars
+    if (sc.Index == 0 || sc.Index < ZScoreMax->NextIndex)
+        ZScoreMax->Reset(WindowStart > 0 ? WindowStart : 0);
 
-        // Loop back N bars to check for touches
-        for (int k = 0; k < Lookback; k++)
-        {
-            int Idx = sc.Index - k;
-            float HistHigh = sc.High[Idx];
-            float HistLow = sc.Low[Idx];
-            // Reconstruct historical bands approximately (using current VWAP/StdDev is approximation,
-            // but precise enough for "Regime" detection, or we could use arrays if we stored them).
-            // Better: We check if Price was > VWAP + Mult*StdDev AT THAT TIME.
-            // Since we don't store historical bands in arrays in this simplified code,
-            // we will estimate using CURRENT Volatility regime or simply use the fact
-            // that if volatility expanded, we want wider bands.
-
-            // Actually, correct implementation requires checking if price exceeded the band *at that moment*.
-            // Since we recalculate VWAP every tick, let's define the threshold based on CURRENT StdDev
-            // applied to historical prices relative to CURRENT VWAP for simplicity,
-            // OR simpler: check Range.
-
-            // Let's use the USER's logic: "If last 10 bars crossing..."
-            // We will assume "Crossing" means the High/Low deviated significantly from VWAP.
-
-            float Deviation = 0;
-            if (sc.BaseData[SC_LAST][Idx] > VWAP) Deviation = sc.BaseData[SC_HIGH][Idx] - VWAP;
-            else Deviation = VWAP - sc.BaseData[SC_LOW][Idx];
-
-            if (StdDev > 0)
-            {
-                float ZScore = Deviation / StdDev;
-                if (ZScore >= MultHigh) HitHigh = true;
-                if (ZScore >= MultMed) HitMed = true;
-            }
-        }
+    while (ZScoreMax->NextIndex < sc.Index)
+        ZScoreMax->Commit(Subgraph_ZScore[ZScoreMax->NextIndex]);
+
+    ZScoreMax->DropBefore(WindowStart);
 
-        if (HitHigh) SelectedMultiplier = Input_StdDev_High.GetFloat();
-        else if (HitMed) SelectedMultiplier = Input_StdDev_Med.GetFloat();
+    float SelectedMultiplier;
+    if (sc.Index >= Lookback)
+    {
+        float MaxZScore = ZScoreMax->GetMax(ZScore);
+
+        if (MaxZScore >= Input_StdDev_High.GetFloat()) SelectedMultiplier = Input_StdDev_High.GetFloat();
+        else if (MaxZScore >= Input_StdDev_Med.GetFloat()) SelectedMultiplier = Input_StdDev_Med.GetFloat();
         else SelectedMultiplier = Input_StdDev_Low.GetFloat();
     }
     else
@@ -283,15 +344,19 @@ SCSFExport scsf_VWAPBandsStrategy(SCStudyInterfaceRef sc)
 
     if (Input_UseVIXFilter.GetYesNo())
     {
-        SCFloatArray VIXArray;
-        sc.GetStudyArrayUsingID(Input_VIXStudyID.GetInt(), Input_VIXSubgraphIndex.GetInt(), VIXArray);
-
-        if (VIXArray.GetArraySize() > 0 && sc.Index > Input_VIXSlopeBars.GetInt())
+        // Looked up once per update pass, not once per bar
+        s_StudyArrayCache* VIXCache = reinterpret_cast<s_StudyArrayCache*>(sc.GetPersistentPointer(2));
+        if (VIXCache == NULL)
         {
-            float CurrentVIX = VIXArray[sc.Index];
-            float PastVIX = VIXArray[sc.Index - Input_VIXSlopeBars.GetInt()];
-            float VIXSlope = CurrentVIX - PastVIX;
+            VIXCache = new s_StudyArrayCache;
+            VIXCache->Reset();
+            sc.SetPersistentPointer(2, VIXCache);
+        }
 
+        float VIXSlope = 0;
+        if (VIXCache->Resolve(sc, Input_VIXChartNumber.GetInt(), Input_VIXStudyID.GetInt(), Input_VIXSubgraphIndex.GetInt())
+            && VIXCache->GetChange(sc.Index, Input_VIXSlopeBars.GetInt(), VIXSlope))
+        {
             // Mean Reversion Logic:
             // If VIX is Falling (Slope < 0), fear is leaving -> Good for Longs?
             // If VIX is Rising (Slope > 0), fear is entering -> Good for Shorts?